@@ -4,7 +4,7 @@ Benchmark Graph Generator for Hash Set Comparisons
 
 Generates comparison graphs for:
 1. StoreHash_LF875_Linear vs Abseil vs std::unordered_set (at larger sizes)
-2. StoreHash vs NoStoreHash for LF875
+2. StoreHash vs NoStoreHash vs CompactHash for LF875
 3. Load factor comparisons (LF85, LF875, LF90)
 """
 
@@ -147,7 +147,7 @@ def create_comparison_vs_baseline(df, output_dir):
 
 def create_storehash_comparison(df, output_dir):
     """
-    Create comparison: StoreHash vs NoStoreHash for LF875.
+    Create comparison: StoreHash vs NoStoreHash vs CompactHash (32-bit fragments) for LF875.
     Shows relative performance normalized to StoreHash Linear.
     """
     operations = ['Insert', 'LookupHit', 'LookupMiss', 'Erase', 'Iterate']
@@ -165,6 +165,8 @@ def create_storehash_comparison(df, output_dir):
         nostorehash_linear = f'Alp_{dtype}_Rapid_NoStoreHash_LF875_Linear'
         storehash_quad = f'Alp_{dtype}_Rapid_StoreHash_LF875_Quadratic'
         nostorehash_quad = f'Alp_{dtype}_Rapid_NoStoreHash_LF875_Quadratic'
+        compacthash_linear = f'Alp_{dtype}_Rapid_CompactHash_LF875_Linear'
+        compacthash_quad = f'Alp_{dtype}_Rapid_CompactHash_LF875_Quadratic'
 
         for idx, op in enumerate(operations):
             ax = axes[idx]
@@ -178,6 +180,8 @@ def create_storehash_comparison(df, output_dir):
                 (nostorehash_linear, 'NoStoreHash Linear', '#e67e22', 's'),
                 (storehash_quad, 'StoreHash Quadratic', '#3498db', '^'),
                 (nostorehash_quad, 'NoStoreHash Quadratic', '#9b59b6', 'd'),
+                (compacthash_linear, 'CompactHash Linear', '#e74c3c', 'v'),
+                (compacthash_quad, 'CompactHash Quadratic', '#1abc9c', 'P'),
             ]:
                 subset = df[(df['impl'] == impl) & (df['operation'] == op)]
                 if not subset.empty:
@@ -199,7 +203,7 @@ def create_storehash_comparison(df, output_dir):
 
         axes[5].axis('off')
 
-        plt.suptitle(f'{dtype}: StoreHash vs NoStoreHash (LF=87.5%)\n(lower is better)',
+        plt.suptitle(f'{dtype}: StoreHash vs NoStoreHash vs CompactHash (LF=87.5%)\n(lower is better)',
                      fontsize=14, fontweight='bold')
         plt.tight_layout()
         plt.savefig(os.path.join(output_dir, f'storehash_comparison_{dtype.lower()}.png'),
@@ -0,0 +1,385 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#include <benchmark/benchmark.h>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+import alp;
+
+namespace
+{
+    int maxThreads()
+    {
+        return static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+    }
+
+    /// Number of distinct keys the threads read and write.
+    constexpr int64_t keySpace = 1 << 20;
+
+    /// A Map behind a single reader-writer lock: the baseline ConcurrentMap replaces.
+    class LockedMap
+    {
+      public:
+        void increment(int64_t key)
+        {
+            std::unique_lock lock(mutex_);
+            ++map_[key];
+        }
+
+        int64_t read(int64_t key) const
+        {
+            std::shared_lock lock(mutex_);
+            auto it = map_.find(key);
+            return it == map_.end() ? 0 : it->second;
+        }
+
+      private:
+        mutable std::shared_mutex mutex_;
+        alp::Map<int64_t, int64_t> map_;
+    };
+
+    using OptimisticConcurrentMap = alp::ConcurrentMap<
+        int64_t,
+        int64_t,
+        alp::RapidHasher,
+        std::equal_to<int64_t>,
+        alp::HashPolicySelector<int64_t, alp::RapidHasher>::type,
+        alp::DefaultBackend,
+        std::allocator<std::byte>,
+        alp::DefaultLoadFactorSelector<alp::DefaultBackend>::type,
+        alp::HashStorageSelector<std::pair<int64_t const, int64_t>>::type,
+        alp::DefaultProber,
+        alp::DefaultShrinkPolicy,
+        alp::OptimisticReadsTag>;
+
+    template<typename ConcurrentMap>
+    class ShardedMap
+    {
+      public:
+        void increment(int64_t key)
+        {
+            map_.insert_or_visit({key, 1}, [](auto& element) { ++element.second; });
+        }
+
+        int64_t read(int64_t key) const
+        {
+            int64_t value = 0;
+            map_.cvisit(key, [&](auto const& element) { value = element.second; });
+            return value;
+        }
+
+      private:
+        ConcurrentMap map_;
+    };
+
+    class SnapshotBackedMap
+    {
+      public:
+        void increment(int64_t key)
+        {
+            map_.update([&](auto& map) { ++map[key]; });
+        }
+
+        int64_t read(int64_t key) const
+        {
+            int64_t value = 0;
+            map_.cvisit(key, [&](auto const& element) { value = element.second; });
+            return value;
+        }
+
+      private:
+        alp::SnapshotMap<int64_t, int64_t> map_;
+    };
+
+    /// Every thread performs random operations on a shared map, state.range(0) percent
+    /// of them reads and the rest increments. Half of the keys are present up front.
+    template<typename Container>
+    void bmMixedReadWrite(benchmark::State& state)
+    {
+        static std::unique_ptr<Container> map;
+        if (state.thread_index() == 0)
+        {
+            map = std::make_unique<Container>();
+            for (int64_t key = 0; key < keySpace; key += 2)
+            {
+                map->increment(key);
+            }
+        }
+
+        auto const readPercent = state.range(0);
+        std::mt19937_64 rng(state.thread_index() + 1);
+        std::uniform_int_distribution<int64_t> keys(0, keySpace - 1);
+        std::uniform_int_distribution<int64_t> percent(0, 99);
+
+        for (auto _ : state)
+        {
+            auto key = keys(rng);
+            if (percent(rng) < readPercent)
+            {
+                benchmark::DoNotOptimize(map->read(key));
+            }
+            else
+            {
+                map->increment(key);
+            }
+        }
+        state.SetItemsProcessed(state.iterations());
+
+        if (state.thread_index() == 0)
+        {
+            map.reset();
+        }
+    }
+
+    /// Number of keys in the read-mostly benchmark, sized like a routing table.
+    constexpr int64_t routeCount = 1 << 14;
+
+    /// Every thread looks up random keys, except that thread 0 also updates one in every
+    /// state.range(0) iterations, as configuration that changes a few times per second would.
+    template<typename Container>
+    void bmReadMostly(benchmark::State& state)
+    {
+        static std::unique_ptr<Container> map;
+        if (state.thread_index() == 0)
+        {
+            map = std::make_unique<Container>();
+            for (int64_t key = 0; key < routeCount; ++key)
+            {
+                map->increment(key);
+            }
+        }
+
+        auto const updateInterval = state.range(0);
+        std::mt19937_64 rng(state.thread_index() + 1);
+        std::uniform_int_distribution<int64_t> keys(0, routeCount - 1);
+        int64_t iteration = 0;
+
+        for (auto _ : state)
+        {
+            auto key = keys(rng);
+            if (state.thread_index() == 0 && ++iteration % updateInterval == 0)
+            {
+                map->increment(key);
+            }
+            else
+            {
+                benchmark::DoNotOptimize(map->read(key));
+            }
+        }
+        state.SetItemsProcessed(state.iterations());
+
+        if (state.thread_index() == 0)
+        {
+            map.reset();
+        }
+    }
+
+    /// Every thread inserts random IDs into a shared set that starts out empty, as when
+    /// deduplicating events from several ingest threads. Most later insertions find the ID.
+    template<typename Set>
+    void bmDedupInsert(benchmark::State& state)
+    {
+        static std::unique_ptr<Set> set;
+        if (state.thread_index() == 0)
+        {
+            set = std::make_unique<Set>();
+        }
+
+        std::mt19937_64 rng(state.thread_index() + 1);
+        std::uniform_int_distribution<int64_t> ids(0, keySpace - 1);
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(set->insert(ids(rng)));
+        }
+        state.SetItemsProcessed(state.iterations());
+
+        if (state.thread_index() == 0)
+        {
+            set.reset();
+        }
+    }
+
+    /// Writers of the aggregation benchmark, one per thread. The lock-based maps are
+    /// written directly; ThreadPerCoreMap needs a producer per thread.
+    template<typename Container>
+    class DirectWriter
+    {
+      public:
+        explicit DirectWriter(Container& counts)
+            : counts_(counts)
+        {
+        }
+
+        void add(int64_t key) { counts_.increment(key); }
+
+        /// Returns once every add has been applied, which for direct writes is at once.
+        void finish() {}
+
+      private:
+        Container& counts_;
+    };
+
+    class ProducerWriter
+    {
+      public:
+        using Counts = alp::ThreadPerCoreMap<int64_t, int64_t>;
+
+        explicit ProducerWriter(Counts& counts)
+            : producer_(counts.producer())
+        {
+        }
+
+        void add(int64_t key) { producer_.merge(key, 1); }
+
+        void finish() { producer_.flush(); }
+
+      private:
+        Counts::Producer producer_;
+    };
+
+    /// Every thread adds one to the count of random keys, as an aggregation job would.
+    /// The counts are replaced at the start of each run rather than at its end, so that
+    /// no thread's writer outlives them. The last iteration waits until the thread's adds
+    /// have been applied, so that queued operations are not counted as done.
+    template<typename Container, typename Writer>
+    void bmAggregate(benchmark::State& state)
+    {
+        static std::unique_ptr<Container> counts;
+        if (state.thread_index() == 0)
+        {
+            counts.reset();
+            if constexpr (std::is_same_v<Container, ProducerWriter::Counts>)
+            {
+                // Half of the cores for the workers, half for the threads feeding them
+                counts = std::make_unique<Container>(std::max(maxThreads() / 2, 1));
+            }
+            else
+            {
+                counts = std::make_unique<Container>();
+            }
+        }
+
+        std::mt19937_64 rng(state.thread_index() + 1);
+        std::uniform_int_distribution<int64_t> keys(0, keySpace - 1);
+        std::optional<Writer> writer;
+        benchmark::IterationCount iteration = 0;
+        for (auto _ : state)
+        {
+            if (!writer)
+            {
+                writer.emplace(*counts);
+            }
+            writer->add(keys(rng));
+            if (++iteration == state.max_iterations)
+            {
+                writer->finish();
+            }
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+#if !defined(_WIN32)
+    /// Every thread looks up random keys in a cache of routeCount entries through a
+    /// SharedMemoryMap instance of its own, as worker processes sharing one would. Compare
+    /// with bmReadMostly<LockedMap>, where the threads share a Map in process memory.
+    void bmSharedMemoryLookup(benchmark::State& state)
+    {
+        using SharedMap = alp::SharedMemoryMap<int64_t, int64_t>;
+        static std::string const name = "/alp_benchmark_" + std::to_string(::getpid());
+        static std::optional<SharedMap> creator;
+        if (state.thread_index() == 0)
+        {
+            creator.reset();
+            SharedMap::remove(name);
+            creator.emplace(*SharedMap::create(name));
+            for (int64_t key = 0; key < routeCount; ++key)
+            {
+                creator->insert(key, key);
+            }
+        }
+
+        std::mt19937_64 rng(state.thread_index() + 1);
+        std::uniform_int_distribution<int64_t> keys(0, routeCount - 1);
+        std::optional<SharedMap> own;
+        for (auto _ : state)
+        {
+            if (!own)
+            {
+                own.emplace(*SharedMap::open(name));
+            }
+            benchmark::DoNotOptimize(own->get(keys(rng)));
+        }
+        state.SetItemsProcessed(state.iterations());
+
+        if (state.thread_index() == 0)
+        {
+            // Threads still holding an instance keep their mappings
+            creator.reset();
+            SharedMap::remove(name);
+        }
+    }
+#endif
+
+}  // namespace
+
+BENCHMARK(bmMixedReadWrite<LockedMap>)
+    ->ArgsProduct({{50, 90, 99}})
+    ->ArgNames({"read_percent"})
+    ->ThreadRange(1, maxThreads())
+    ->UseRealTime();
+BENCHMARK(bmMixedReadWrite<ShardedMap<alp::ConcurrentMap<int64_t, int64_t>>>)
+    ->ArgsProduct({{50, 90, 99}})
+    ->ArgNames({"read_percent"})
+    ->ThreadRange(1, maxThreads())
+    ->UseRealTime();
+BENCHMARK(bmMixedReadWrite<ShardedMap<OptimisticConcurrentMap>>)
+    ->ArgsProduct({{50, 90, 99}})
+    ->ArgNames({"read_percent"})
+    ->ThreadRange(1, maxThreads())
+    ->UseRealTime();
+
+BENCHMARK(bmReadMostly<LockedMap>)
+    ->Arg(100000)
+    ->ArgNames({"update_interval"})
+    ->ThreadRange(1, maxThreads())
+    ->UseRealTime();
+BENCHMARK(bmReadMostly<ShardedMap<OptimisticConcurrentMap>>)
+    ->Arg(100000)
+    ->ArgNames({"update_interval"})
+    ->ThreadRange(1, maxThreads())
+    ->UseRealTime();
+BENCHMARK(bmReadMostly<SnapshotBackedMap>)
+    ->Arg(100000)
+    ->ArgNames({"update_interval"})
+    ->ThreadRange(1, maxThreads())
+    ->UseRealTime();
+#if !defined(_WIN32)
+BENCHMARK(bmSharedMemoryLookup)->ThreadRange(1, maxThreads())->UseRealTime();
+#endif
+
+BENCHMARK(bmDedupInsert<alp::ConcurrentSet<int64_t>>)->ThreadRange(1, maxThreads())->UseRealTime();
+BENCHMARK(bmDedupInsert<alp::GrowOnlySet<int64_t>>)->ThreadRange(1, maxThreads())->UseRealTime();
+
+BENCHMARK(bmAggregate<LockedMap, DirectWriter<LockedMap>>)
+    ->ThreadRange(1, maxThreads())
+    ->UseRealTime();
+BENCHMARK(bmAggregate<ShardedMap<alp::ConcurrentMap<int64_t, int64_t>>,
+                      DirectWriter<ShardedMap<alp::ConcurrentMap<int64_t, int64_t>>>>)
+    ->ThreadRange(1, maxThreads())
+    ->UseRealTime();
+BENCHMARK(bmAggregate<ProducerWriter::Counts, ProducerWriter>)
+    ->ThreadRange(1, maxThreads())
+    ->UseRealTime();
@@ -1,17 +1,137 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
 #include <benchmark/benchmark.h>
 
-// Placeholder for future Map benchmarks.
-// The Map implementation can be benchmarked here once it is more complete.
-
-// Example benchmark structure:
-//
-// import alp;
-//
-// static void bmMapInsert(benchmark::State& state)
-// {
-//     for (auto _ : state)
-//     {
-//         // benchmark code
-//     }
-// }
-// BENCHMARK(bmMapInsert)->Range(8, 1 << 17);
+import alp;
+
+namespace
+{
+    /// Value of Size bytes, large enough that moving it dominates a flat table's rehash.
+    template<size_t Size>
+    struct Blob
+    {
+        std::array<std::byte, Size> bytes {};
+    };
+
+    std::vector<int64_t> generateKeys(size_t count, uint64_t seed = 42)
+    {
+        std::mt19937_64 rng(seed);
+        std::uniform_int_distribution<int64_t> dist;
+        std::vector<int64_t> result;
+        result.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            result.push_back(dist(rng));
+        }
+        return result;
+    }
+
+    template<typename Value>
+    struct ValueMaker
+    {
+        static Value make() { return Value {}; }
+        static auto const& get(Value const& v) { return v; }
+    };
+
+    template<typename Blob>
+    struct ValueMaker<std::unique_ptr<Blob>>
+    {
+        static std::unique_ptr<Blob> make() { return std::make_unique<Blob>(); }
+        static auto const& get(std::unique_ptr<Blob> const& v) { return *v; }
+    };
+
+    /// Inserts state.range(0) keys into an empty map, growing it from scratch.
+    template<typename Container>
+    void bmMapInsert(benchmark::State& state)
+    {
+        using Maker = ValueMaker<typename Container::mapped_type>;
+        auto const keys = generateKeys(static_cast<size_t>(state.range(0)));
+
+        for (auto _ : state)
+        {
+            Container map;
+            for (auto key : keys)
+            {
+                map.try_emplace(key, Maker::make());
+            }
+            benchmark::DoNotOptimize(map);
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    /// Looks up every key and reads the first byte of its value.
+    template<typename Container>
+    void bmMapFindHit(benchmark::State& state)
+    {
+        using Maker = ValueMaker<typename Container::mapped_type>;
+        auto const keys = generateKeys(static_cast<size_t>(state.range(0)));
+        Container map;
+        for (auto key : keys)
+        {
+            map.try_emplace(key, Maker::make());
+        }
+        auto lookups = keys;
+        std::shuffle(lookups.begin(), lookups.end(), std::mt19937_64(7));
+
+        for (auto _ : state)
+        {
+            for (auto key : lookups)
+            {
+                auto it = map.find(key);
+                benchmark::DoNotOptimize(Maker::get(it->second).bytes[0]);
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    template<size_t Size>
+    using NodeMap = alp::NodeMap<int64_t, Blob<Size>>;
+    template<size_t Size>
+    using FlatMap = alp::Map<int64_t, Blob<Size>>;
+    template<size_t Size>
+    using SplitMap = alp::Map<int64_t,
+                              Blob<Size>,
+                              alp::RapidHasher,
+                              std::equal_to<int64_t>,
+                              alp::HashPolicySelector<int64_t, alp::RapidHasher>::type,
+                              alp::DefaultBackend,
+                              std::allocator<std::byte>,
+                              alp::DefaultLoadFactorSelector<alp::DefaultBackend>::type,
+                              alp::HashStorageSelector<int64_t>::type,
+                              alp::DefaultProber,
+                              alp::DefaultShrinkPolicy,
+                              alp::SplitLayoutTag>;
+    template<size_t Size>
+    using BoxedMap = alp::Map<int64_t, std::unique_ptr<Blob<Size>>>;
+    template<size_t Size>
+    using StdMap = std::unordered_map<int64_t, Blob<Size>>;
+}  // namespace
+
+BENCHMARK(bmMapInsert<NodeMap<256>>)->Range(1 << 10, 1 << 20);
+BENCHMARK(bmMapInsert<FlatMap<256>>)->Range(1 << 10, 1 << 20);
+BENCHMARK(bmMapInsert<SplitMap<256>>)->Range(1 << 10, 1 << 20);
+BENCHMARK(bmMapInsert<BoxedMap<256>>)->Range(1 << 10, 1 << 20);
+BENCHMARK(bmMapInsert<StdMap<256>>)->Range(1 << 10, 1 << 20);
+BENCHMARK(bmMapInsert<NodeMap<1024>>)->Range(1 << 10, 1 << 18);
+BENCHMARK(bmMapInsert<FlatMap<1024>>)->Range(1 << 10, 1 << 18);
+BENCHMARK(bmMapInsert<SplitMap<1024>>)->Range(1 << 10, 1 << 18);
+BENCHMARK(bmMapInsert<BoxedMap<1024>>)->Range(1 << 10, 1 << 18);
+BENCHMARK(bmMapInsert<StdMap<1024>>)->Range(1 << 10, 1 << 18);
+
+BENCHMARK(bmMapFindHit<NodeMap<256>>)->Range(1 << 10, 1 << 20);
+BENCHMARK(bmMapFindHit<FlatMap<256>>)->Range(1 << 10, 1 << 20);
+BENCHMARK(bmMapFindHit<SplitMap<256>>)->Range(1 << 10, 1 << 20);
+BENCHMARK(bmMapFindHit<BoxedMap<256>>)->Range(1 << 10, 1 << 20);
+BENCHMARK(bmMapFindHit<StdMap<256>>)->Range(1 << 10, 1 << 20);
+BENCHMARK(bmMapFindHit<NodeMap<1024>>)->Range(1 << 10, 1 << 18);
+BENCHMARK(bmMapFindHit<FlatMap<1024>>)->Range(1 << 10, 1 << 18);
+BENCHMARK(bmMapFindHit<SplitMap<1024>>)->Range(1 << 10, 1 << 18);
+BENCHMARK(bmMapFindHit<BoxedMap<1024>>)->Range(1 << 10, 1 << 18);
+BENCHMARK(bmMapFindHit<StdMap<1024>>)->Range(1 << 10, 1 << 18);
@@ -1,8 +1,14 @@
 #include <algorithm>
+#include <chrono>
 #include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
 #include <random>
 #include <ratio>
+#include <sstream>
 #include <string>
+#include <type_traits>
 #include <unordered_set>
 #include <vector>
 
@@ -80,6 +86,22 @@ namespace
         state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(count));
     }
 
+    template<typename Container>
+    void bmInsertRange(benchmark::State& state)
+    {
+        using T = Container::value_type;
+        auto const count = static_cast<size_t>(state.range(0));
+        auto const data = DataGenerator<T>::generate(count);
+
+        for (auto _ : state)
+        {
+            Container set;
+            set.insert_range(data);
+            benchmark::DoNotOptimize(set);
+        }
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(count));
+    }
+
     template<typename Container>
     void bmLookupHit(benchmark::State& state)
     {
@@ -129,6 +151,51 @@ namespace
         state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(count));
     }
 
+    template<typename Container>
+    void bmLookupHitBatch(benchmark::State& state)
+    {
+        using T = Container::value_type;
+        auto const count = static_cast<size_t>(state.range(0));
+        auto const data = DataGenerator<T>::generate(count);
+
+        Container set;
+        set.reserve(count);
+        for (auto const& val : data)
+        {
+            set.insert(val);
+        }
+
+        auto results = std::make_unique<bool[]>(count);
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(set.contains_many(data, {results.get(), count}));
+        }
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(count));
+    }
+
+    template<typename Container>
+    void bmLookupMissBatch(benchmark::State& state)
+    {
+        using T = typename Container::value_type;
+        auto const count = static_cast<size_t>(state.range(0));
+        auto const data = DataGenerator<T>::generate(count, 42);
+        auto const missData = DataGenerator<T>::generate(count, 1337);
+
+        Container set;
+        set.reserve(count);
+        for (auto const& val : data)
+        {
+            set.insert(val);
+        }
+
+        auto results = std::make_unique<bool[]>(count);
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(set.contains_many(missData, {results.get(), count}));
+        }
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(count));
+    }
+
     template<typename Container>
     void bmErase(benchmark::State& state)
     {
@@ -183,6 +250,222 @@ namespace
         state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(count));
     }
 
+    /// Times a single grow of a table holding range(0) elements, rehashed on range(1) threads.
+    template<typename Container>
+    void bmGrow(benchmark::State& state)
+    {
+        using T = typename Container::value_type;
+        auto const count = static_cast<size_t>(state.range(0));
+        auto const data = DataGenerator<T>::generate(count);
+
+        for (auto _ : state)
+        {
+            state.PauseTiming();
+            Container set;
+            set.set_rehash_threads(static_cast<unsigned>(state.range(1)));
+            set.reserve(count);
+            for (auto const& val : data)
+            {
+                set.insert(val);
+            }
+            state.ResumeTiming();
+
+            // Asking for the current capacity within the load factor doubles the group count
+            set.reserve(set.capacity());
+            benchmark::DoNotOptimize(set);
+
+            state.PauseTiming();
+            set.clear();
+            state.ResumeTiming();
+        }
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(count));
+    }
+
+    /// Records the latency of every insertion while filling a table with range(0) elements,
+    /// with range(1) groups moved per insertion during growth (0 rehashes in one go).
+    template<typename Container>
+    void bmInsertLatency(benchmark::State& state)
+    {
+        using T = typename Container::value_type;
+        using Clock = std::chrono::steady_clock;
+        auto const count = static_cast<size_t>(state.range(0));
+        auto const data = DataGenerator<T>::generate(count);
+        std::vector<int64_t> latencies(count);
+
+        for (auto _ : state)
+        {
+            Container set;
+            set.set_incremental_rehash(static_cast<size_t>(state.range(1)));
+            for (size_t i = 0; i < count; ++i)
+            {
+                auto start = Clock::now();
+                set.insert(data[i]);
+                latencies[i] = (Clock::now() - start).count();
+            }
+            benchmark::DoNotOptimize(set);
+        }
+
+        std::ranges::sort(latencies);
+        auto percentile = [&](double p)
+        {
+            auto idx = std::min(count - 1, static_cast<size_t>(p * static_cast<double>(count)));
+            return static_cast<double>(latencies[idx]);
+        };
+        state.counters["p50_ns"] = percentile(0.5);
+        state.counters["p99_ns"] = percentile(0.99);
+        state.counters["p999_ns"] = percentile(0.999);
+        state.counters["max_ns"] = static_cast<double>(latencies.back());
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(count));
+    }
+
+    /// Times restoring a saved table of range(0) elements from memory, the cost of a warm
+    /// start once the file is in the page cache.
+    template<typename Container>
+    void bmLoad(benchmark::State& state)
+    {
+        using T = typename Container::value_type;
+        auto const count = static_cast<size_t>(state.range(0));
+        Container source;
+        for (auto const& val : DataGenerator<T>::generate(count))
+        {
+            source.insert(val);
+        }
+        std::stringstream saved;
+        if (!source.save(saved))
+        {
+            state.SkipWithError("save failed");
+            return;
+        }
+
+        for (auto _ : state)
+        {
+            saved.seekg(0);
+            auto loaded = Container::load(saved);
+            benchmark::DoNotOptimize(loaded);
+        }
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(count));
+    }
+
+    /// Times opening a saved table of range(0) elements as a FrozenSet and looking up one
+    /// element, which maps the file instead of reading it.
+    template<typename Container, typename Frozen>
+    void bmOpenFrozen(benchmark::State& state)
+    {
+        using T = typename Container::value_type;
+        auto const count = static_cast<size_t>(state.range(0));
+        auto const data = DataGenerator<T>::generate(count);
+        auto const path = std::filesystem::temp_directory_path() / "alp_frozen_benchmark.bin";
+        {
+            Container source;
+            for (auto const& val : data)
+            {
+                source.insert(val);
+            }
+            if (!source.save(path))
+            {
+                state.SkipWithError("save failed");
+                return;
+            }
+        }
+
+        for (auto _ : state)
+        {
+            auto frozen = Frozen::open(path);
+            benchmark::DoNotOptimize(frozen->contains(data[count / 2]));
+        }
+        std::filesystem::remove(path);
+    }
+
+    /// Inserts range(0) random IDs drawn from as many values, about a third of them repeats,
+    /// into a FileBackedSet in $ALP_FILE_BACKED_DIR (the temporary directory by default).
+    /// To measure a set twice the size of RAM, run it in a memory-limited cgroup with a
+    /// size whose table is twice the limit, e.g. 1 << 26 elements (a 576 MiB table) under
+    /// systemd-run --user --scope -p MemoryMax=288M -p MemorySwapMax=0.
+    template<typename Container>
+    void bmDedupFileBacked(benchmark::State& state)
+    {
+        auto const count = static_cast<int64_t>(state.range(0));
+        auto const* dir = std::getenv("ALP_FILE_BACKED_DIR");
+        auto const path = (dir != nullptr ? std::filesystem::path(dir)
+                                          : std::filesystem::temp_directory_path())
+            / "alp_file_backed_benchmark.bin";
+
+        for (auto _ : state)
+        {
+            auto set = Container::create(path);
+            if (!set)
+            {
+                state.SkipWithError("create failed");
+                return;
+            }
+            std::mt19937_64 rng(42);
+            std::uniform_int_distribution<int64_t> ids(0, count - 1);
+            for (int64_t i = 0; i < count; ++i)
+            {
+                benchmark::DoNotOptimize(set->insert(ids(rng)));
+            }
+        }
+        std::filesystem::remove(path);
+        state.SetItemsProcessed(state.iterations() * count);
+    }
+
+    /// Times rebuilding the same table by inserting its elements, which bmLoad replaces.
+    template<typename Container>
+    void bmRebuild(benchmark::State& state)
+    {
+        using T = typename Container::value_type;
+        auto const count = static_cast<size_t>(state.range(0));
+        auto const data = DataGenerator<T>::generate(count);
+
+        for (auto _ : state)
+        {
+            Container set;
+            set.reserve(count);
+            for (auto const& val : data)
+            {
+                set.insert(val);
+            }
+            benchmark::DoNotOptimize(set);
+        }
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(count));
+    }
+
+    /// Looks up range(0) elements in a PerfectSet built from as many: the same elements, or
+    /// with range(1) set absent ones. Compare with bmLookupHit and bmLookupMiss.
+    template<typename Perfect>
+    void bmPerfectLookup(benchmark::State& state)
+    {
+        using T = typename Perfect::value_type;
+        auto const count = static_cast<size_t>(state.range(0));
+        auto const data = DataGenerator<T>::generate(count, 42);
+        auto const queries = state.range(1) != 0 ? DataGenerator<T>::generate(count, 1337) : data;
+        auto const set = Perfect::build(data);
+
+        for (auto _ : state)
+        {
+            for (auto const& val : queries)
+            {
+                benchmark::DoNotOptimize(set.contains(val));
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(count));
+    }
+
+    /// Times building a PerfectSet of range(0) random elements.
+    template<typename Perfect>
+    void bmPerfectBuild(benchmark::State& state)
+    {
+        using T = typename Perfect::value_type;
+        auto const count = static_cast<size_t>(state.range(0));
+        auto const data = DataGenerator<T>::generate(count);
+
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(Perfect::build(data));
+        }
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(count));
+    }
+
     template<typename Container>
     void registerSuite(std::string const& suiteName)
     {
@@ -197,6 +480,13 @@ namespace
         registerWithRange("LookupMiss", bmLookupMiss<Container>);
         registerWithRange("Erase", bmErase<Container>);
         registerWithRange("Iterate", bmIterate<Container>);
+
+        if constexpr (requires(Container c, std::vector<typename Container::value_type> v) {
+                          c.insert_range(v);
+                      })
+        {
+            registerWithRange("InsertRange", bmInsertRange<Container>);
+        }
     }
 
     template<template<typename...> typename Container>
@@ -206,7 +496,26 @@ namespace
         registerSuite<Container<std::string>>(suiteName + "_String");
     }
 
-    template<typename Hash, typename LoadFactorRatio, typename ProbingScheme>
+    /// Batched lookups only pay off once the table no longer fits in cache. They are slow
+    /// to run, so they are registered for a few suites only, next to their plain lookups.
+    template<template<typename...> typename Container>
+    void registerBatchSuites(std::string const& suiteName)
+    {
+        auto registerLarge = [&](std::string testName, auto func)
+        {
+            benchmark::RegisterBenchmark((suiteName + testName).c_str(), func)->Arg(1 << 22);
+        };
+
+        registerLarge("_Int64/LookupHitBatch", bmLookupHitBatch<Container<int64_t>>);
+        registerLarge("_Int64/LookupMissBatch", bmLookupMissBatch<Container<int64_t>>);
+        registerLarge("_String/LookupHitBatch", bmLookupHitBatch<Container<std::string>>);
+        registerLarge("_String/LookupMissBatch", bmLookupMissBatch<Container<std::string>>);
+    }
+
+    template<typename Hash,
+             typename LoadFactorRatio,
+             typename ProbingScheme,
+             typename HashStoragePolicy = void>
     struct AlpSetBinder
     {
         template<typename T>
@@ -217,7 +526,9 @@ namespace
                               alp::DefaultBackend,
                               std::allocator<std::byte>,
                               LoadFactorRatio,
-                              alp::HashStorageSelector<T>,
+                              std::conditional_t<std::is_void_v<HashStoragePolicy>,
+                                                 typename alp::HashStorageSelector<T>::type,
+                                                 HashStoragePolicy>,
                               ProbingScheme>;
     };
 
@@ -231,6 +542,52 @@ namespace
             suiteName + "_Quadratic");
     }
 
+    /// Registers String suites for one hash storage policy, named as analysis.py expects.
+    template<typename HashStoragePolicy>
+    void registerStorageSuites(std::string const& policyName)
+    {
+        using Rapid = alp::RapidHasher;
+        using LF = alp::DefaultLoadFactor;
+        using Linear = AlpSetBinder<Rapid, LF, alp::LinearProbing, HashStoragePolicy>;
+        using Quadratic = AlpSetBinder<Rapid, LF, alp::QuadraticProbing, HashStoragePolicy>;
+
+        registerSuite<typename Linear::template type<std::string>>(
+            "Alp_String_Rapid_" + policyName + "_LF875_Linear");
+        registerSuite<typename Quadratic::template type<std::string>>(
+            "Alp_String_Rapid_" + policyName + "_LF875_Quadratic");
+    }
+
+    /// Default set with the given control byte layout.
+    template<typename T, typename CtrlLayout>
+    using AlpCtrlLayoutSet =
+        alp::Set<T,
+                 alp::RapidHasher,
+                 std::equal_to<T>,
+                 typename alp::HashPolicySelector<T, alp::RapidHasher>::type,
+                 alp::DefaultBackend,
+                 std::allocator<std::byte>,
+                 typename alp::DefaultLoadFactorSelector<alp::DefaultBackend>::type,
+                 typename alp::HashStorageSelector<T>::type,
+                 alp::DefaultProber,
+                 alp::DefaultShrinkPolicy,
+                 CtrlLayout>;
+
+    /// Registers lookups in tables far larger than the caches and the TLB's reach, where
+    /// the distance between control bytes and slots matters most.
+    template<typename CtrlLayout>
+    void registerCtrlLayoutSuite(std::string const& suiteName)
+    {
+        using Container = AlpCtrlLayoutSet<int64_t, CtrlLayout>;
+        auto registerHuge = [&](std::string testName, auto func)
+        {
+            benchmark::RegisterBenchmark((suiteName + "/" + testName).c_str(), func)
+                ->Arg(1 << 22)
+                ->Arg(1 << 26);
+        };
+
+        registerHuge("LookupHit", bmLookupHit<Container>);
+        registerHuge("LookupMiss", bmLookupMiss<Container>);
+    }
 }  // namespace
 
 // Helper to adjust load factor by a delta (in units of 0.001)
@@ -267,6 +624,67 @@ int main(int argc, char** argv)
     registerProbingSuites<alp::RapidHasher, DefaultLF_Minus>("Alp_Rapid_LF_Minus025");
     registerProbingSuites<alp::RapidHasher, DefaultLF_Plus>("Alp_Rapid_LF_Plus025");
 
+    // The default probing scheme, compared against the other one
+    using DefaultQuadratic =
+        AlpSetBinder<alp::RapidHasher, DefaultBackendLF, alp::QuadraticProbing>;
+    using DefaultLinear = AlpSetBinder<alp::RapidHasher, DefaultBackendLF, alp::LinearProbing>;
+    registerBatchSuites<DefaultQuadratic::template type>("Alp_Rapid_LF_Default_Quadratic");
+    registerBatchSuites<DefaultLinear::template type>("Alp_Rapid_LF_Default_Linear");
+
+    registerStorageSuites<alp::StoreHashTag>("StoreHash");
+    registerStorageSuites<alp::NoStoreHashTag>("NoStoreHash");
+    registerStorageSuites<alp::CompactHashTag>("CompactHash");
+
+    registerCtrlLayoutSuite<alp::ContiguousCtrlTag>("Alp_Rapid_ContiguousCtrl_Int64");
+    registerCtrlLayoutSuite<alp::BlockedCtrlTag>("Alp_Rapid_BlockedCtrl_Int64");
+
+    benchmark::RegisterBenchmark("Alp_Rapid_Grow_Int64", bmGrow<alp::Set<int64_t>>)
+        ->ArgsProduct({{1 << 24, 1 << 26}, {1, 2, 4, 8}})
+        ->ArgNames({"size", "threads"})
+        ->Unit(benchmark::kMillisecond)
+        ->Iterations(3);
+
+    benchmark::RegisterBenchmark("Alp_Rapid_InsertLatency_Int64",
+                                 bmInsertLatency<alp::Set<int64_t>>)
+        ->ArgsProduct({{1 << 22}, {0, 1, 4}})
+        ->ArgNames({"size", "groups_per_insert"})
+        ->Unit(benchmark::kMillisecond)
+        ->Iterations(1);
+
+    benchmark::RegisterBenchmark("Alp_Rapid_Load_Int64", bmLoad<alp::Set<int64_t>>)
+        ->Arg(1 << 20)
+        ->Arg(1 << 24)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark("Alp_Rapid_OpenFrozen_Int64",
+                                 bmOpenFrozen<alp::Set<int64_t>, alp::FrozenSet<int64_t>>)
+        ->Arg(1 << 20)
+        ->Arg(1 << 24)
+        ->Unit(benchmark::kMicrosecond);
+    benchmark::RegisterBenchmark("Alp_Rapid_DedupFileBacked_Int64",
+                                 bmDedupFileBacked<alp::FileBackedSet<int64_t>>)
+        ->Arg(1 << 22)
+        ->Arg(1 << 26)
+        ->Unit(benchmark::kMillisecond)
+        ->Iterations(1);
+    benchmark::RegisterBenchmark("Alp_Rapid_Rebuild_Int64", bmRebuild<alp::Set<int64_t>>)
+        ->Arg(1 << 20)
+        ->Arg(1 << 24)
+        ->Unit(benchmark::kMillisecond);
+
+    benchmark::RegisterBenchmark("Alp_Rapid_PerfectLookup_Int64",
+                                 bmPerfectLookup<alp::PerfectSet<int64_t>>)
+        ->ArgsProduct({{1 << 12, 1 << 22}, {0, 1}})
+        ->ArgNames({"size", "miss"});
+    benchmark::RegisterBenchmark("Alp_Rapid_PerfectLookup_String",
+                                 bmPerfectLookup<alp::PerfectSet<std::string>>)
+        ->ArgsProduct({{1 << 12, 1 << 22}, {0, 1}})
+        ->ArgNames({"size", "miss"});
+    benchmark::RegisterBenchmark("Alp_Rapid_PerfectBuild_Int64",
+                                 bmPerfectBuild<alp::PerfectSet<int64_t>>)
+        ->Arg(1 << 20)
+        ->Arg(1 << 24)
+        ->Unit(benchmark::kMillisecond);
+
     benchmark::Initialize(&argc, argv);
     benchmark::RunSpecifiedBenchmarks();
     benchmark::Shutdown();
@@ -0,0 +1,2228 @@
+module;
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <latch>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <shared_mutex>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+export module alp:concurrent;
+
+import :set;
+import :map;
+import :rapid_hash;
+
+namespace alp
+{
+    /// Alignment of each shard, so that threads working on different shards never
+    /// contend for the cache line holding a lock.
+    inline constexpr size_t shardAlignment = 64;
+
+    /// Shard count used when none is given: a few shards per hardware thread, so that
+    /// two threads rarely pick the same one.
+    inline size_t defaultShardCount()
+    {
+        return std::bit_ceil(4 * std::max<size_t>(std::thread::hardware_concurrency(), 1));
+    }
+
+    /// Read mode of concurrent containers in which lookups take their shard's lock shared.
+    export struct LockedReadsTag
+    {
+    };
+
+    /// Read mode of concurrent containers in which lookups take no lock at all. They probe
+    /// the table while a writer may be modifying it, and retry if the shard's sequence
+    /// counter shows that a write overlapped them. Elements must be trivially copyable,
+    /// since readers only ever see copies taken this way. Buffers the tables replace are
+    /// freed by a later write, once no lookup that may still be probing them is running.
+    export struct OptimisticReadsTag
+    {
+    };
+
+    /// Epoch-based reclamation shared by the optimistic shards, SnapshotMap and GrowOnlySet.
+    /// Each thread announces the epoch in which its current read began in a record of its
+    /// own, so readers never write to memory another thread writes. Something unlinked
+    /// before advance() returned e can be freed once oldestActive() is at least e.
+    class EpochDomain
+    {
+        struct alignas(shardAlignment) Record
+        {
+            /// Epoch the thread's outermost read began in, or 0 outside of reads.
+            std::atomic<uint64_t> epoch = 0;
+            std::atomic<bool> owned = true;
+            Record* next = nullptr;
+        };
+
+        /// The calling thread's record, claimed on first use and released at thread exit.
+        struct ThreadState
+        {
+            Record* record = nullptr;
+            unsigned depth = 0;
+
+            ~ThreadState()
+            {
+                if (record != nullptr)
+                {
+                    record->owned.store(false, std::memory_order_release);
+                }
+            }
+        };
+
+      public:
+        static EpochDomain& instance()
+        {
+            static EpochDomain domain;
+            return domain;
+        }
+
+        EpochDomain(EpochDomain const&) = delete;
+        EpochDomain& operator=(EpochDomain const&) = delete;
+
+        ~EpochDomain()
+        {
+            for (Record* record = head_.load(); record != nullptr;)
+            {
+                delete std::exchange(record, record->next);
+            }
+        }
+
+        /// Marks the calling thread as reading until the matching exit(). Reads may nest.
+        void enter()
+        {
+            auto& state = threadState();
+            if (state.depth++ == 0)
+            {
+                state.record->epoch.store(epoch_.load());
+            }
+        }
+
+        void exit() noexcept
+        {
+            auto& state = threadState();
+            if (--state.depth == 0)
+            {
+                state.record->epoch.store(0, std::memory_order_release);
+            }
+        }
+
+        /// Starts a new epoch and returns it.
+        uint64_t advance() noexcept { return epoch_.fetch_add(1) + 1; }
+
+        /// The oldest epoch a read still in progress began in, or the largest value if none.
+        [[nodiscard]] uint64_t oldestActive() const noexcept
+        {
+            uint64_t oldest = std::numeric_limits<uint64_t>::max();
+            for (Record* record = head_.load(std::memory_order_acquire); record != nullptr;
+                 record = record->next)
+            {
+                uint64_t epoch = record->epoch.load();
+                if (epoch != 0)
+                {
+                    oldest = std::min(oldest, epoch);
+                }
+            }
+            return oldest;
+        }
+
+      private:
+        EpochDomain() = default;
+
+        ThreadState& threadState()
+        {
+            static thread_local ThreadState state;
+            if (state.record == nullptr)
+            {
+                state.record = claimRecord();
+            }
+            return state;
+        }
+
+        /// Reuses the record of a thread that has exited, or adds a new one.
+        Record* claimRecord()
+        {
+            for (Record* record = head_.load(std::memory_order_acquire); record != nullptr;
+                 record = record->next)
+            {
+                bool owned = false;
+                if (!record->owned.load(std::memory_order_relaxed)
+                    && record->owned.compare_exchange_strong(owned, true))
+                {
+                    return record;
+                }
+            }
+            auto* record = new Record;
+            record->next = head_.load(std::memory_order_relaxed);
+            while (!head_.compare_exchange_weak(record->next, record)) {}
+            return record;
+        }
+
+        std::atomic<uint64_t> epoch_ = 1;
+        std::atomic<Record*> head_ = nullptr;
+    };
+
+    /// Marks the calling thread as reading for its lifetime, keeping alive everything that
+    /// was reachable when it was constructed and is reclaimed through EpochDomain.
+    class EpochGuard
+    {
+      public:
+        EpochGuard() { EpochDomain::instance().enter(); }
+        ~EpochGuard() { EpochDomain::instance().exit(); }
+
+        EpochGuard(EpochGuard const&) = delete;
+        EpochGuard& operator=(EpochGuard const&) = delete;
+    };
+
+    /// Memory blocks freed by tables that lock-free readers may still be reading. A write
+    /// collects the blocks it freed once it no longer references them, and they are handed
+    /// back to the system when no lookup begun before that is still running.
+    class RetiredBlocks
+    {
+        /// Precedes every block, padded so that the memory after it stays aligned.
+        struct alignas(shardAlignment) Header
+        {
+            Header* next;
+            size_t size;
+            /// Epoch after which no new lookup can reach the block, once collected.
+            uint64_t retiredAt;
+        };
+
+      public:
+        RetiredBlocks() = default;
+        RetiredBlocks(RetiredBlocks const&) = delete;
+        RetiredBlocks& operator=(RetiredBlocks const&) = delete;
+
+        ~RetiredBlocks()
+        {
+            freeAll(pending_);
+            freeAll(retired_);
+        }
+
+        /// Returns size bytes aligned to shardAlignment.
+        static void* allocate(size_t size)
+        {
+            auto* header = static_cast<Header*>(::operator new(
+                sizeof(Header) + size, std::align_val_t {alignof(Header)}));
+            header->size = size;
+            return header + 1;
+        }
+
+        /// Frees a block from allocate, or keeps it until the next collect() if retired is
+        /// not null.
+        static void deallocate(RetiredBlocks* retired, void* p) noexcept
+        {
+            auto* header = static_cast<Header*>(p) - 1;
+            if (retired == nullptr)
+            {
+                free(header);
+                return;
+            }
+            header->next = retired->pending_;
+            retired->pending_ = header;
+        }
+
+        /// Called by a write once the table no longer points into the blocks it freed:
+        /// stamps them with a new epoch, and frees every block no lookup can still reach.
+        void collect() noexcept
+        {
+            if (pending_ == nullptr && retired_ == nullptr)
+            {
+                return;
+            }
+            auto& domain = EpochDomain::instance();
+            if (pending_ != nullptr)
+            {
+                uint64_t epoch = domain.advance();
+                while (pending_ != nullptr)
+                {
+                    Header* header = std::exchange(pending_, pending_->next);
+                    header->retiredAt = epoch;
+                    header->next = retired_;
+                    retired_ = header;
+                }
+            }
+
+            uint64_t oldest = domain.oldestActive();
+            for (Header** link = &retired_; *link != nullptr;)
+            {
+                Header* header = *link;
+                if (header->retiredAt <= oldest)
+                {
+                    *link = header->next;
+                    free(header);
+                }
+                else
+                {
+                    link = &header->next;
+                }
+            }
+        }
+
+      private:
+        static void free(Header* header) noexcept
+        {
+            ::operator delete(
+                header, sizeof(Header) + header->size, std::align_val_t {alignof(Header)});
+        }
+
+        static void freeAll(Header* head) noexcept
+        {
+            while (head != nullptr)
+            {
+                free(std::exchange(head, head->next));
+            }
+        }
+
+        /// Freed by the write in progress, and possibly still referenced by the table.
+        Header* pending_ = nullptr;
+        /// Collected blocks that lookups may still be probing, newest first.
+        Header* retired_ = nullptr;
+    };
+
+    /// Allocator whose deallocations are deferred to a RetiredBlocks, if it has one.
+    template<typename T>
+    struct RetainingAllocator
+    {
+        static_assert(alignof(T) <= shardAlignment);
+        using value_type = T;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+
+        RetiredBlocks* retired = nullptr;
+
+        RetainingAllocator() = default;
+        explicit RetainingAllocator(RetiredBlocks* blocks) noexcept
+            : retired(blocks)
+        {
+        }
+        template<typename U>
+        RetainingAllocator(RetainingAllocator<U> const& other) noexcept
+            : retired(other.retired)
+        {
+        }
+
+        T* allocate(size_t n) { return static_cast<T*>(RetiredBlocks::allocate(n * sizeof(T))); }
+        void deallocate(T* p, size_t /*n*/) noexcept { RetiredBlocks::deallocate(retired, p); }
+
+        template<typename U>
+        bool operator==(RetainingAllocator<U> const& other) const noexcept
+        {
+            return retired == other.retired;
+        }
+    };
+
+    /// One part of a sharded container: a table and the reader-writer lock guarding it.
+    template<typename Table>
+    struct alignas(shardAlignment) Shard
+    {
+        mutable std::shared_mutex mutex;
+        Table table;
+
+        /// Runs fn(table) with the lock held exclusively and returns its result.
+        template<typename F>
+        decltype(auto) write(F&& fn)
+        {
+            std::unique_lock lock(mutex);
+            return fn(table);
+        }
+
+        /// Runs fn(table) with the lock held shared and returns its result.
+        template<typename F>
+        decltype(auto) read(F&& fn) const
+        {
+            std::shared_lock lock(mutex);
+            return fn(table);
+        }
+    };
+
+    /// Shard for OptimisticReadsTag: writers take a mutex and make the sequence counter odd
+    /// while they modify the table, and lookups validate against the counter instead.
+    template<typename Table>
+    struct alignas(shardAlignment) SeqlockShard
+    {
+        /// The table with the lookup that Set and Map only expose to derived classes, as it
+        /// is only safe behind the sequence counter and the retained buffers.
+        struct OptimisticTable : Table
+        {
+            using Table::Table;
+            using Table::find_optimistic;
+        };
+
+        std::atomic<uint64_t> sequence = 0;
+        mutable std::mutex mutex;
+        RetiredBlocks retired;
+        OptimisticTable table {RetainingAllocator<std::byte>(&retired)};
+
+        template<typename F>
+        decltype(auto) write(F&& fn)
+        {
+            std::unique_lock lock(mutex);
+            uint64_t before = sequence.load(std::memory_order_relaxed);
+            sequence.store(before + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            // Published even if fn throws, since the table may be modified by then
+            struct Publish
+            {
+                SeqlockShard& shard;
+                uint64_t value;
+
+                ~Publish()
+                {
+                    shard.retired.collect();
+                    shard.sequence.store(value, std::memory_order_release);
+                }
+            } publish {*this, before + 2};
+            return fn(table);
+        }
+
+        /// Runs fn(table) excluding writers, for operations that cannot be retried.
+        template<typename F>
+        decltype(auto) read(F&& fn) const
+        {
+            std::unique_lock lock(mutex);
+            return fn(table);
+        }
+
+        /// Runs lookup(table, snapshotValid) until no write overlapped it and returns its
+        /// result. snapshotValid() tells whether no write has started since the attempt
+        /// began, and is what lookup passes on to find_optimistic.
+        template<typename F>
+        auto readOptimistic(F&& lookup) const
+        {
+            // Keeps the buffers of writes that overlap an attempt from being freed under it
+            EpochGuard guard;
+            while (true)
+            {
+                uint64_t before = sequence.load(std::memory_order_acquire);
+                if ((before & 1) != 0)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                auto snapshotValid = [&]
+                {
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    return sequence.load(std::memory_order_relaxed) == before;
+                };
+                auto result = lookup(table, snapshotValid);
+                if (snapshotValid())
+                {
+                    return result;
+                }
+            }
+        }
+    };
+
+    /// A power-of-two number of shards, selected by the high bits of a hash. The tables
+    /// themselves pick groups from the low bits, so the two choices stay independent.
+    template<typename ShardType>
+    class ShardArray
+    {
+      public:
+        explicit ShardArray(size_t shardCount)
+            : count_(std::bit_ceil(std::max<size_t>(shardCount, 1)))
+            , shift_(std::numeric_limits<size_t>::digits - std::countr_zero(count_))
+            , shards_(std::make_unique<ShardType[]>(count_))
+        {
+        }
+
+        [[nodiscard]] size_t count() const noexcept { return count_; }
+
+        /// Returns the shard for a hash to which the table's policy has been applied.
+        ShardType& forHash(size_t hash) const noexcept
+        {
+            return shards_[count_ == 1 ? 0 : hash >> shift_];
+        }
+
+        /// Calls fn(table) for every shard, as a writer.
+        template<typename F>
+        void forEach(F&& fn)
+        {
+            for (size_t i = 0; i < count_; ++i)
+            {
+                shards_[i].write(fn);
+            }
+        }
+
+        /// Calls fn(table) for every shard, as a reader.
+        template<typename F>
+        void forEach(F&& fn) const
+        {
+            for (size_t i = 0; i < count_; ++i)
+            {
+                std::as_const(shards_[i]).read(fn);
+            }
+        }
+
+      private:
+        size_t count_;
+        int shift_;
+        std::unique_ptr<ShardType[]> shards_;
+    };
+
+    /// Shard type and table allocator for a read mode of the concurrent containers.
+    template<typename ReadMode, typename Allocator>
+    struct ReadModeTraits
+    {
+        static constexpr bool optimistic = false;
+        using allocator_type = Allocator;
+
+        template<typename Table>
+        using shard_type = Shard<Table>;
+    };
+
+    template<typename Allocator>
+    struct ReadModeTraits<OptimisticReadsTag, Allocator>
+    {
+        static_assert(std::is_same_v<Allocator, std::allocator<std::byte>>,
+                      "OptimisticReadsTag allocates through its own retaining allocator");
+        static constexpr bool optimistic = true;
+        using allocator_type = RetainingAllocator<std::byte>;
+
+        template<typename Table>
+        using shard_type = SeqlockShard<Table>;
+    };
+
+    /// A hash map safe for concurrent use, split into independently locked Map shards.
+    /// Elements are only reached through callbacks run under their shard's lock, so no
+    /// reference to an element outlives the lock protecting it. Lookups take the lock
+    /// shared and can run in parallel; modifications take it exclusively. With
+    /// OptimisticReadsTag, cvisit and contains take no lock and call fn on a copy.
+    export template<typename Key,
+                    typename Value,
+                    typename Hash = RapidHasher,
+                    typename Equal = std::equal_to<Key>,
+                    typename Policy = HashPolicySelector<Key, Hash>::type,
+                    SimdBackend Backend = DefaultBackend,
+                    typename Allocator = std::allocator<std::byte>,
+                    typename LoadFactorRatio = typename DefaultLoadFactorSelector<Backend>::type,
+                    typename HashStoragePolicy =
+                        typename HashStorageSelector<std::pair<Key const, Value>>::type,
+                    typename Prober = DefaultProber,
+                    ShrinkPolicy Shrink = DefaultShrinkPolicy,
+                    typename ReadMode = LockedReadsTag>
+    class ConcurrentMap
+    {
+        using Traits = ReadModeTraits<ReadMode, Allocator>;
+        using MapType = Map<Key,
+                            Value,
+                            Hash,
+                            Equal,
+                            Policy,
+                            Backend,
+                            typename Traits::allocator_type,
+                            LoadFactorRatio,
+                            HashStoragePolicy,
+                            Prober,
+                            Shrink>;
+        using ShardType = typename Traits::template shard_type<MapType>;
+
+        static_assert(!Traits::optimistic
+                          || (std::is_trivially_copyable_v<Key>
+                              && std::is_trivially_copyable_v<Value>),
+                      "OptimisticReadsTag requires trivially copyable keys and values");
+
+      public:
+        using key_type = Key;
+        using mapped_type = Value;
+        using value_type = std::pair<Key const, Value>;
+        using size_type = std::size_t;
+        using hasher = Hash;
+        using key_equal = Equal;
+
+        /// shardCount is rounded up to a power of two.
+        explicit ConcurrentMap(size_t shardCount = defaultShardCount())
+            : shards_(shardCount)
+        {
+        }
+
+        ConcurrentMap(ConcurrentMap const&) = delete;
+        ConcurrentMap& operator=(ConcurrentMap const&) = delete;
+
+        /// Inserts a value constructed from args under key if the key is not present.
+        /// Returns true if insertion took place.
+        template<typename... Args>
+        bool try_emplace(Key const& key, Args&&... args)
+        {
+            size_t hash = hasher_(key);
+            return shardFor(hash).write(
+                [&](MapType& table)
+                { return emplaceIn(table, hash, key, std::forward<Args>(args)...).second; });
+        }
+
+        bool insert(value_type const& value) { return try_emplace(value.first, value.second); }
+
+        bool insert(value_type&& value)
+        {
+            return try_emplace(value.first, std::move(value.second));
+        }
+
+        /// Inserts obj under key, or assigns it to the existing value.
+        /// Returns true if insertion took place.
+        template<typename M>
+        bool insert_or_assign(Key const& key, M&& obj)
+        {
+            size_t hash = hasher_(key);
+            return shardFor(hash).write(
+                [&](MapType& table)
+                {
+                    auto [it, inserted] = emplaceIn(table, hash, key, std::forward<M>(obj));
+                    if (!inserted)
+                    {
+                        it->second = std::forward<M>(obj);
+                    }
+                    return inserted;
+                });
+        }
+
+        /// Inserts value if its key is absent, and otherwise calls fn on the existing
+        /// element, which it may modify. Returns true if insertion took place.
+        template<typename F>
+            requires std::invocable<F&, value_type&>
+        bool insert_or_visit(value_type const& value, F&& fn)
+        {
+            return insertOrVisit(value.first, std::forward<F>(fn), value.second);
+        }
+
+        template<typename F>
+            requires std::invocable<F&, value_type&>
+        bool insert_or_visit(value_type&& value, F&& fn)
+        {
+            return insertOrVisit(value.first, std::forward<F>(fn), std::move(value.second));
+        }
+
+        /// Calls fn on the element with key, which it may modify, if there is one.
+        /// Returns true if the key was found.
+        template<typename F>
+            requires std::invocable<F&, value_type&>
+        bool visit(Key const& key, F&& fn)
+        {
+            size_t hash = hasher_(key);
+            return shardFor(hash).write(
+                [&](MapType& table)
+                {
+                    auto it = table.find_with_hash(key, hash);
+                    if (it == table.end())
+                    {
+                        return false;
+                    }
+                    std::invoke(fn, *it);
+                    return true;
+                });
+        }
+
+        /// Calls fn on the element with key, if there is one, without modifying it.
+        /// Other readers of the same shard run in parallel. Returns true if found.
+        template<typename F>
+            requires std::invocable<F&, value_type const&>
+        bool cvisit(Key const& key, F&& fn) const
+        {
+            size_t hash = hasher_(key);
+            if constexpr (Traits::optimistic)
+            {
+                auto copy = shardFor(hash).readOptimistic(
+                    [&](auto const& table, auto const& snapshotValid)
+                    {
+                        auto const* element = table.find_optimistic(key, hash, snapshotValid);
+                        return element == nullptr ? std::optional<value_type>()
+                                                  : std::optional<value_type>(*element);
+                    });
+                if (!copy)
+                {
+                    return false;
+                }
+                std::invoke(fn, std::as_const(*copy));
+                return true;
+            }
+            else
+            {
+                return shardFor(hash).read(
+                    [&](MapType const& table)
+                    {
+                        auto it = table.find_with_hash(key, hash);
+                        if (it == table.end())
+                        {
+                            return false;
+                        }
+                        std::invoke(fn, *it);
+                        return true;
+                    });
+            }
+        }
+
+        bool contains(Key const& key) const
+        {
+            size_t hash = hasher_(key);
+            if constexpr (Traits::optimistic)
+            {
+                return shardFor(hash).readOptimistic(
+                    [&](auto const& table, auto const& snapshotValid)
+                    { return table.find_optimistic(key, hash, snapshotValid) != nullptr; });
+            }
+            else
+            {
+                return shardFor(hash).read([&](MapType const& table)
+                                           { return table.contains_with_hash(key, hash); });
+            }
+        }
+
+        size_type erase(Key const& key)
+        {
+            size_t hash = hasher_(key);
+            return shardFor(hash).write(
+                [&](MapType& table) -> size_type
+                {
+                    auto it = table.find_with_hash(key, hash);
+                    if (it == table.end())
+                    {
+                        return 0;
+                    }
+                    table.erase(it);
+                    return 1;
+                });
+        }
+
+        /// Calls fn on every element, locking one shard at a time. Elements inserted or
+        /// erased concurrently in shards not yet visited may or may not be seen.
+        template<typename F>
+            requires std::invocable<F&, value_type&>
+        void visit_all(F&& fn)
+        {
+            shards_.forEach(
+                [&](MapType& table)
+                {
+                    for (auto& element : table)
+                    {
+                        std::invoke(fn, element);
+                    }
+                });
+        }
+
+        template<typename F>
+            requires std::invocable<F&, value_type const&>
+        void cvisit_all(F&& fn) const
+        {
+            shards_.forEach(
+                [&](MapType const& table)
+                {
+                    for (auto const& element : table)
+                    {
+                        std::invoke(fn, element);
+                    }
+                });
+        }
+
+        /// Number of elements, summed over the shards one at a time; only exact while no
+        /// other thread modifies the map.
+        [[nodiscard]] size_type size() const
+        {
+            size_type total = 0;
+            shards_.forEach([&](MapType const& table) { total += table.size(); });
+            return total;
+        }
+
+        [[nodiscard]] bool empty() const { return size() == 0; }
+
+        void clear()
+        {
+            shards_.forEach([](MapType& table) { table.clear(); });
+        }
+
+        /// Makes room for count elements in total, assuming they spread evenly.
+        void reserve(size_type count)
+        {
+            size_type perShard = (count + shards_.count() - 1) / shards_.count();
+            shards_.forEach([&](MapType& table) { table.reserve(perShard); });
+        }
+
+        [[nodiscard]] size_t shard_count() const noexcept { return shards_.count(); }
+
+        hasher hash_function() const { return hasher_; }
+
+      private:
+        ShardType& shardFor(size_t hash) const noexcept
+        {
+            return shards_.forHash(Policy::apply(hash));
+        }
+
+        /// try_emplace with the hash computed for picking the shard.
+        template<typename... Args>
+        static auto emplaceIn(MapType& table, size_t hash, Key const& key, Args&&... args)
+        {
+            return table.emplace_with_hash(hash,
+                                           std::piecewise_construct,
+                                           std::forward_as_tuple(key),
+                                           std::forward_as_tuple(std::forward<Args>(args)...));
+        }
+
+        template<typename F, typename V>
+        bool insertOrVisit(Key const& key, F&& fn, V&& value)
+        {
+            size_t hash = hasher_(key);
+            return shardFor(hash).write(
+                [&](MapType& table)
+                {
+                    auto [it, inserted] = emplaceIn(table, hash, key, std::forward<V>(value));
+                    if (!inserted)
+                    {
+                        std::invoke(fn, *it);
+                    }
+                    return inserted;
+                });
+        }
+
+        [[no_unique_address]] Hash hasher_;
+        ShardArray<ShardType> shards_;
+    };
+
+    /// A hash set safe for concurrent use, split into independently locked Set shards.
+    /// Like ConcurrentMap, elements are only reached through callbacks run under the lock,
+    /// or with OptimisticReadsTag, visit and contains run without it on a copy.
+    export template<typename T,
+                    typename Hash = RapidHasher,
+                    typename Equal = std::equal_to<T>,
+                    typename Policy = HashPolicySelector<T, Hash>::type,
+                    SimdBackend Backend = DefaultBackend,
+                    typename Allocator = std::allocator<std::byte>,
+                    typename LoadFactorRatio = typename DefaultLoadFactorSelector<Backend>::type,
+                    typename HashStoragePolicy = typename HashStorageSelector<T>::type,
+                    typename Prober = DefaultProber,
+                    ShrinkPolicy Shrink = DefaultShrinkPolicy,
+                    typename ReadMode = LockedReadsTag>
+    class ConcurrentSet
+    {
+        using Traits = ReadModeTraits<ReadMode, Allocator>;
+        using SetType = Set<T,
+                            Hash,
+                            Equal,
+                            Policy,
+                            Backend,
+                            typename Traits::allocator_type,
+                            LoadFactorRatio,
+                            HashStoragePolicy,
+                            Prober,
+                            Shrink>;
+        using ShardType = typename Traits::template shard_type<SetType>;
+
+        static_assert(!Traits::optimistic || std::is_trivially_copyable_v<T>,
+                      "OptimisticReadsTag requires trivially copyable elements");
+
+      public:
+        using key_type = T;
+        using value_type = T;
+        using size_type = std::size_t;
+        using hasher = Hash;
+        using key_equal = Equal;
+
+        /// shardCount is rounded up to a power of two.
+        explicit ConcurrentSet(size_t shardCount = defaultShardCount())
+            : shards_(shardCount)
+        {
+        }
+
+        ConcurrentSet(ConcurrentSet const&) = delete;
+        ConcurrentSet& operator=(ConcurrentSet const&) = delete;
+
+        /// Returns true if insertion took place.
+        bool insert(T const& value)
+        {
+            return insert_or_visit(value, [](T const&) {});
+        }
+
+        bool insert(T&& value)
+        {
+            return insert_or_visit(std::move(value), [](T const&) {});
+        }
+
+        /// Inserts value if it is absent, and otherwise calls fn on the equal element
+        /// already present. Returns true if insertion took place.
+        template<typename V, typename F>
+            requires std::is_same_v<std::remove_cvref_t<V>, T> && std::invocable<F&, T const&>
+        bool insert_or_visit(V&& value, F&& fn)
+        {
+            size_t hash = hasher_(value);
+            return shardFor(hash).write(
+                [&](SetType& table)
+                {
+                    auto [it, inserted] = table.emplace_with_hash(hash, std::forward<V>(value));
+                    if (!inserted)
+                    {
+                        std::invoke(fn, *it);
+                    }
+                    return inserted;
+                });
+        }
+
+        /// Calls fn on the element equal to key, if there is one. Other readers of the
+        /// same shard run in parallel. Returns true if found.
+        template<typename F>
+            requires std::invocable<F&, T const&>
+        bool visit(T const& key, F&& fn) const
+        {
+            size_t hash = hasher_(key);
+            if constexpr (Traits::optimistic)
+            {
+                auto copy = shardFor(hash).readOptimistic(
+                    [&](auto const& table, auto const& snapshotValid)
+                    {
+                        auto const* element = table.find_optimistic(key, hash, snapshotValid);
+                        return element == nullptr ? std::optional<T>() : std::optional<T>(*element);
+                    });
+                if (!copy)
+                {
+                    return false;
+                }
+                std::invoke(fn, std::as_const(*copy));
+                return true;
+            }
+            else
+            {
+                return shardFor(hash).read(
+                    [&](SetType const& table)
+                    {
+                        auto it = table.find_with_hash(key, hash);
+                        if (it == table.end())
+                        {
+                            return false;
+                        }
+                        std::invoke(fn, *it);
+                        return true;
+                    });
+            }
+        }
+
+        bool contains(T const& key) const
+        {
+            size_t hash = hasher_(key);
+            if constexpr (Traits::optimistic)
+            {
+                return shardFor(hash).readOptimistic(
+                    [&](auto const& table, auto const& snapshotValid)
+                    { return table.find_optimistic(key, hash, snapshotValid) != nullptr; });
+            }
+            else
+            {
+                return shardFor(hash).read([&](SetType const& table)
+                                           { return table.contains_with_hash(key, hash); });
+            }
+        }
+
+        size_type erase(T const& key)
+        {
+            size_t hash = hasher_(key);
+            return shardFor(hash).write(
+                [&](SetType& table) -> size_type
+                {
+                    auto it = table.find_with_hash(key, hash);
+                    if (it == table.end())
+                    {
+                        return 0;
+                    }
+                    table.erase(it);
+                    return 1;
+                });
+        }
+
+        /// Calls fn on every element, locking one shard at a time.
+        template<typename F>
+            requires std::invocable<F&, T const&>
+        void visit_all(F&& fn) const
+        {
+            shards_.forEach(
+                [&](SetType const& table)
+                {
+                    for (auto const& element : table)
+                    {
+                        std::invoke(fn, element);
+                    }
+                });
+        }
+
+        /// Number of elements, summed over the shards one at a time; only exact while no
+        /// other thread modifies the set.
+        [[nodiscard]] size_type size() const
+        {
+            size_type total = 0;
+            shards_.forEach([&](SetType const& table) { total += table.size(); });
+            return total;
+        }
+
+        [[nodiscard]] bool empty() const { return size() == 0; }
+
+        void clear()
+        {
+            shards_.forEach([](SetType& table) { table.clear(); });
+        }
+
+        /// Makes room for count elements in total, assuming they spread evenly.
+        void reserve(size_type count)
+        {
+            size_type perShard = (count + shards_.count() - 1) / shards_.count();
+            shards_.forEach([&](SetType& table) { table.reserve(perShard); });
+        }
+
+        [[nodiscard]] size_t shard_count() const noexcept { return shards_.count(); }
+
+        hasher hash_function() const { return hasher_; }
+
+      private:
+        ShardType& shardFor(size_t hash) const noexcept
+        {
+            return shards_.forHash(Policy::apply(hash));
+        }
+
+        [[no_unique_address]] Hash hasher_;
+        ShardArray<ShardType> shards_;
+    };
+
+    /// A map for read-mostly data, such as configuration or routing tables, whose contents
+    /// are published as immutable Map versions. Readers look up the current version
+    /// without locks, retries or writes to shared memory. Writers copy the current version,
+    /// apply their changes and publish the copy, so each update costs a full copy and
+    /// should batch as many changes as it can. Replaced versions are freed by the writer
+    /// once no read that could have seen them is still in progress.
+    export template<typename Key,
+                    typename Value,
+                    typename Hash = RapidHasher,
+                    typename Equal = std::equal_to<Key>,
+                    typename Policy = HashPolicySelector<Key, Hash>::type,
+                    SimdBackend Backend = DefaultBackend,
+                    typename Allocator = std::allocator<std::byte>,
+                    typename LoadFactorRatio = typename DefaultLoadFactorSelector<Backend>::type,
+                    typename HashStoragePolicy =
+                        typename HashStorageSelector<std::pair<Key const, Value>>::type,
+                    typename Prober = DefaultProber,
+                    ShrinkPolicy Shrink = DefaultShrinkPolicy>
+    class SnapshotMap
+    {
+      public:
+        using map_type = Map<Key,
+                             Value,
+                             Hash,
+                             Equal,
+                             Policy,
+                             Backend,
+                             Allocator,
+                             LoadFactorRatio,
+                             HashStoragePolicy,
+                             Prober,
+                             Shrink>;
+        using key_type = Key;
+        using mapped_type = Value;
+        using value_type = std::pair<Key const, Value>;
+        using size_type = std::size_t;
+
+        SnapshotMap()
+            : SnapshotMap(map_type())
+        {
+        }
+
+        explicit SnapshotMap(map_type map)
+            : current_(new Version {std::move(map)})
+        {
+        }
+
+        SnapshotMap(SnapshotMap const&) = delete;
+        SnapshotMap& operator=(SnapshotMap const&) = delete;
+
+        /// No reads or updates may be in progress.
+        ~SnapshotMap()
+        {
+            delete current_.load(std::memory_order_relaxed);
+            while (retired_ != nullptr)
+            {
+                delete std::exchange(retired_, retired_->nextRetired);
+            }
+        }
+
+        /// Runs fn on the current version and returns its result. The version stays
+        /// alive and unchanged until fn returns, whatever is published meanwhile.
+        template<typename F>
+            requires std::invocable<F&, map_type const&>
+        decltype(auto) read(F&& fn) const
+        {
+            EpochGuard guard;
+            return std::invoke(fn, std::as_const(current_.load()->map));
+        }
+
+        /// Calls fn on the element with key in the current version, if there is one.
+        /// Returns true if the key was found.
+        template<typename F>
+            requires std::invocable<F&, value_type const&>
+        bool cvisit(Key const& key, F&& fn) const
+        {
+            return read(
+                [&](map_type const& map)
+                {
+                    auto it = map.find(key);
+                    if (it == map.end())
+                    {
+                        return false;
+                    }
+                    std::invoke(fn, *it);
+                    return true;
+                });
+        }
+
+        bool contains(Key const& key) const
+        {
+            return read([&](map_type const& map) { return map.contains(key); });
+        }
+
+        [[nodiscard]] size_type size() const
+        {
+            return read([](map_type const& map) { return map.size(); });
+        }
+
+        [[nodiscard]] bool empty() const { return size() == 0; }
+
+        /// Publishes a copy of the current version modified by fn. Updates are serialized,
+        /// and readers see either none or all of the changes fn makes.
+        template<typename F>
+            requires std::invocable<F&, map_type&>
+        void update(F&& fn)
+        {
+            std::unique_lock lock(writeMutex_);
+            publishCopy(fn);
+        }
+
+        /// Publishes map as the new version, without copying the current one.
+        void replace(map_type map)
+        {
+            auto next = std::make_unique<Version>(std::move(map));
+            std::unique_lock lock(writeMutex_);
+            publish(next.release());
+        }
+
+        /// Publishes a version with obj under key. Returns true if insertion took place.
+        template<typename M>
+        bool insert_or_assign(Key const& key, M&& obj)
+        {
+            bool inserted = false;
+            update([&](map_type& map)
+                   { inserted = map.insert_or_assign(key, std::forward<M>(obj)).second; });
+            return inserted;
+        }
+
+        /// Publishes a version without key, if it is present.
+        size_type erase(Key const& key)
+        {
+            std::unique_lock lock(writeMutex_);
+            if (!current_.load(std::memory_order_relaxed)->map.contains(key))
+            {
+                return 0;
+            }
+            publishCopy([&](map_type& map) { map.erase(key); });
+            return 1;
+        }
+
+        void clear() { replace(map_type()); }
+
+      private:
+        struct Version
+        {
+            map_type map;
+            /// Epoch after which no new read can reach this version, once replaced.
+            uint64_t retiredAt = 0;
+            Version* nextRetired = nullptr;
+        };
+
+        /// Publishes a copy of the current version modified by fn. Requires writeMutex_.
+        template<typename F>
+        void publishCopy(F&& fn)
+        {
+            auto next = std::make_unique<Version>(current_.load(std::memory_order_relaxed)->map);
+            std::invoke(fn, next->map);
+            publish(next.release());
+        }
+
+        /// Makes next the current version and frees the versions no read can still be
+        /// using. Requires writeMutex_.
+        void publish(Version* next)
+        {
+            auto& domain = EpochDomain::instance();
+            Version* previous = current_.exchange(next);
+            previous->retiredAt = domain.advance();
+            previous->nextRetired = retired_;
+            retired_ = previous;
+
+            uint64_t oldest = domain.oldestActive();
+            for (Version** link = &retired_; *link != nullptr;)
+            {
+                Version* version = *link;
+                if (version->retiredAt <= oldest)
+                {
+                    *link = version->nextRetired;
+                    delete version;
+                }
+                else
+                {
+                    link = &version->nextRetired;
+                }
+            }
+        }
+
+        std::atomic<Version*> current_;
+        /// Replaced versions that reads may still be using, newest first.
+        Version* retired_ = nullptr;
+        std::mutex writeMutex_;
+    };
+
+    /// Control byte of a slot an inserting thread has claimed but not yet published.
+    inline constexpr ctrl_t busyCtrl = 0b11111100;
+    /// Control byte of a slot that was empty when a resize froze its group.
+    inline constexpr ctrl_t movedCtrl = 0b11111101;
+
+    /// A hash set that threads insert into and query without locks, for workloads that
+    /// never erase, such as deduplicating IDs. Inserting threads claim an empty slot by
+    /// moving its control byte to a busy state, construct the element, then publish its
+    /// h2. When the set grows, threads that need room help copy groups into the larger
+    /// buffer, and the replaced buffer is freed through epoch-based reclamation. Lookups
+    /// are wait-free; an insertion may wait for another thread to finish an insertion
+    /// into the same group, or for a resize to finish. Control bytes are read with vector
+    /// loads ordered by fences, which ThreadSanitizer reports as races.
+    export template<typename T,
+                    typename Hash = RapidHasher,
+                    typename Equal = std::equal_to<T>,
+                    typename Policy = HashPolicySelector<T, Hash>::type,
+                    SimdBackend Backend = DefaultBackend,
+                    typename LoadFactorRatio = typename DefaultLoadFactorSelector<Backend>::type,
+                    typename Prober = DefaultProber>
+    class GrowOnlySet
+    {
+        static constexpr size_t LANE_COUNT = Backend::GroupSize;
+        /// Number of groups a thread claims at once while helping with a resize.
+        static constexpr size_t migrateChunk = 16;
+
+        /// Uninitialized storage for one element.
+        struct alignas(T) SlotStorage
+        {
+            std::byte bytes[sizeof(T)];
+        };
+
+        /// One generation of the set's memory, replaced wholesale when the set grows.
+        struct Buffer
+        {
+            size_t groups;
+            size_t growthLimit;
+            ctrl_t* ctrl;
+            SlotStorage* slots;
+            /// Slots claimed so far, including those still busy.
+            std::atomic<size_t> claimed = 0;
+            /// The buffer this one is being copied into, once a resize has started.
+            std::atomic<Buffer*> next = nullptr;
+            /// First group not yet handed to a thread helping with the resize.
+            std::atomic<size_t> migrateCursor = 0;
+            std::atomic<size_t> migratedGroups = 0;
+            uint64_t retiredAt = 0;
+            Buffer* nextRetired = nullptr;
+
+            explicit Buffer(size_t groupCount)
+                : groups(groupCount)
+                , growthLimit(groupCount * LANE_COUNT * LoadFactorRatio::num / LoadFactorRatio::den)
+                , ctrl(static_cast<ctrl_t*>(
+                      ::operator new(groupCount * LANE_COUNT, std::align_val_t {LANE_COUNT})))
+                , slots(static_cast<SlotStorage*>(::operator new(
+                      groupCount * LANE_COUNT * sizeof(SlotStorage),
+                      std::align_val_t {alignof(SlotStorage)})))
+            {
+                std::fill_n(ctrl, groupCount * LANE_COUNT, static_cast<ctrl_t>(Ctrl::Empty));
+            }
+
+            Buffer(Buffer const&) = delete;
+            Buffer& operator=(Buffer const&) = delete;
+
+            /// No thread may be using the buffer any more.
+            ~Buffer()
+            {
+                size_t capacity = groups * LANE_COUNT;
+                for (size_t i = 0; i < capacity; ++i)
+                {
+                    if ((ctrl[i] & 0x80) == 0)
+                    {
+                        std::destroy_at(element(i));
+                    }
+                }
+                ::operator delete(ctrl, capacity, std::align_val_t {LANE_COUNT});
+                ::operator delete(
+                    slots, capacity * sizeof(SlotStorage), std::align_val_t {alignof(SlotStorage)});
+            }
+
+            T* element(size_t idx) noexcept
+            {
+                return std::launder(reinterpret_cast<T*>(slots[idx].bytes));
+            }
+
+            T const* element(size_t idx) const noexcept
+            {
+                return std::launder(reinterpret_cast<T const*>(slots[idx].bytes));
+            }
+
+            /// Loads the control bytes of a group. The bytes are read with one vector load
+            /// while other threads may be storing to them, and the fence makes the elements
+            /// behind the control bytes seen as published visible.
+            typename Backend::Register loadGroup(size_t group) const noexcept
+            {
+                auto data = Backend::load(ctrl + group * LANE_COUNT);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                return data;
+            }
+
+            std::atomic_ref<ctrl_t> ctrlAt(size_t idx) const noexcept
+            {
+                return std::atomic_ref<ctrl_t>(ctrl[idx]);
+            }
+        };
+
+        enum class InsertResult
+        {
+            Inserted,
+            Found,
+            NeedsResize,
+        };
+
+      public:
+        using key_type = T;
+        using value_type = T;
+        using size_type = std::size_t;
+        using hasher = Hash;
+        using key_equal = Equal;
+
+        /// Sized so that capacity elements fit before the first resize.
+        explicit GrowOnlySet(size_type capacity = 0)
+            : current_(new Buffer(groupsFor(capacity)))
+        {
+        }
+
+        GrowOnlySet(GrowOnlySet const&) = delete;
+        GrowOnlySet& operator=(GrowOnlySet const&) = delete;
+
+        /// No other thread may be using the set.
+        ~GrowOnlySet()
+        {
+            Buffer* buffer = current_.load(std::memory_order_relaxed);
+            delete buffer->next.load(std::memory_order_relaxed);
+            delete buffer;
+            while (retired_ != nullptr)
+            {
+                delete std::exchange(retired_, retired_->nextRetired);
+            }
+        }
+
+        /// Returns true if insertion took place.
+        bool insert(T const& value) { return insertImpl(value); }
+
+        bool insert(T&& value) { return insertImpl(std::move(value)); }
+
+        bool contains(T const& key) const
+        {
+            size_t hash = Policy::apply(hasher_(key));
+            EpochGuard guard;
+            return find(*current_.load(), key, hash);
+        }
+
+        /// Number of elements; only exact while no other thread inserts.
+        [[nodiscard]] size_type size() const
+        {
+            EpochGuard guard;
+            return current_.load()->claimed.load();
+        }
+
+        [[nodiscard]] bool empty() const { return size() == 0; }
+
+        [[nodiscard]] size_type capacity() const
+        {
+            EpochGuard guard;
+            return current_.load()->groups * LANE_COUNT;
+        }
+
+        /// Calls fn on every element. Elements inserted concurrently may or may not be seen.
+        template<typename F>
+            requires std::invocable<F&, T const&>
+        void for_each(F&& fn) const
+        {
+            EpochGuard guard;
+            Buffer const& buffer = *current_.load();
+            for (size_t group = 0; group < buffer.groups; ++group)
+            {
+                auto data = buffer.loadGroup(group);
+                for (int lane : Backend::iterate(Backend::matchFull(data)))
+                {
+                    std::invoke(fn, *buffer.element(group * LANE_COUNT + lane));
+                }
+            }
+        }
+
+        hasher hash_function() const { return hasher_; }
+
+      private:
+        static constexpr size_t h1(size_t hash) noexcept { return hash >> 7; }
+        static constexpr ctrl_t h2(size_t hash) noexcept { return hash & 0x7F; }
+
+        static size_t groupsFor(size_t capacity) noexcept
+        {
+            size_t slots = capacity * LoadFactorRatio::den / LoadFactorRatio::num + 1;
+            return std::bit_ceil(std::max<size_t>((slots + LANE_COUNT - 1) / LANE_COUNT, 1));
+        }
+
+        template<typename V>
+        bool insertImpl(V&& value)
+        {
+            size_t hash = Policy::apply(hasher_(value));
+            EpochGuard guard;
+            while (true)
+            {
+                Buffer* buffer = current_.load();
+                switch (tryInsert(*buffer, hash, std::forward<V>(value)))
+                {
+                    case InsertResult::Inserted:
+                        return true;
+                    case InsertResult::Found:
+                        return false;
+                    case InsertResult::NeedsResize:
+                        grow(buffer);
+                        break;
+                }
+            }
+        }
+
+        bool find(Buffer const& buffer, T const& key, size_t hash) const
+        {
+            size_t mask = buffer.groups - 1;
+            auto group = h1(hash) & mask;
+            auto h2Val = h2(hash);
+            Prober prober {group};
+            for (size_t step = 0; step < buffer.groups; ++step)
+            {
+                auto data = buffer.loadGroup(group);
+                for (int lane : Backend::iterate(Backend::match(data, h2Val)))
+                {
+                    if (equal_(key, *buffer.element(group * LANE_COUNT + lane)))
+                    {
+                        return true;
+                    }
+                }
+                // Frozen slots were empty, so the probe of any element ends before them too
+                if (Backend::any(Backend::matchEmpty(data))
+                    || Backend::any(Backend::match(data, movedCtrl)))
+                {
+                    return false;
+                }
+                group = prober.nextGroup(group, mask);
+            }
+            return false;
+        }
+
+        /// Inserts value into buffer unless an equal element is there, or reports that the
+        /// buffer is full or being replaced.
+        template<typename V>
+        InsertResult tryInsert(Buffer& buffer, size_t hash, V&& value)
+        {
+            size_t mask = buffer.groups - 1;
+            auto group = h1(hash) & mask;
+            auto h2Val = h2(hash);
+            Prober prober {group};
+            for (size_t step = 0; step < buffer.groups; ++step)
+            {
+                // Repeated whenever another thread changes the group underneath
+                while (true)
+                {
+                    auto data = buffer.loadGroup(group);
+                    auto busy = Backend::match(data, busyCtrl);
+                    if (Backend::any(busy))
+                    {
+                        // A busy slot may be about to hold an equal element
+                        for (int lane : Backend::iterate(busy))
+                        {
+                            waitWhileBusy(buffer, group * LANE_COUNT + lane);
+                        }
+                        continue;
+                    }
+                    for (int lane : Backend::iterate(Backend::match(data, h2Val)))
+                    {
+                        if (equal_(value, *buffer.element(group * LANE_COUNT + lane)))
+                        {
+                            return InsertResult::Found;
+                        }
+                    }
+                    if (Backend::any(Backend::match(data, movedCtrl)))
+                    {
+                        return InsertResult::NeedsResize;
+                    }
+                    auto lane = Backend::firstTrue(Backend::matchEmpty(data));
+                    if (!lane)
+                    {
+                        break;
+                    }
+                    if (buffer.claimed.load(std::memory_order_relaxed) >= buffer.growthLimit)
+                    {
+                        return InsertResult::NeedsResize;
+                    }
+                    size_t idx = group * LANE_COUNT + *lane;
+                    auto expected = static_cast<ctrl_t>(Ctrl::Empty);
+                    if (!buffer.ctrlAt(idx).compare_exchange_strong(expected, busyCtrl))
+                    {
+                        continue;
+                    }
+                    buffer.claimed.fetch_add(1, std::memory_order_relaxed);
+                    try
+                    {
+                        std::construct_at(buffer.element(idx), std::forward<V>(value));
+                    }
+                    catch (...)
+                    {
+                        buffer.claimed.fetch_sub(1, std::memory_order_relaxed);
+                        buffer.ctrlAt(idx).store(static_cast<ctrl_t>(Ctrl::Empty));
+                        throw;
+                    }
+                    buffer.ctrlAt(idx).store(h2Val, std::memory_order_release);
+                    return InsertResult::Inserted;
+                }
+                group = prober.nextGroup(group, mask);
+            }
+            return InsertResult::NeedsResize;
+        }
+
+        static void waitWhileBusy(Buffer const& buffer, size_t idx) noexcept
+        {
+            while (buffer.ctrlAt(idx).load(std::memory_order_acquire) == busyCtrl)
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        /// Replaces buffer with one twice its size, or helps a resize already started, and
+        /// returns once the new buffer is current.
+        void grow(Buffer* buffer)
+        {
+            Buffer* next = buffer->next.load(std::memory_order_acquire);
+            if (next == nullptr)
+            {
+                auto fresh = std::make_unique<Buffer>(buffer->groups * 2);
+                if (buffer->next.compare_exchange_strong(next, fresh.get()))
+                {
+                    next = fresh.release();
+                }
+            }
+
+            while (true)
+            {
+                size_t first = buffer->migrateCursor.fetch_add(migrateChunk);
+                if (first >= buffer->groups)
+                {
+                    break;
+                }
+                size_t last = std::min(first + migrateChunk, buffer->groups);
+                for (size_t group = first; group < last; ++group)
+                {
+                    migrateGroup(*buffer, *next, group);
+                }
+                size_t count = last - first;
+                if (buffer->migratedGroups.fetch_add(count) + count == buffer->groups)
+                {
+                    current_.store(next);
+                    retire(buffer);
+                }
+            }
+
+            while (current_.load(std::memory_order_acquire) == buffer)
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        /// Freezes the empty slots of a group so that nothing more is inserted there, then
+        /// copies its elements into next. Copies that throw terminate, as the resize could
+        /// not complete.
+        void migrateGroup(Buffer& buffer, Buffer& next, size_t group) noexcept
+        {
+            for (size_t idx = group * LANE_COUNT; idx < (group + 1) * LANE_COUNT; ++idx)
+            {
+                auto ctrl = buffer.ctrlAt(idx);
+                ctrl_t value = ctrl.load(std::memory_order_acquire);
+                // An insertion that fails turns its busy slot back into an empty one
+                while (value == busyCtrl || value == static_cast<ctrl_t>(Ctrl::Empty))
+                {
+                    if (value == busyCtrl)
+                    {
+                        std::this_thread::yield();
+                        value = ctrl.load(std::memory_order_acquire);
+                    }
+                    else if (ctrl.compare_exchange_weak(value, movedCtrl))
+                    {
+                        value = movedCtrl;
+                    }
+                }
+                if ((value & 0x80) == 0)
+                {
+                    T const& element = *buffer.element(idx);
+                    place(next, Policy::apply(hasher_(element)), element);
+                }
+            }
+        }
+
+        /// Copies element into the first empty slot of its probe sequence in buffer, which
+        /// only threads helping with the same resize write to.
+        static void place(Buffer& buffer, size_t hash, T const& element)
+        {
+            size_t mask = buffer.groups - 1;
+            auto group = h1(hash) & mask;
+            Prober prober {group};
+            while (true)
+            {
+                auto data = buffer.loadGroup(group);
+                for (int lane : Backend::iterate(Backend::matchEmpty(data)))
+                {
+                    size_t idx = group * LANE_COUNT + lane;
+                    auto expected = static_cast<ctrl_t>(Ctrl::Empty);
+                    if (buffer.ctrlAt(idx).compare_exchange_strong(expected, busyCtrl))
+                    {
+                        std::construct_at(buffer.element(idx), element);
+                        buffer.claimed.fetch_add(1, std::memory_order_relaxed);
+                        buffer.ctrlAt(idx).store(h2(hash), std::memory_order_release);
+                        return;
+                    }
+                }
+                if (!Backend::any(Backend::matchEmpty(buffer.loadGroup(group))))
+                {
+                    group = prober.nextGroup(group, mask);
+                }
+            }
+        }
+
+        /// Hands a replaced buffer to epoch-based reclamation, and frees the ones no thread
+        /// can still be using.
+        void retire(Buffer* buffer)
+        {
+            auto& domain = EpochDomain::instance();
+            std::unique_lock lock(retireMutex_);
+            buffer->retiredAt = domain.advance();
+            buffer->nextRetired = retired_;
+            retired_ = buffer;
+
+            uint64_t oldest = domain.oldestActive();
+            for (Buffer** link = &retired_; *link != nullptr;)
+            {
+                Buffer* retired = *link;
+                if (retired->retiredAt <= oldest)
+                {
+                    *link = retired->nextRetired;
+                    delete retired;
+                }
+                else
+                {
+                    link = &retired->nextRetired;
+                }
+            }
+        }
+
+        [[no_unique_address]] Hash hasher_;
+        [[no_unique_address]] Equal equal_;
+        std::atomic<Buffer*> current_;
+        /// Replaced buffers that threads may still be reading, newest first. Only touched
+        /// when a resize completes.
+        Buffer* retired_ = nullptr;
+        std::mutex retireMutex_;
+    };
+
+    /// Bounded queue between one producing and one consuming thread. The producer makes
+    /// pushed items visible in batches, so the indices shared between the two threads are
+    /// written once per batch rather than once per item.
+    template<typename T>
+    class SpscRing
+    {
+      public:
+        /// capacity is rounded up to a power of two.
+        explicit SpscRing(size_t capacity)
+            : mask_(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1)
+            , items_(static_cast<Storage*>(::operator new(
+                  (mask_ + 1) * sizeof(Storage), std::align_val_t {alignof(Storage)})))
+        {
+        }
+
+        SpscRing(SpscRing const&) = delete;
+        SpscRing& operator=(SpscRing const&) = delete;
+
+        ~SpscRing()
+        {
+            for (uint64_t i = head_.load(std::memory_order_relaxed); i != writeIndex_; ++i)
+            {
+                std::destroy_at(itemAt(i));
+            }
+            ::operator delete(
+                items_, (mask_ + 1) * sizeof(Storage), std::align_val_t {alignof(Storage)});
+        }
+
+        /// Producer: moves item into the ring without publishing it, unless the ring is full.
+        bool tryPush(T& item)
+        {
+            if (writeIndex_ - cachedHead_ > mask_)
+            {
+                cachedHead_ = head_.load(std::memory_order_acquire);
+                if (writeIndex_ - cachedHead_ > mask_)
+                {
+                    return false;
+                }
+            }
+            std::construct_at(itemAt(writeIndex_), std::move(item));
+            ++writeIndex_;
+            return true;
+        }
+
+        /// Producer: makes every pushed item visible to the consumer.
+        void publish() noexcept { tail_.store(writeIndex_, std::memory_order_release); }
+
+        /// Producer: number of items pushed but not yet published.
+        [[nodiscard]] size_t unpublished() const noexcept
+        {
+            return writeIndex_ - tail_.load(std::memory_order_relaxed);
+        }
+
+        /// Number of items ever published.
+        [[nodiscard]] uint64_t published() const noexcept
+        {
+            return tail_.load(std::memory_order_acquire);
+        }
+
+        /// Number of items ever consumed.
+        [[nodiscard]] uint64_t consumed() const noexcept
+        {
+            return head_.load(std::memory_order_acquire);
+        }
+
+        /// Consumer: calls fn on every published item in order and frees their space.
+        /// Returns the number of items consumed. If fn throws, the item it threw on is
+        /// freed along with those before it, and the exception propagates.
+        template<typename F>
+        size_t consume(F&& fn)
+        {
+            uint64_t head = head_.load(std::memory_order_relaxed);
+            uint64_t tail = tail_.load(std::memory_order_acquire);
+            for (uint64_t i = head; i != tail; ++i)
+            {
+                try
+                {
+                    fn(*itemAt(i));
+                }
+                catch (...)
+                {
+                    std::destroy_at(itemAt(i));
+                    head_.store(i + 1, std::memory_order_release);
+                    throw;
+                }
+                std::destroy_at(itemAt(i));
+            }
+            head_.store(tail, std::memory_order_release);
+            return tail - head;
+        }
+
+      private:
+        struct alignas(T) Storage
+        {
+            std::byte bytes[sizeof(T)];
+        };
+
+        T* itemAt(uint64_t index) noexcept
+        {
+            return std::launder(reinterpret_cast<T*>(items_[index & mask_].bytes));
+        }
+
+        size_t mask_;
+        Storage* items_;
+        /// Written by the consumer only.
+        alignas(shardAlignment) std::atomic<uint64_t> head_ = 0;
+        /// Written by the producer only.
+        alignas(shardAlignment) std::atomic<uint64_t> tail_ = 0;
+        /// Producer-only state, on a line of its own.
+        alignas(shardAlignment) uint64_t writeIndex_ = 0;
+        uint64_t cachedHead_ = 0;
+    };
+
+    /// A map split into shards that are each owned by a worker thread, for aggregation
+    /// jobs that write far more than they read. No shard is ever touched by two threads:
+    /// other threads obtain a Producer, which routes their operations to the owning
+    /// workers through single-producer single-consumer rings, publishing them in batches.
+    /// Operations are applied asynchronously and in order per producer; Producer::flush
+    /// and barrier wait until they have been. merge combines values with Combine. Workers
+    /// are not pinned to cores, which is left to the operating system or the application.
+    /// An operation that throws is skipped, and the first such exception is rethrown by
+    /// the next Producer::flush or barrier.
+    export template<typename Key,
+                    typename Value,
+                    typename Hash = RapidHasher,
+                    typename Equal = std::equal_to<Key>,
+                    typename Policy = HashPolicySelector<Key, Hash>::type,
+                    SimdBackend Backend = DefaultBackend,
+                    typename Allocator = std::allocator<std::byte>,
+                    typename LoadFactorRatio = typename DefaultLoadFactorSelector<Backend>::type,
+                    typename HashStoragePolicy =
+                        typename HashStorageSelector<std::pair<Key const, Value>>::type,
+                    typename Prober = DefaultProber,
+                    ShrinkPolicy Shrink = DefaultShrinkPolicy,
+                    typename Combine = std::plus<Value>>
+    class ThreadPerCoreMap
+    {
+      public:
+        using map_type = Map<Key,
+                             Value,
+                             Hash,
+                             Equal,
+                             Policy,
+                             Backend,
+                             Allocator,
+                             LoadFactorRatio,
+                             HashStoragePolicy,
+                             Prober,
+                             Shrink>;
+        using key_type = Key;
+        using mapped_type = Value;
+        using value_type = std::pair<Key const, Value>;
+        using size_type = std::size_t;
+        using hasher = Hash;
+
+      private:
+        enum class OpKind : uint8_t
+        {
+            Assign,
+            Merge,
+            Erase,
+        };
+
+        struct Op
+        {
+            OpKind kind;
+            size_t hash;
+            Key key;
+            Value value;
+        };
+
+        using Ring = SpscRing<Op>;
+
+        struct alignas(shardAlignment) Worker
+        {
+            map_type map;
+            /// Rings of every producer, only accessed by the worker thread.
+            std::vector<Ring*> rings;
+            /// Bumped whenever there is new work, so that an idle worker can sleep on it.
+            std::atomic<uint64_t> doorbell = 0;
+            std::atomic<bool> hasTasks = false;
+            std::mutex taskMutex;
+            std::vector<std::function<void()>> tasks;
+            /// First exception thrown by an operation and not rethrown yet.
+            std::exception_ptr error;
+            std::mutex errorMutex;
+            std::jthread thread;
+        };
+
+      public:
+        /// The handle through which one thread sends operations. Operations sit in the
+        /// producer's rings until a batch of batchSize is complete or send() is called.
+        class Producer
+        {
+          public:
+            Producer(Producer const&) = delete;
+            Producer& operator=(Producer const&) = delete;
+
+            /// Flushes and unregisters the rings. An exception thrown by an operation is
+            /// left for the next flush or barrier.
+            ~Producer()
+            {
+                sendAndWait();
+                auto rings = rings_.data();
+                owner_.runOnWorkers(
+                    [&](size_t w, Worker& worker) { std::erase(worker.rings, rings[w].get()); });
+                std::unique_lock lock(owner_.ringsMutex_);
+                for (auto const& ring : rings_)
+                {
+                    std::erase(owner_.rings_, ring.get());
+                }
+            }
+
+            void insert_or_assign(Key key, Value value)
+            {
+                push(OpKind::Assign, std::move(key), std::move(value));
+            }
+
+            /// Inserts value under key, or replaces the existing value v with
+            /// Combine()(std::move(v), std::move(value)).
+            void merge(Key key, Value value)
+            {
+                push(OpKind::Merge, std::move(key), std::move(value));
+            }
+
+            void erase(Key key)
+                requires std::default_initializable<Value>
+            {
+                push(OpKind::Erase, std::move(key), Value());
+            }
+
+            /// Publishes every operation still waiting for its batch to complete.
+            void send()
+            {
+                for (size_t w = 0; w < rings_.size(); ++w)
+                {
+                    if (rings_[w]->unpublished() != 0)
+                    {
+                        rings_[w]->publish();
+                        owner_.wake(owner_.workers_[w]);
+                    }
+                }
+            }
+
+            /// Sends and waits until every operation of this producer has been applied.
+            /// Rethrows the first exception an operation has thrown since the last flush
+            /// or barrier, of any producer.
+            void flush()
+            {
+                sendAndWait();
+                owner_.rethrowError();
+            }
+
+          private:
+            friend class ThreadPerCoreMap;
+
+            explicit Producer(ThreadPerCoreMap& owner)
+                : owner_(owner)
+            {
+                for (size_t w = 0; w < owner_.workerCount_; ++w)
+                {
+                    rings_.push_back(std::make_unique<Ring>(owner_.ringCapacity_));
+                }
+                {
+                    std::unique_lock lock(owner_.ringsMutex_);
+                    for (auto const& ring : rings_)
+                    {
+                        owner_.rings_.push_back(ring.get());
+                    }
+                }
+                auto rings = rings_.data();
+                owner_.runOnWorkers([&](size_t w, Worker& worker)
+                                    { worker.rings.push_back(rings[w].get()); });
+            }
+
+            void sendAndWait()
+            {
+                send();
+                for (auto const& ring : rings_)
+                {
+                    waitForConsumer(*ring, ring->published());
+                }
+            }
+
+            void push(OpKind kind, Key&& key, Value&& value)
+            {
+                size_t hash = owner_.hasher_(key);
+                size_t w = owner_.workerFor(hash);
+                Ring& ring = *rings_[w];
+                Op op {kind, hash, std::move(key), std::move(value)};
+                while (!ring.tryPush(op))
+                {
+                    ring.publish();
+                    owner_.wake(owner_.workers_[w]);
+                    std::this_thread::yield();
+                }
+                if (ring.unpublished() >= owner_.batchSize_)
+                {
+                    ring.publish();
+                    owner_.wake(owner_.workers_[w]);
+                }
+            }
+
+            ThreadPerCoreMap& owner_;
+            /// One ring per worker.
+            std::vector<std::unique_ptr<Ring>> rings_;
+        };
+
+        /// workerCount is rounded up to a power of two. Each ring holds ringCapacity
+        /// operations, and producers publish them batchSize at a time.
+        explicit ThreadPerCoreMap(size_t workerCount = defaultWorkerCount(),
+                                  size_t ringCapacity = 1 << 14,
+                                  size_t batchSize = 256)
+            : workerCount_(std::bit_ceil(std::max<size_t>(workerCount, 1)))
+            , shift_(std::numeric_limits<size_t>::digits - std::countr_zero(workerCount_))
+            , ringCapacity_(ringCapacity)
+            , batchSize_(std::clamp<size_t>(batchSize, 1, ringCapacity))
+            , workers_(std::make_unique<Worker[]>(workerCount_))
+        {
+            for (size_t w = 0; w < workerCount_; ++w)
+            {
+                workers_[w].thread = std::jthread([this, w](std::stop_token stop)
+                                                  { run(workers_[w], stop); });
+            }
+        }
+
+        ThreadPerCoreMap(ThreadPerCoreMap const&) = delete;
+        ThreadPerCoreMap& operator=(ThreadPerCoreMap const&) = delete;
+
+        /// Every producer must have been destroyed.
+        ~ThreadPerCoreMap()
+        {
+            for (size_t w = 0; w < workerCount_; ++w)
+            {
+                workers_[w].thread.request_stop();
+                wake(workers_[w]);
+                workers_[w].thread.join();
+            }
+        }
+
+        /// Creates the handle for the calling thread to send operations through.
+        [[nodiscard]] Producer producer() { return Producer(*this); }
+
+        /// Waits until every operation published before the call, by any producer, has
+        /// been applied. Operations still waiting for their batch are not covered.
+        /// Rethrows the first exception an operation has thrown since the last flush or
+        /// barrier.
+        void barrier() const
+        {
+            {
+                std::unique_lock lock(ringsMutex_);
+                for (Ring const* ring : rings_)
+                {
+                    waitForConsumer(*ring, ring->published());
+                }
+            }
+            rethrowError();
+        }
+
+        /// Calls fn on every shard, on the shards' own worker threads and so concurrently,
+        /// between the batches they apply. Returns once every call has returned.
+        template<typename F>
+            requires std::invocable<F&, map_type const&>
+        void visit_shards(F&& fn) const
+        {
+            const_cast<ThreadPerCoreMap&>(*this).runOnWorkers(
+                [&](size_t, Worker const& worker) { std::invoke(fn, worker.map); });
+        }
+
+        /// Calls fn on the element with key, on the worker owning it, if there is one.
+        /// Returns true if the key was found. Only operations already applied are seen.
+        template<typename F>
+            requires std::invocable<F&, value_type const&>
+        bool cvisit(Key const& key, F&& fn) const
+        {
+            size_t hash = hasher_(key);
+            size_t target = workerFor(hash);
+            bool found = false;
+            const_cast<ThreadPerCoreMap&>(*this).runOnWorkers(
+                [&](size_t w, Worker const& worker)
+                {
+                    if (w != target)
+                    {
+                        return;
+                    }
+                    auto it = worker.map.find_with_hash(key, hash);
+                    if (it != worker.map.end())
+                    {
+                        found = true;
+                        std::invoke(fn, *it);
+                    }
+                },
+                target);
+            return found;
+        }
+
+        /// Number of elements over all shards, counting the operations applied so far.
+        [[nodiscard]] size_type size() const
+        {
+            std::atomic<size_type> total = 0;
+            visit_shards([&](map_type const& map) { total += map.size(); });
+            return total;
+        }
+
+        [[nodiscard]] bool empty() const { return size() == 0; }
+
+        [[nodiscard]] size_t worker_count() const noexcept { return workerCount_; }
+
+        hasher hash_function() const { return hasher_; }
+
+      private:
+        static size_t defaultWorkerCount()
+        {
+            return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        }
+
+        size_t workerFor(size_t hash) const noexcept
+        {
+            return workerCount_ == 1 ? 0 : Policy::apply(hash) >> shift_;
+        }
+
+        static void waitForConsumer(Ring const& ring, uint64_t count)
+        {
+            while (ring.consumed() < count)
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        /// Rethrows the exception of the first worker that has one, and clears it.
+        void rethrowError() const
+        {
+            for (size_t w = 0; w < workerCount_; ++w)
+            {
+                Worker& worker = workers_[w];
+                std::exception_ptr error;
+                {
+                    std::unique_lock lock(worker.errorMutex);
+                    error = std::exchange(worker.error, nullptr);
+                }
+                if (error)
+                {
+                    std::rethrow_exception(error);
+                }
+            }
+        }
+
+        static void wake(Worker& worker)
+        {
+            worker.doorbell.fetch_add(1, std::memory_order_release);
+            worker.doorbell.notify_one();
+        }
+
+        /// Runs fn(w, worker) on the thread of every worker, or only of worker `only`, and
+        /// waits for all of them. An exception thrown by fn is rethrown here.
+        template<typename F>
+        void runOnWorkers(F&& fn, std::optional<size_t> only = std::nullopt)
+        {
+            size_t first = only.value_or(0);
+            size_t last = only ? *only + 1 : workerCount_;
+            std::latch done(static_cast<std::ptrdiff_t>(last - first));
+            std::vector<std::exception_ptr> errors(last - first);
+            for (size_t w = first; w < last; ++w)
+            {
+                Worker& worker = workers_[w];
+                {
+                    std::unique_lock lock(worker.taskMutex);
+                    worker.tasks.emplace_back(
+                        [&, w]
+                        {
+                            try
+                            {
+                                fn(w, worker);
+                            }
+                            catch (...)
+                            {
+                                errors[w - first] = std::current_exception();
+                            }
+                            done.count_down();
+                        });
+                    worker.hasTasks.store(true, std::memory_order_release);
+                }
+                wake(worker);
+            }
+            done.wait();
+            for (auto const& error : errors)
+            {
+                if (error)
+                {
+                    std::rethrow_exception(error);
+                }
+            }
+        }
+
+        void run(Worker& worker, std::stop_token const& stop)
+        {
+            while (true)
+            {
+                // Read before checking for stop, so that the wake-up after a stop request
+                // cannot be missed
+                uint64_t doorbell = worker.doorbell.load(std::memory_order_acquire);
+                if (stop.stop_requested())
+                {
+                    return;
+                }
+                size_t work = 0;
+                for (Ring* ring : worker.rings)
+                {
+                    work += ring->consume(
+                        [&](Op& op)
+                        {
+                            // A failed operation must not stop the worker or lose the
+                            // operations after it
+                            try
+                            {
+                                apply(worker.map, op);
+                            }
+                            catch (...)
+                            {
+                                std::unique_lock lock(worker.errorMutex);
+                                if (!worker.error)
+                                {
+                                    worker.error = std::current_exception();
+                                }
+                            }
+                        });
+                }
+                if (worker.hasTasks.load(std::memory_order_acquire))
+                {
+                    std::vector<std::function<void()>> tasks;
+                    {
+                        std::unique_lock lock(worker.taskMutex);
+                        tasks.swap(worker.tasks);
+                        worker.hasTasks.store(false, std::memory_order_relaxed);
+                    }
+                    for (auto& task : tasks)
+                    {
+                        task();
+                    }
+                    work += tasks.size();
+                }
+                if (work == 0)
+                {
+                    worker.doorbell.wait(doorbell, std::memory_order_acquire);
+                }
+            }
+        }
+
+        static void apply(map_type& map, Op& op)
+        {
+            if (op.kind == OpKind::Erase)
+            {
+                auto it = map.find_with_hash(op.key, op.hash);
+                if (it != map.end())
+                {
+                    map.erase(it);
+                }
+                return;
+            }
+            auto [it, inserted] = map.emplace_with_hash(op.hash,
+                                                        std::piecewise_construct,
+                                                        std::forward_as_tuple(std::move(op.key)),
+                                                        std::forward_as_tuple(std::move(op.value)));
+            if (inserted)
+            {
+                return;
+            }
+            if (op.kind == OpKind::Assign)
+            {
+                it->second = std::move(op.value);
+            }
+            else
+            {
+                it->second = Combine()(std::move(it->second), std::move(op.value));
+            }
+        }
+
+        size_t workerCount_;
+        int shift_;
+        size_t ringCapacity_;
+        size_t batchSize_;
+        [[no_unique_address]] Hash hasher_;
+        /// Rings of every producer, for barrier().
+        std::vector<Ring*> rings_;
+        mutable std::mutex ringsMutex_;
+        std::unique_ptr<Worker[]> workers_;
+    };
+}  // namespace alp
@@ -1,9 +1,19 @@
 module;
 
+#include <cassert>
+#include <concepts>
 #include <expected>
+#include <filesystem>
+#include <fstream>
 #include <functional>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <ranges>
 #include <ratio>
+#include <span>
 #include <tuple>
+#include <type_traits>
 #include <utility>
 
 export module alp:map;
@@ -18,16 +28,16 @@ namespace alp
         using is_transparent = void;
         [[no_unique_address]] Hash hasher;
 
-        auto operator()(Key const& k) const noexcept { return hasher(k); }
+        auto operator()(Key const& k) const noexcept(noexcept(hasher(k))) { return hasher(k); }
         template<typename V>
-        auto operator()(std::pair<Key const, V> const& p) const noexcept
+        auto operator()(std::pair<Key const, V> const& p) const noexcept(noexcept(hasher(p.first)))
         {
             return hasher(p.first);
         }
 
         template<typename T>
             requires requires { typename Hash::is_transparent; }
-        auto operator()(T const& t) const noexcept
+        auto operator()(T const& t) const noexcept(noexcept(hasher(t)))
         {
             return hasher(t);
         }
@@ -39,6 +49,8 @@ namespace alp
         using is_transparent = void;
         [[no_unique_address]] Equal eq;
 
+        bool operator()(Key const& lhs, Key const& rhs) const { return eq(lhs, rhs); }
+
         template<typename V>
         bool operator()(std::pair<Key const, V> const& lhs,
                         std::pair<Key const, V> const& rhs) const
@@ -66,8 +78,231 @@ namespace alp
         }
     };
 
+    /// Matches any std::pair (possibly cv/ref-qualified) whose first member is a Key.
+    template<typename P, typename Key>
+    concept PairWithKey = requires(P&& p) {
+        requires std::is_same_v<std::remove_cvref_t<decltype(p.first)>, Key>;
+        p.second;
+    };
+
+    /// Matches a single-element tuple holding a Key, as produced by std::forward_as_tuple(key).
+    template<typename Tuple, typename Key>
+    concept TupleOfKey = requires {
+        requires std::tuple_size<std::remove_cvref_t<Tuple>>::value == 1;
+        requires std::is_same_v<
+            std::remove_cvref_t<std::tuple_element_t<0, std::remove_cvref_t<Tuple>>>,
+            Key>;
+    };
+
+    /// Operations shared by Map and NodeMap, written in terms of the derived map's emplace:
+    /// try_emplace, insert_or_assign and operator[], plus reading the key from emplace
+    /// arguments so that a pair is only constructed once its key is known to be absent.
+    template<typename Derived, typename Key, typename Value>
+    class MapOperations
+    {
+      public:
+        /// Inserts a value constructed from args under key if the key is not present.
+        /// Neither key nor args are touched if the key already exists.
+        template<typename... Args>
+        auto try_emplace(Key const& key, Args&&... args)
+        {
+            return self().emplace(std::piecewise_construct,
+                                  std::forward_as_tuple(key),
+                                  std::forward_as_tuple(std::forward<Args>(args)...));
+        }
+
+        template<typename... Args>
+        auto try_emplace(Key&& key, Args&&... args)
+        {
+            return self().emplace(std::piecewise_construct,
+                                  std::forward_as_tuple(std::move(key)),
+                                  std::forward_as_tuple(std::forward<Args>(args)...));
+        }
+
+        /// Inserts obj under k, or assigns it to the existing value.
+        /// Returns true if insertion took place.
+        template<typename M>
+        auto insert_or_assign(Key const& k, M&& obj)
+        {
+            auto result = try_emplace(k, std::forward<M>(obj));
+            if (!result.second)
+            {
+                result.first->second = std::forward<M>(obj);
+            }
+            return result;
+        }
+
+        template<typename M>
+        auto insert_or_assign(Key&& k, M&& obj)
+        {
+            auto result = try_emplace(std::move(k), std::forward<M>(obj));
+            if (!result.second)
+            {
+                result.first->second = std::forward<M>(obj);
+            }
+            return result;
+        }
+
+        /// Returns the value for key, inserting a value-initialized one if it is absent.
+        Value& operator[](Key const& key) { return try_emplace(key).first->second; }
+
+        Value& operator[](Key&& key) { return try_emplace(std::move(key)).first->second; }
+
+      protected:
+        /// emplace(key, value)
+        template<typename K, typename V>
+            requires std::is_same_v<std::remove_cvref_t<K>, Key>
+        static Key const& extractKey(K const& key, V const& /*value*/)
+        {
+            return key;
+        }
+
+        /// emplace(pair)
+        template<typename P>
+            requires PairWithKey<P, Key>
+        static Key const& extractKey(P const& pair)
+        {
+            return pair.first;
+        }
+
+        /// emplace(std::piecewise_construct, std::forward_as_tuple(key), valueArgs)
+        template<typename KeyTuple, typename ValueTuple>
+            requires TupleOfKey<KeyTuple, Key>
+        static Key const& extractKey(std::piecewise_construct_t,
+                                     KeyTuple const& keyArgs,
+                                     ValueTuple const& /*valueArgs*/)
+        {
+            return std::get<0>(keyArgs);
+        }
+
+      private:
+        Derived& self() { return static_cast<Derived&>(*this); }
+    };
+
+    /// Map layout policy storing each key and its value together as a std::pair in the slots.
+    export struct PairLayoutTag
+    {
+    };
+
+    /// Map layout policy storing the keys in the slots and the values in a parallel array
+    /// of the same buffer, so that probing only touches key memory. Iterators yield a
+    /// std::pair<Key const&, Value&> instead of a reference to a stored pair.
+    export struct SplitLayoutTag
+    {
+    };
+
+    /// Iterator over a map with SplitLayoutTag: walks the keys with a SetIterator and reads
+    /// each value at the same index of the value array.
+    export template<typename Key, typename Value, SimdBackend Backend, typename HashStoragePolicy>
+    struct SplitMapIterator
+    {
+        using KeyIterator = SetIterator<Key const, Backend, HashStoragePolicy>;
+        using SlotType = Slot<Key, HashStoragePolicy>;
+        using reference = std::pair<Key const&, Value&>;
+
+        /// Holds a dereferenced element so that operator-> has something to point to.
+        struct ArrowProxy
+        {
+            reference ref;
+            reference const* operator->() const noexcept { return &ref; }
+        };
+
+        KeyIterator keys;
+        /// First slot of the buffer, to turn the slot of keys into an index.
+        SlotType const* slots;
+        /// First value of the buffer, parallel to slots.
+        Value* values;
+
+        SplitMapIterator(KeyIterator k, SlotType const* s, Value* v)
+            : keys(k)
+            , slots(s)
+            , values(v)
+        {
+        }
+
+        // Converting constructor: allows iterator to convert to const_iterator
+        SplitMapIterator(SplitMapIterator<Key,
+                                          std::remove_const_t<Value>,
+                                          Backend,
+                                          HashStoragePolicy> const& other)
+            requires std::is_const_v<Value>
+            : keys(other.keys)
+            , slots(other.slots)
+            , values(other.values)
+        {
+        }
+
+        SplitMapIterator(SplitMapIterator const&) = default;
+        SplitMapIterator& operator=(SplitMapIterator const&) = default;
+
+        template<typename U>
+        friend bool operator==(SplitMapIterator const& lhs,
+                               SplitMapIterator<Key, U, Backend, HashStoragePolicy> const& rhs)
+        {
+            return lhs.keys == rhs.keys;
+        }
+
+        reference operator*() const noexcept
+        {
+            return {*keys, values[keys.slot - slots]};
+        }
+        ArrowProxy operator->() const noexcept { return {**this}; }
+
+        SplitMapIterator& operator++() noexcept
+        {
+            ++keys;
+            return *this;
+        }
+    };
+
+    /// Range over the keys (Index 0) or the values (Index 1) of a map, in iteration order,
+    /// as returned by Map::keys() and Map::values(). Elements are only bound by reference,
+    /// so with SplitLayoutTag each view reads the array of its own member alone.
+    export template<typename MapIterator, size_t Index>
+    class MapMemberView
+    {
+      public:
+        struct iterator
+        {
+            using reference = decltype(std::get<Index>(*std::declval<MapIterator const&>()));
+            using value_type = std::remove_cvref_t<reference>;
+            using difference_type = std::ptrdiff_t;
+
+            MapIterator it;
+
+            reference operator*() const noexcept { return std::get<Index>(*it); }
+
+            iterator& operator++() noexcept
+            {
+                ++it;
+                return *this;
+            }
+
+            friend bool operator==(iterator const& lhs, iterator const& rhs)
+            {
+                return lhs.it == rhs.it;
+            }
+        };
+
+        MapMemberView(MapIterator first, MapIterator last)
+            : first_(first)
+            , last_(last)
+        {
+        }
+
+        iterator begin() const { return {first_}; }
+        iterator end() const { return {last_}; }
+
+      private:
+        MapIterator first_;
+        MapIterator last_;
+    };
+
     /// A hash map (unordered_map) based on Swiss Tables.
     /// Uses SIMD-accelerated probing for efficient lookup, insertion, and deletion.
+    /// With SplitLayoutTag, value_type is still std::pair<Key const, Value>, but no such
+    /// pair is stored: reference is the proxy std::pair<Key const&, Value&>, returned by
+    /// value from the iterators, so it binds to auto or auto&& rather than value_type&.
     export template<typename Key,
                     typename Value,
                     typename Hash = RapidHasher,
@@ -76,106 +311,278 @@ namespace alp
                     SimdBackend Backend = DefaultBackend,
                     typename Allocator = std::allocator<std::byte>,
                     typename LoadFactorRatio = typename DefaultLoadFactorSelector<Backend>::type,
-                    typename HashStoragePolicy = typename HashStorageSelector<std::pair<Key const, Value>>::type>
+                    typename HashStoragePolicy = typename HashStorageSelector<std::pair<Key const, Value>>::type,
+                    typename Prober = DefaultProber,
+                    ShrinkPolicy Shrink = DefaultShrinkPolicy,
+                    typename Layout = PairLayoutTag,
+                    typename CtrlLayout = ContiguousCtrlTag>
         requires std::move_constructible<std::pair<Key const, Value>>
     class Map
-        : Table<std::pair<Key const, Value>,
+        : Table<std::conditional_t<std::is_same_v<Layout, SplitLayoutTag>,
+                                   Key,
+                                   std::pair<Key const, Value>>,
                 MapHashAdapter<Key, Hash>,
                 MapEqualAdapter<Key, Equal>,
                 Policy,
                 Backend,
                 Allocator,
                 LoadFactorRatio,
-                HashStoragePolicy>
+                HashStoragePolicy,
+                Prober,
+                Shrink,
+                std::conditional_t<std::is_same_v<Layout, SplitLayoutTag>, Value, void>,
+                CtrlLayout>,
+          public MapOperations<Map<Key,
+                                   Value,
+                                   Hash,
+                                   Equal,
+                                   Policy,
+                                   Backend,
+                                   Allocator,
+                                   LoadFactorRatio,
+                                   HashStoragePolicy,
+                                   Prober,
+                                   Shrink,
+                                   Layout,
+                                   CtrlLayout>,
+                               Key,
+                               Value>
     {
         using PairType = std::pair<Key const, Value>;
-        using Base = Table<PairType,
+        static constexpr bool isSplit = std::is_same_v<Layout, SplitLayoutTag>;
+        using Base = Table<std::conditional_t<isSplit, Key, PairType>,
                            MapHashAdapter<Key, Hash>,
                            MapEqualAdapter<Key, Equal>,
                            Policy,
                            Backend,
                            Allocator,
                            LoadFactorRatio,
-                           HashStoragePolicy>;
+                           HashStoragePolicy,
+                           Prober,
+                           Shrink,
+                           std::conditional_t<isSplit, Value, void>,
+                           CtrlLayout>;
+        using Operations = MapOperations<Map, Key, Value>;
 
       public:
         using key_type = Key;
         using mapped_type = Value;
+        using hasher = Hash;
+        using key_equal = Equal;
         using value_type = PairType;
         using size_type = Base::size_type;
-        using iterator = Base::iterator;
-        using const_iterator = Base::const_iterator;
+        using reference =
+            std::conditional_t<isSplit, std::pair<Key const&, Value&>, value_type&>;
+        using const_reference =
+            std::conditional_t<isSplit, std::pair<Key const&, Value const&>, value_type const&>;
+        using iterator = std::conditional_t<
+            isSplit,
+            SplitMapIterator<Key, Value, Backend, HashStoragePolicy>,
+            typename Base::iterator>;
+        using const_iterator = std::conditional_t<
+            isSplit,
+            SplitMapIterator<Key, Value const, Backend, HashStoragePolicy>,
+            typename Base::const_iterator>;
 
         using Base::Base;
 
-        using Base::begin;
-        using Base::cbegin;
-        using Base::cend;
+        using Base::capacity;
         using Base::clear;
         using Base::empty;
-        using Base::end;
+        using Base::incremental_rehash;
+        using Base::rehash_threads;
         using Base::reserve;
+        using Base::set_incremental_rehash;
+        using Base::set_rehash_threads;
+        using Base::shrink_to_fit;
         using Base::size;
         using Base::swap;
 
         Map() = default;
-        explicit Map(size_type capacity)
-            : Base(capacity)
+
+        explicit Map(Allocator const& alloc)
+            : Base(alloc)
+        {
+        }
+
+        explicit Map(size_type capacity, Allocator const& alloc = Allocator())
+            : Base(capacity, alloc)
+        {
+        }
+
+        /// Constructs the map from the key-value pairs of range, sizing it once up front
+        /// when the length of the range is known. For repeated keys, the first one wins.
+        template<std::ranges::input_range R>
+            requires std::constructible_from<value_type, std::ranges::range_reference_t<R>>
+        Map(std::from_range_t, R&& range, Allocator const& alloc = Allocator())
+            : Base(alloc)
         {
+            insert_range(std::forward<R>(range));
         }
 
+        iterator begin() { return wrap(Base::begin()); }
+        iterator end() { return wrap(Base::end()); }
+        const_iterator begin() const { return wrap(Base::begin()); }
+        const_iterator end() const { return wrap(Base::end()); }
+        const_iterator cbegin() const { return begin(); }
+        const_iterator cend() const { return end(); }
+
+        /// Returns a view of the keys. With SplitLayoutTag, the values are not read.
+        MapMemberView<const_iterator, 0> keys() const { return {begin(), end()}; }
+
+        /// Returns a view of the values. With SplitLayoutTag, the keys are not read.
+        MapMemberView<iterator, 1> values() { return {begin(), end()}; }
+        MapMemberView<const_iterator, 1> values() const { return {begin(), end()}; }
+
         iterator find(Key const& key)
         {
             size_t idx = Base::find_internal(key);
             if (idx == this->ctrlLen_)
-                return this->end();
-            return Base::iteratorAt(idx);
+                return end();
+            return iteratorAt(idx);
         }
 
         const_iterator find(Key const& key) const
         {
             size_t idx = Base::find_internal(key);
             if (idx == this->ctrlLen_)
-                return this->end();
-            return Base::iteratorAt(idx);
+                return end();
+            return iteratorAt(idx);
+        }
+
+        bool contains(Key const& key) const { return find(key) != end(); }
+
+        /// Returns a copy of the hasher. Its output for a key is what the *_with_hash
+        /// functions expect, so a key can be hashed once and then used with several
+        /// tables sharing the same hasher.
+        hasher hash_function() const { return this->hasher_.hasher; }
+
+        /// Like find(key), but with hash = hash_function()(key) precomputed by the caller.
+        iterator find_with_hash(Key const& key, size_t hash)
+        {
+            size_t idx = Base::find_internal(key, Policy::apply(hash));
+            if (idx == this->ctrlLen_)
+                return end();
+            return iteratorAt(idx);
+        }
+
+        const_iterator find_with_hash(Key const& key, size_t hash) const
+        {
+            size_t idx = Base::find_internal(key, Policy::apply(hash));
+            if (idx == this->ctrlLen_)
+                return end();
+            return iteratorAt(idx);
         }
 
-        bool contains(Key const& key) const { return find(key) != this->end(); }
+        bool contains_with_hash(Key const& key, size_t hash) const
+        {
+            return find_with_hash(key, hash) != end();
+        }
+
+        /// Looks up all keys at once, storing a pointer to each key's value in out
+        /// (nullptr if absent). Faster than repeated find() on tables that do not fit
+        /// in cache, since the memory accesses of the lookups are overlapped.
+        /// out must hold at least keys.size() entries.
+        void find_many(std::span<Key const> keys, std::span<Value*> out)
+        {
+            assert(out.size() >= keys.size());
+            Base::find_many_internal(keys,
+                                     [&](size_t i, size_t idx)
+                                     {
+                                         out[i] = idx == Base::ctrlLen_ ? nullptr : valueAt(idx);
+                                     });
+        }
+
+        void find_many(std::span<Key const> keys, std::span<Value const*> out) const
+        {
+            assert(out.size() >= keys.size());
+            Base::find_many_internal(keys,
+                                     [&](size_t i, size_t idx)
+                                     {
+                                         out[i] = idx == Base::ctrlLen_ ? nullptr : valueAt(idx);
+                                     });
+        }
+
+        /// Looks up all keys at once, storing whether each is present in out.
+        /// Returns the number of keys found. out must hold at least keys.size() entries.
+        size_type contains_many(std::span<Key const> keys, std::span<bool> out) const
+        {
+            assert(out.size() >= keys.size());
+            size_type found = 0;
+            Base::find_many_internal(keys,
+                                     [&](size_t i, size_t idx)
+                                     {
+                                         out[i] = idx != Base::ctrlLen_;
+                                         found += out[i];
+                                     });
+            return found;
+        }
 
+        /// Constructs a key-value pair from args if the key is not present.
+        /// When the key can be read from args (a key and a value, a pair, or a
+        /// piecewise key tuple holding a Key), it is probed for directly and the
+        /// pair is only constructed, in place, on a miss.
         template<typename... Args>
         std::pair<iterator, bool> emplace(Args&&... args)
         {
-            auto [idx, success] = Base::emplace_wrapper(std::forward<Args>(args)...);
-            return {Base::iteratorAt(idx), success};
+            auto [idx, success] = emplaceDispatch(std::nullopt, std::forward<Args>(args)...);
+            return {iteratorAt(idx), success};
+        }
+
+        /// Like emplace(args...), but with hash = hash_function()(key) precomputed by the
+        /// caller for the key of the pair that args construct.
+        template<typename... Args>
+        std::pair<iterator, bool> emplace_with_hash(size_t hash, Args&&... args)
+        {
+            auto [idx, success] = emplaceDispatch(hash, std::forward<Args>(args)...);
+            return {iteratorAt(idx), success};
         }
 
         std::pair<iterator, bool> insert(value_type const& value) { return emplace(value); }
 
         std::pair<iterator, bool> insert(value_type&& value) { return emplace(std::move(value)); }
 
-        template<typename M>
-        std::pair<iterator, bool> insert_or_assign(Key const& k, M&& obj)
+        /// Inserts every key-value pair of range whose key is not already present.
+        /// The table is grown once when the length of the range is known, and
+        /// pairs are hashed and prefetched in batches before being inserted.
+        template<std::ranges::input_range R>
+            requires std::constructible_from<value_type, std::ranges::range_reference_t<R>>
+        void insert_range(R&& range)
         {
-            auto it = find(k);
-            if (it != end())
+            if constexpr (isSplit)
             {
-                it->second = std::forward<M>(obj);
-                return {it, false};
+                // Pairs are only built by the range, so they are emplaced one at a time.
+                if constexpr (std::ranges::sized_range<R> || std::ranges::forward_range<R>)
+                {
+                    reserve(size() + static_cast<size_t>(std::ranges::distance(range)));
+                }
+                for (auto&& element : range)
+                {
+                    emplace(std::forward<decltype(element)>(element));
+                }
+            }
+            else if constexpr (PairWithKey<std::ranges::range_reference_t<R>, Key>)
+            {
+                // Pairs with a mutable key are hashed by their key like value_type itself
+                Base::insert_range_internal(std::forward<R>(range),
+                                            [](auto const& p) -> Key const& { return p.first; });
+            }
+            else
+            {
+                Base::insert_range_internal(std::forward<R>(range));
             }
-            return emplace(std::piecewise_construct,
-                           std::forward_as_tuple(k),
-                           std::forward_as_tuple(std::forward<M>(obj)));
         }
 
-        Value& operator[](Key const& key)
+        /// Inserts a value constructed from args if key is absent, then calls fn on
+        /// the mapped value (new or existing) with a single hash and probe.
+        /// Returns true if insertion took place.
+        template<typename K, typename F, typename... Args>
+            requires std::is_same_v<std::remove_cvref_t<K>, Key> && std::invocable<F&, Value&>
+        std::pair<iterator, bool> upsert(K&& key, F&& fn, Args&&... args)
         {
-            auto it = find(key);
-            if (it != end())
-                return it->second;
-
-            auto [new_it, success] = emplace(
-                std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple());
-            return new_it->second;
+            auto result = this->try_emplace(std::forward<K>(key), std::forward<Args>(args)...);
+            std::invoke(fn, result.first->second);
+            return result;
         }
 
         [[nodiscard]]
@@ -189,10 +596,18 @@ namespace alp
             return std::unexpected(Error::NotFound);
         }
 
+        /// Erases the element at pos. Erasing never rebuilds the table, so iterators to
+        /// other elements stay valid.
         void erase(const_iterator pos)
         {
-            size_t offset = pos.ctrl - Base::ctrl_;
-            Base::erase_slot(offset);
+            if constexpr (isSplit)
+            {
+                Base::erase_slot(Base::indexOf(pos.keys));
+            }
+            else
+            {
+                Base::erase_slot(Base::indexOf(pos));
+            }
         }
 
         size_type erase(Key const& key)
@@ -215,6 +630,203 @@ namespace alp
             return std::unexpected(Error::NotFound);
         }
 
+        /// Writes the map in a binary format that load() restores without rehashing: a
+        /// header describing the table's type, followed by its buffer, verbatim. Only for
+        /// trivially copyable keys and values; the file is specific to the machine's byte order.
+        std::expected<void, Error> save(std::ostream& out) const
+            requires Base::serializable
+        {
+            return Base::saveTo(out, hashSeedOf<Hash>());
+        }
+
+        std::expected<void, Error> save(std::filesystem::path const& path) const
+            requires Base::serializable
+        {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            if (!out)
+            {
+                return std::unexpected(Error::IoFailure);
+            }
+            auto saved = save(out);
+            out.close();
+            if (saved && !out)
+            {
+                return std::unexpected(Error::IoFailure);
+            }
+            return saved;
+        }
+
+        /// Reads a map written by save() by the same Map type, with a single read of
+        /// its buffer. Fails with Error::IncompatibleFormat if the data was written by
+        /// another type or with another hash function, or is corrupt.
+        static std::expected<Map, Error> load(std::istream& in,
+                                            Allocator const& alloc = Allocator())
+            requires Base::serializable
+        {
+            Map result(alloc);
+            if (auto loaded = result.loadFrom(in, hashSeedOf<Hash>()); !loaded)
+            {
+                return std::unexpected(loaded.error());
+            }
+            return result;
+        }
+
+        static std::expected<Map, Error> load(std::filesystem::path const& path,
+                                            Allocator const& alloc = Allocator())
+            requires Base::serializable
+        {
+            std::ifstream in(path, std::ios::binary);
+            if (!in)
+            {
+                return std::unexpected(Error::IoFailure);
+            }
+            return load(in, alloc);
+        }
+
         friend void swap(Map& lhs, Map& rhs) noexcept { lhs.swap(rhs); }
+
+      protected:
+        /// Like find_with_hash, but for readers that race with a writer and validate the
+        /// result against a sequence counter, as ConcurrentMap does with OptimisticReadsTag.
+        /// Only safe under the conditions of Table::find_optimistic, so it is left to
+        /// derived classes that provide them.
+        template<typename F>
+            requires(!isSplit)
+        [[nodiscard]] value_type const* find_optimistic(Key const& key,
+                                                        size_t hash,
+                                                        F&& snapshotValid) const
+        {
+            return Base::find_optimistic(
+                key, Policy::apply(hash), std::forward<F>(snapshotValid));
+        }
+
+      private:
+        /// Wraps an iterator of the underlying table into one of the map.
+        iterator wrap(typename Base::iterator it)
+        {
+            if constexpr (isSplit)
+            {
+                return {it, this->slots_, Base::mappedAt(0)};
+            }
+            else
+            {
+                return it;
+            }
+        }
+
+        const_iterator wrap(typename Base::const_iterator it) const
+        {
+            if constexpr (isSplit)
+            {
+                return {it, this->slots_, Base::mappedAt(0)};
+            }
+            else
+            {
+                return it;
+            }
+        }
+
+        iterator iteratorAt(size_t idx) { return wrap(Base::iteratorAt(idx)); }
+        const_iterator iteratorAt(size_t idx) const { return wrap(Base::iteratorAt(idx)); }
+
+        /// Returns the value of the element at index idx, as returned by find_internal.
+        Value* valueAt(size_t idx) const
+        {
+            if constexpr (isSplit)
+            {
+                return Base::mappedAt(idx);
+            }
+            else
+            {
+                return &Base::slotAt(idx)->element()->second;
+            }
+        }
+
+        /// Probes with the key from args if it can be extracted, and otherwise
+        /// constructs the pair first. hash, if given, is the hasher's output for the key.
+        template<typename... Args>
+        std::pair<size_t, bool> emplaceDispatch(std::optional<size_t> hash, Args&&... args)
+        {
+            if constexpr (isSplit)
+            {
+                return emplaceSplit(hash, std::forward<Args>(args)...);
+            }
+            else if constexpr (requires { Operations::extractKey(args...); })
+            {
+                Key const& key = Operations::extractKey(args...);
+                return Base::emplace_internal(key,
+                                              Policy::apply(hash ? *hash : this->hasher_(key)),
+                                              std::forward<Args>(args)...);
+            }
+            else if (hash)
+            {
+                return Base::emplace_wrapper_hashed(Policy::apply(*hash),
+                                                    std::forward<Args>(args)...);
+            }
+            else
+            {
+                return Base::emplace_wrapper(std::forward<Args>(args)...);
+            }
+        }
+
+        /// With SplitLayoutTag, the key and the value are constructed separately, so args
+        /// are turned into std::piecewise_construct and one argument tuple for each.
+        /// A pair is only built up front when the key cannot be read from args.
+        template<typename... Args>
+        std::pair<size_t, bool> emplaceSplit(std::optional<size_t> hash, Args&&... args)
+        {
+            if constexpr (requires { Operations::extractKey(args...); })
+            {
+                Key const& key = Operations::extractKey(args...);
+                return std::apply(
+                    [&](auto&&... split)
+                    {
+                        return Base::emplace_internal(
+                            key,
+                            Policy::apply(hash ? *hash : this->hasher_(key)),
+                            std::forward<decltype(split)>(split)...);
+                    },
+                    splitArgs(std::forward<Args>(args)...));
+            }
+            else
+            {
+                std::pair<Key, Value> pair(std::forward<Args>(args)...);
+                return Base::emplace_internal(
+                    pair.first,
+                    Policy::apply(hash ? *hash : this->hasher_(pair.first)),
+                    std::piecewise_construct,
+                    std::forward_as_tuple(std::move(pair.first)),
+                    std::forward_as_tuple(std::move(pair.second)));
+            }
+        }
+
+        /// emplace(key, value) with SplitLayoutTag
+        template<typename K, typename V>
+        static auto splitArgs(K&& key, V&& value)
+        {
+            return std::tuple {std::piecewise_construct,
+                               std::forward_as_tuple(std::forward<K>(key)),
+                               std::forward_as_tuple(std::forward<V>(value))};
+        }
+
+        /// emplace(pair) with SplitLayoutTag
+        template<typename P>
+        static auto splitArgs(P&& pair)
+        {
+            return std::tuple {std::piecewise_construct,
+                               std::forward_as_tuple(std::get<0>(std::forward<P>(pair))),
+                               std::forward_as_tuple(std::get<1>(std::forward<P>(pair)))};
+        }
+
+        /// emplace(std::piecewise_construct, keyArgs, valueArgs) with SplitLayoutTag
+        template<typename KeyTuple, typename ValueTuple>
+        static auto splitArgs(std::piecewise_construct_t,
+                              KeyTuple&& keyArgs,
+                              ValueTuple&& valueArgs)
+        {
+            return std::tuple {std::piecewise_construct,
+                               std::forward<KeyTuple>(keyArgs),
+                               std::forward<ValueTuple>(valueArgs)};
+        }
     };
 }  // namespace alp
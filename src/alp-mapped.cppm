@@ -0,0 +1,1633 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <new>
+#include <span>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#if defined(_WIN32)
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+export module alp:mapped;
+
+import :set;
+import :map;
+import :rapid_hash;
+
+namespace alp
+{
+    /// A whole file mapped read-only into memory. Every process that maps the same file
+    /// shares its pages through the page cache. Where mmap is not available, the file is
+    /// read into memory instead.
+    class ReadOnlyMapping
+    {
+      public:
+        ReadOnlyMapping() = default;
+
+        ReadOnlyMapping(ReadOnlyMapping&& other) noexcept
+            : data_(std::exchange(other.data_, nullptr))
+            , size_(std::exchange(other.size_, 0))
+        {
+        }
+
+        ReadOnlyMapping& operator=(ReadOnlyMapping&& other) noexcept
+        {
+            if (this != &other)
+            {
+                release();
+                data_ = std::exchange(other.data_, nullptr);
+                size_ = std::exchange(other.size_, 0);
+            }
+            return *this;
+        }
+
+        ~ReadOnlyMapping() { release(); }
+
+        /// Maps the file at path, advising the kernel that it will be read at random.
+        static std::expected<ReadOnlyMapping, Error> open(std::filesystem::path const& path)
+        {
+            ReadOnlyMapping mapping;
+#if defined(_WIN32)
+            std::ifstream in(path, std::ios::binary | std::ios::ate);
+            if (!in)
+            {
+                return std::unexpected(Error::IoFailure);
+            }
+            mapping.size_ = static_cast<size_t>(in.tellg());
+            if (mapping.size_ > 0)
+            {
+                mapping.data_ = static_cast<std::byte*>(
+                    ::operator new(mapping.size_, std::align_val_t {pageAlignment}));
+                in.seekg(0);
+                if (!in.read(reinterpret_cast<char*>(mapping.data_),
+                             static_cast<std::streamsize>(mapping.size_)))
+                {
+                    return std::unexpected(Error::IoFailure);
+                }
+            }
+#else
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+            {
+                return std::unexpected(Error::IoFailure);
+            }
+            struct stat status {};
+            if (::fstat(fd, &status) != 0)
+            {
+                ::close(fd);
+                return std::unexpected(Error::IoFailure);
+            }
+            mapping.size_ = static_cast<size_t>(status.st_size);
+            if (mapping.size_ > 0)
+            {
+                void* data = ::mmap(nullptr, mapping.size_, PROT_READ, MAP_SHARED, fd, 0);
+                if (data == MAP_FAILED)
+                {
+                    ::close(fd);
+                    return std::unexpected(Error::IoFailure);
+                }
+                ::madvise(data, mapping.size_, MADV_RANDOM);
+                mapping.data_ = static_cast<std::byte*>(data);
+            }
+            // The mapping keeps the file's pages alive without the descriptor
+            ::close(fd);
+#endif
+            return mapping;
+        }
+
+        [[nodiscard]] std::byte const* data() const noexcept { return data_; }
+        [[nodiscard]] size_t size() const noexcept { return size_; }
+
+      private:
+#if defined(_WIN32)
+        static constexpr size_t pageAlignment = 4096;
+#endif
+
+        void release() noexcept
+        {
+            if (data_ == nullptr)
+            {
+                return;
+            }
+#if defined(_WIN32)
+            ::operator delete(data_, size_, std::align_val_t {pageAlignment});
+#else
+            ::munmap(data_, size_);
+#endif
+            data_ = nullptr;
+        }
+
+        std::byte* data_ = nullptr;
+        size_t size_ = 0;
+    };
+
+    /// Cheap checks of a saved buffer that is used in place rather than read: its sentinels
+    /// must be intact, and the first group's elements must match their control bytes.
+    template<SimdBackend Backend, typename Layout, typename Policy, typename Hash>
+    [[nodiscard]] bool savedBufferPlausible(ctrl_t const* ctrl,
+                                            typename Layout::SlotType const* slots,
+                                            size_t capacity,
+                                            size_t ctrlLen,
+                                            Hash const& hasher)
+    {
+        for (size_t idx = capacity; idx < ctrlLen; ++idx)
+        {
+            if (*Layout::ctrlAt(ctrl, idx) != static_cast<ctrl_t>(Ctrl::Sentinel))
+            {
+                return false;
+            }
+        }
+        Group<Backend> first {ctrl};
+        for (int i : Backend::iterate(first.matchFull()))
+        {
+            // The control byte holds h2, the hash's low 7 bits
+            size_t hash = Policy::apply(hasher(*Layout::slotAt(slots, i)->element()));
+            if (ctrl[i] != static_cast<ctrl_t>(hash & 0x7F))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// Whether the control bytes hold exactly size full and used full or deleted slots, as
+    /// the header says. Reads every control byte, but no slot.
+    template<typename Layout>
+    [[nodiscard]] bool savedCountsMatch(ctrl_t const* ctrl,
+                                        size_t capacity,
+                                        size_t size,
+                                        size_t used)
+    {
+        size_t full = 0;
+        size_t deleted = 0;
+        for (size_t idx = 0; idx < capacity; ++idx)
+        {
+            ctrl_t c = *Layout::ctrlAt(ctrl, idx);
+            full += (c & 0x80) == 0;
+            deleted += c == static_cast<ctrl_t>(Ctrl::Deleted);
+        }
+        return full == size && full + deleted == used;
+    }
+
+    /// Lookups in a table saved by Table::saveTo, probing the saved buffer where it lies in
+    /// a mapped file. The file holds offsets only, resolved against the mapping once.
+    template<typename T,
+             typename Hash,
+             typename Equal,
+             typename Policy,
+             SimdBackend Backend,
+             typename LoadFactorRatio,
+             typename HashStoragePolicy,
+             typename Prober,
+             typename Mapped,
+             typename CtrlLayout>
+    class FrozenTable
+    {
+      protected:
+        static constexpr size_t LANE_COUNT = Backend::GroupSize;
+        static constexpr bool hasMapped = !std::is_void_v<Mapped>;
+        using Layout = TableLayout<T, LANE_COUNT, HashStoragePolicy, Mapped, CtrlLayout>;
+        using SlotType = Slot<T, HashStoragePolicy>;
+        /// The table type whose saved files this reads.
+        using Writer = Table<T,
+                             Hash,
+                             Equal,
+                             Policy,
+                             Backend,
+                             std::allocator<std::byte>,
+                             LoadFactorRatio,
+                             HashStoragePolicy,
+                             Prober,
+                             DefaultShrinkPolicy,
+                             Mapped,
+                             CtrlLayout>;
+
+        /// Maps the file and checks its header against this type. Only the sentinels and
+        /// the first group's hashes are checked, so that opening reads a page or two.
+        std::expected<void, Error> open(std::filesystem::path const& path, uint64_t hashSeed)
+        {
+            auto mapping = ReadOnlyMapping::open(path);
+            if (!mapping)
+            {
+                return std::unexpected(mapping.error());
+            }
+            SerializedTableHeader header;
+            if (mapping->size() < sizeof(header))
+            {
+                return std::unexpected(Error::IncompatibleFormat);
+            }
+            std::memcpy(&header, mapping->data(), sizeof(header));
+            if (!header.sameType(Writer::serializedHeader(hashSeed))
+                || header.bufferAlignment > sizeof(header))
+            {
+                return std::unexpected(Error::IncompatibleFormat);
+            }
+            if (header.capacity == 0)
+            {
+                mapping_ = std::move(*mapping);
+                return {};
+            }
+            if (!header.consistentShape(LANE_COUNT,
+                                        Layout::bufferSize(header.ctrlLen, header.capacity))
+                || mapping->size() - sizeof(header) < header.bufferSize)
+            {
+                return std::unexpected(Error::IncompatibleFormat);
+            }
+
+            auto const* buffer = mapping->data() + sizeof(header);
+            ctrl_ = reinterpret_cast<ctrl_t const*>(buffer);
+            slots_ =
+                reinterpret_cast<SlotType const*>(buffer + Layout::slotsOffset(header.ctrlLen));
+            if constexpr (hasMapped)
+            {
+                mapped_ = Layout::mapped(slots_, header.capacity);
+            }
+            capacity_ = header.capacity;
+            ctrlLen_ = header.ctrlLen;
+            groups_ = header.groups;
+            size_ = header.size;
+            mapping_ = std::move(*mapping);
+            if (!savedBufferPlausible<Backend, Layout, Policy>(
+                    ctrl_, slots_, capacity_, ctrlLen_, hasher_))
+            {
+                return std::unexpected(Error::IncompatibleFormat);
+            }
+            return {};
+        }
+
+        /// Probes like Table::find_internal, returning ctrlLen_ if the key is absent.
+        /// Probing visits each group at most once, whatever the file holds.
+        template<typename K>
+        [[nodiscard]] size_t findIndex(K const& key) const
+        {
+            if (size_ == 0)
+            {
+                return ctrlLen_;
+            }
+
+            size_t hash = Policy::apply(hasher_(key));
+            size_t mask = groups_ - 1;
+            auto group = h1(hash) & mask;
+            auto h2Val = h2(hash);
+            Prober prober {group};
+            for (size_t step = 0; step < groups_; ++step)
+            {
+                Group<Backend> g {Layout::ctrlAt(ctrl_, group * LANE_COUNT)};
+                for (int i : g.match(h2Val))
+                {
+                    if (equal_(key, *Layout::slotAt(slots_, group * LANE_COUNT + i)->element()))
+                        [[likely]]
+                    {
+                        return group * LANE_COUNT + i;
+                    }
+                }
+                if (g.anyEmpty()) [[likely]]
+                {
+                    break;
+                }
+                group = prober.nextGroup(group, mask);
+            }
+            return ctrlLen_;
+        }
+
+        [[nodiscard]] T const& elementAt(size_t idx) const noexcept
+        {
+            return *Layout::slotAt(slots_, idx)->element();
+        }
+
+        [[nodiscard]] auto const& mappedAt(size_t idx) const noexcept
+            requires hasMapped
+        {
+            return mapped_[idx];
+        }
+
+        /// Calls fn with the index of every element.
+        template<typename F>
+        void forEachIndex(F&& fn) const
+        {
+            for (size_t group = 0; group < groups_; ++group)
+            {
+                Group<Backend> g {Layout::ctrlAt(ctrl_, group * LANE_COUNT)};
+                for (int i : Backend::iterate(g.matchFull()))
+                {
+                    fn(group * LANE_COUNT + i);
+                }
+            }
+        }
+
+        ReadOnlyMapping mapping_;
+        ctrl_t const* ctrl_ = nullptr;
+        SlotType const* slots_ = nullptr;
+        std::conditional_t<hasMapped, Mapped, std::byte> const* mapped_ = nullptr;
+        size_t capacity_ = 0;
+        size_t ctrlLen_ = 0;
+        size_t groups_ = 0;
+        size_t size_ = 0;
+        [[no_unique_address]] Hash hasher_;
+        [[no_unique_address]] Equal equal_;
+
+      private:
+        static constexpr size_t h1(size_t hash) noexcept { return hash >> 7; }
+        static constexpr ctrl_t h2(size_t hash) noexcept { return hash & 0x7F; }
+    };
+
+    /// A read-only view of a Set saved to a file, looked up where it lies in the mapped
+    /// file: opening neither reads nor rehashes the elements, and processes opening the
+    /// same file share its memory. The parameters must match those of the saved Set.
+    export template<typename T,
+                    typename Hash = RapidHasher,
+                    typename Equal = std::equal_to<T>,
+                    typename Policy = HashPolicySelector<T, Hash>::type,
+                    SimdBackend Backend = DefaultBackend,
+                    typename LoadFactorRatio = typename DefaultLoadFactorSelector<Backend>::type,
+                    typename HashStoragePolicy = typename HashStorageSelector<T>::type,
+                    typename Prober = DefaultProber,
+                    typename CtrlLayout = ContiguousCtrlTag>
+        requires bitwiseSerializable<T>
+    class FrozenSet
+        : FrozenTable<T,
+                      Hash,
+                      Equal,
+                      Policy,
+                      Backend,
+                      LoadFactorRatio,
+                      HashStoragePolicy,
+                      Prober,
+                      void,
+                      CtrlLayout>
+    {
+        using Base = FrozenTable<T,
+                                 Hash,
+                                 Equal,
+                                 Policy,
+                                 Backend,
+                                 LoadFactorRatio,
+                                 HashStoragePolicy,
+                                 Prober,
+                                 void,
+                                 CtrlLayout>;
+
+      public:
+        using key_type = T;
+        using value_type = T;
+        using size_type = std::size_t;
+        using hasher = Hash;
+        using key_equal = Equal;
+
+        /// Maps a file written by Set::save. Fails with Error::IncompatibleFormat if it was
+        /// written by another Set type or with another hash function.
+        static std::expected<FrozenSet, Error> open(std::filesystem::path const& path)
+        {
+            FrozenSet set;
+            if (auto opened = set.Base::open(path, hashSeedOf<Hash>()); !opened)
+            {
+                return std::unexpected(opened.error());
+            }
+            return set;
+        }
+
+        [[nodiscard]] bool contains(T const& key) const
+        {
+            return Base::findIndex(key) != this->ctrlLen_;
+        }
+
+        [[nodiscard]] size_type count(T const& key) const { return contains(key) ? 1 : 0; }
+
+        [[nodiscard]]
+        std::expected<std::reference_wrapper<T const>, Error> get(T const& key) const
+        {
+            size_t idx = Base::findIndex(key);
+            if (idx == this->ctrlLen_)
+            {
+                return std::unexpected(Error::NotFound);
+            }
+            return std::cref(Base::elementAt(idx));
+        }
+
+        [[nodiscard]] size_type size() const noexcept { return this->size_; }
+        [[nodiscard]] bool empty() const noexcept { return this->size_ == 0; }
+        [[nodiscard]] size_type capacity() const noexcept { return this->capacity_; }
+
+        /// Calls fn on every element, in slot order.
+        template<typename F>
+            requires std::invocable<F&, T const&>
+        void for_each(F&& fn) const
+        {
+            Base::forEachIndex([&](size_t idx) { std::invoke(fn, Base::elementAt(idx)); });
+        }
+
+        hasher hash_function() const { return this->hasher_; }
+
+      private:
+        FrozenSet() = default;
+    };
+
+    /// A read-only view of a Map saved to a file, in the manner of FrozenSet. The
+    /// parameters must match those of the saved Map, except for its allocator and
+    /// shrink policy.
+    export template<typename Key,
+                    typename Value,
+                    typename Hash = RapidHasher,
+                    typename Equal = std::equal_to<Key>,
+                    typename Policy = HashPolicySelector<Key, Hash>::type,
+                    SimdBackend Backend = DefaultBackend,
+                    typename LoadFactorRatio = typename DefaultLoadFactorSelector<Backend>::type,
+                    typename HashStoragePolicy =
+                        typename HashStorageSelector<std::pair<Key const, Value>>::type,
+                    typename Prober = DefaultProber,
+                    typename Layout = PairLayoutTag,
+                    typename CtrlLayout = ContiguousCtrlTag>
+        requires bitwiseSerializable<std::pair<Key const, Value>>
+    class FrozenMap
+        : FrozenTable<std::conditional_t<std::is_same_v<Layout, SplitLayoutTag>,
+                                         Key,
+                                         std::pair<Key const, Value>>,
+                      MapHashAdapter<Key, Hash>,
+                      MapEqualAdapter<Key, Equal>,
+                      Policy,
+                      Backend,
+                      LoadFactorRatio,
+                      HashStoragePolicy,
+                      Prober,
+                      std::conditional_t<std::is_same_v<Layout, SplitLayoutTag>, Value, void>,
+                      CtrlLayout>
+    {
+        static constexpr bool isSplit = std::is_same_v<Layout, SplitLayoutTag>;
+        using Base = FrozenTable<std::conditional_t<isSplit, Key, std::pair<Key const, Value>>,
+                                 MapHashAdapter<Key, Hash>,
+                                 MapEqualAdapter<Key, Equal>,
+                                 Policy,
+                                 Backend,
+                                 LoadFactorRatio,
+                                 HashStoragePolicy,
+                                 Prober,
+                                 std::conditional_t<isSplit, Value, void>,
+                                 CtrlLayout>;
+
+      public:
+        using key_type = Key;
+        using mapped_type = Value;
+        using size_type = std::size_t;
+        using hasher = Hash;
+        using key_equal = Equal;
+
+        /// Maps a file written by Map::save. Fails with Error::IncompatibleFormat if it was
+        /// written by another Map type or with another hash function.
+        static std::expected<FrozenMap, Error> open(std::filesystem::path const& path)
+        {
+            FrozenMap map;
+            if (auto opened = map.Base::open(path, hashSeedOf<Hash>()); !opened)
+            {
+                return std::unexpected(opened.error());
+            }
+            return map;
+        }
+
+        [[nodiscard]] bool contains(Key const& key) const
+        {
+            return Base::findIndex(key) != this->ctrlLen_;
+        }
+
+        [[nodiscard]] size_type count(Key const& key) const { return contains(key) ? 1 : 0; }
+
+        [[nodiscard]]
+        std::expected<std::reference_wrapper<Value const>, Error> get(Key const& key) const
+        {
+            size_t idx = Base::findIndex(key);
+            if (idx == this->ctrlLen_)
+            {
+                return std::unexpected(Error::NotFound);
+            }
+            return std::cref(valueAt(idx));
+        }
+
+        [[nodiscard]] size_type size() const noexcept { return this->size_; }
+        [[nodiscard]] bool empty() const noexcept { return this->size_ == 0; }
+        [[nodiscard]] size_type capacity() const noexcept { return this->capacity_; }
+
+        /// Calls fn with every key and its value, in slot order.
+        template<typename F>
+            requires std::invocable<F&, Key const&, Value const&>
+        void for_each(F&& fn) const
+        {
+            Base::forEachIndex([&](size_t idx) { std::invoke(fn, keyAt(idx), valueAt(idx)); });
+        }
+
+        hasher hash_function() const { return this->hasher_.hasher; }
+
+      private:
+        FrozenMap() = default;
+
+        [[nodiscard]] Key const& keyAt(size_t idx) const noexcept
+        {
+            if constexpr (isSplit)
+            {
+                return Base::elementAt(idx);
+            }
+            else
+            {
+                return Base::elementAt(idx).first;
+            }
+        }
+
+        [[nodiscard]] Value const& valueAt(size_t idx) const noexcept
+        {
+            if constexpr (isSplit)
+            {
+                return Base::mappedAt(idx);
+            }
+            else
+            {
+                return Base::elementAt(idx).second;
+            }
+        }
+    };
+
+#if !defined(_WIN32)
+    /// Sizes a new file or shared-memory segment. Where the system can, its space is reserved
+    /// now: a mapped page the filesystem has no room for would otherwise raise SIGBUS when
+    /// first touched. Returns an errno value.
+    inline int reserveFile(int fd, size_t bytes) noexcept
+    {
+#if defined(__linux__)
+        return ::posix_fallocate(fd, 0, static_cast<off_t>(bytes));
+#else
+        return ::ftruncate(fd, static_cast<off_t>(bytes)) == 0 ? 0 : errno;
+#endif
+    }
+
+    /// The files behind the buffers of one table. Each buffer gets a file of its own,
+    /// preceded by a page for its header: the table's file while it is the only buffer, and
+    /// a sibling file while a rehash fills its replacement, which is then renamed over it.
+    class MappedFileArena
+    {
+      public:
+        /// Bytes in front of every buffer, where FileBackedSet writes its header.
+        static constexpr size_t headerSize = 4096;
+
+        explicit MappedFileArena(std::filesystem::path path)
+            : path_(std::move(path))
+            , nextPath_(path_.string() + ".next")
+        {
+        }
+
+        MappedFileArena(MappedFileArena const&) = delete;
+        MappedFileArena& operator=(MappedFileArena const&) = delete;
+
+        /// Every buffer has been deallocated.
+        ~MappedFileArena() = default;
+
+        /// Creates and maps a file for a buffer of the given size, replacing any stale one.
+        /// Throws std::system_error if the file cannot be created or mapped.
+        std::byte* allocate(size_t bytes)
+        {
+            bool atPath = std::ranges::none_of(regions_, &Region::atPath);
+            auto const& path = atPath ? path_ : nextPath_;
+            size_t length = headerSize + bytes;
+            int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd < 0)
+            {
+                throw std::system_error(errno, std::generic_category(), "alp: open");
+            }
+            if (int error = reserveFile(fd, length); error != 0)
+            {
+                ::close(fd);
+                throw std::system_error(error, std::generic_category(), "alp: posix_fallocate");
+            }
+            auto* base = mapShared(fd, length);
+            ::close(fd);
+            if (base == nullptr)
+            {
+                throw std::system_error(errno, std::generic_category(), "alp: mmap");
+            }
+            return track({base, length, atPath});
+        }
+
+        /// Maps the table's existing file, header included.
+        std::expected<std::span<std::byte>, Error> mapExisting()
+        {
+            int fd = ::open(path_.c_str(), O_RDWR | O_CLOEXEC);
+            if (fd < 0)
+            {
+                return std::unexpected(Error::IoFailure);
+            }
+            struct stat status {};
+            if (::fstat(fd, &status) != 0)
+            {
+                ::close(fd);
+                return std::unexpected(Error::IoFailure);
+            }
+            if (static_cast<size_t>(status.st_size) < headerSize)
+            {
+                ::close(fd);
+                return std::unexpected(Error::IncompatibleFormat);
+            }
+            size_t length = static_cast<size_t>(status.st_size);
+            auto* base = mapShared(fd, length);
+            ::close(fd);
+            if (base == nullptr)
+            {
+                return std::unexpected(Error::IoFailure);
+            }
+            track({base, length, true});
+            return std::span<std::byte>(base, length);
+        }
+
+        /// Unmaps a buffer. Once the table's old buffer is gone, its replacement's file
+        /// takes over the table's path; a replacement freed on its own is removed.
+        void deallocate(std::byte* buffer) noexcept
+        {
+            auto& region = regionOf(buffer);
+            ::munmap(region.base, region.length);
+            bool atPath = region.atPath;
+            region = {};
+            auto& other = regions_[&region == &regions_[0] ? 1 : 0];
+            if (!atPath)
+            {
+                ::unlink(nextPath_.c_str());
+            }
+            else if (other.base != nullptr)
+            {
+                ::rename(nextPath_.c_str(), path_.c_str());
+                other.atPath = true;
+            }
+        }
+
+        /// Returns the header page in front of buffer.
+        [[nodiscard]] static std::byte* headerOf(std::byte* buffer) noexcept
+        {
+            return buffer - headerSize;
+        }
+
+        /// Zeroes the header in front of buffer and waits until that is on disk, so that a
+        /// crash cannot leave the file with a header older than its contents.
+        /// Throws std::system_error if the header cannot be written back.
+        void clearHeader(std::byte* buffer)
+        {
+            auto& region = regionOf(buffer);
+            std::memset(region.base, 0, headerSize);
+            if (::msync(region.base, headerSize, MS_SYNC) != 0)
+            {
+                throw std::system_error(errno, std::generic_category(), "alp: msync");
+            }
+        }
+
+        /// Writes the dirty pages of buffer and its header back to its file.
+        std::expected<void, Error> sync(std::byte* buffer) noexcept
+        {
+            auto& region = regionOf(buffer);
+            if (::msync(region.base, region.length, MS_SYNC) != 0)
+            {
+                return std::unexpected(Error::IoFailure);
+            }
+            return {};
+        }
+
+      private:
+        struct Region
+        {
+            std::byte* base = nullptr;
+            size_t length = 0;
+            bool atPath = false;  // Mapped from path_ rather than nextPath_
+        };
+
+        /// Maps a file writably and shared, so that changes reach the file. Lookups hit
+        /// pages at random, so the kernel is told not to read ahead.
+        static std::byte* mapShared(int fd, size_t length) noexcept
+        {
+            void* base = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (base == MAP_FAILED)
+            {
+                return nullptr;
+            }
+            ::madvise(base, length, MADV_RANDOM);
+            return static_cast<std::byte*>(base);
+        }
+
+        std::byte* track(Region region) noexcept
+        {
+            auto& free = regions_[regions_[0].base == nullptr ? 0 : 1];
+            assert(free.base == nullptr);
+            free = region;
+            return region.base + headerSize;
+        }
+
+        Region& regionOf(std::byte* buffer) noexcept
+        {
+            auto* base = buffer - headerSize;
+            assert(base == regions_[0].base || base == regions_[1].base);
+            return regions_[base == regions_[0].base ? 0 : 1];
+        }
+
+        std::filesystem::path path_;
+        std::filesystem::path nextPath_;
+        /// The live buffers: one, or two while a rehash moves elements between them.
+        std::array<Region, 2> regions_ {};
+    };
+
+    /// Allocates each table buffer in a file of its own, mapped shared, so that the page cache
+    /// rather than the heap holds the elements and can evict them to the file. Buffers start
+    /// on a page boundary. FileBackedSet builds on it to reopen the file later.
+    export template<typename T>
+    class MappedFileAllocator
+    {
+      public:
+        using value_type = T;
+        /// Alignment of every allocation, so that tables use the mapping as it is.
+        static constexpr size_t alignment = MappedFileArena::headerSize;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+
+        /// Not bound to any file, as a table left behind by a move holds; it must not allocate.
+        MappedFileAllocator() noexcept = default;
+
+        /// Places buffers in the file at path, and while a rehash runs in a sibling file.
+        explicit MappedFileAllocator(std::filesystem::path path)
+            : arena_(std::make_shared<MappedFileArena>(std::move(path)))
+        {
+        }
+
+        explicit MappedFileAllocator(std::shared_ptr<MappedFileArena> arena) noexcept
+            : arena_(std::move(arena))
+        {
+        }
+
+        template<typename U>
+        MappedFileAllocator(MappedFileAllocator<U> const& other) noexcept
+            : arena_(other.arena())
+        {
+        }
+
+        T* allocate(size_t n)
+        {
+            return reinterpret_cast<T*>(arena_->allocate(n * sizeof(T)));
+        }
+
+        void deallocate(T* p, size_t) noexcept
+        {
+            arena_->deallocate(reinterpret_cast<std::byte*>(p));
+        }
+
+        [[nodiscard]] std::shared_ptr<MappedFileArena> const& arena() const noexcept
+        {
+            return arena_;
+        }
+
+        template<typename U>
+        bool operator==(MappedFileAllocator<U> const& other) const noexcept
+        {
+            return arena_ == other.arena();
+        }
+
+      private:
+        std::shared_ptr<MappedFileArena> arena_;
+    };
+
+    /// A Set of trivially copyable elements that lives in a file rather than in memory, for
+    /// sets larger than RAM: the page cache keeps the pages in use and writes the rest back.
+    /// flush() makes the file reopenable with open(), which maps it without rehashing.
+    /// Growing writes the whole table to a new file, so it needs disk space for both.
+    /// BlockedCtrlTag keeps a lookup's control bytes and slots on the same page.
+    export template<typename T,
+                    typename Hash = RapidHasher,
+                    typename Equal = std::equal_to<T>,
+                    typename Policy = HashPolicySelector<T, Hash>::type,
+                    SimdBackend Backend = DefaultBackend,
+                    typename LoadFactorRatio = typename DefaultLoadFactorSelector<Backend>::type,
+                    typename HashStoragePolicy = typename HashStorageSelector<T>::type,
+                    typename Prober = DefaultProber,
+                    typename CtrlLayout = ContiguousCtrlTag>
+        requires bitwiseSerializable<T>
+    class FileBackedSet
+        : Table<T,
+                Hash,
+                Equal,
+                Policy,
+                Backend,
+                MappedFileAllocator<std::byte>,
+                LoadFactorRatio,
+                HashStoragePolicy,
+                Prober,
+                NoShrinkPolicy,
+                void,
+                CtrlLayout>
+    {
+        using Base = Table<T,
+                           Hash,
+                           Equal,
+                           Policy,
+                           Backend,
+                           MappedFileAllocator<std::byte>,
+                           LoadFactorRatio,
+                           HashStoragePolicy,
+                           Prober,
+                           NoShrinkPolicy,
+                           void,
+                           CtrlLayout>;
+        using Layout = TableLayout<T, Backend::GroupSize, HashStoragePolicy, void, CtrlLayout>;
+
+      public:
+        using key_type = T;
+        using value_type = T;
+        using size_type = std::size_t;
+        using hasher = Hash;
+        using key_equal = Equal;
+
+        using Base::capacity;
+        using Base::empty;
+        using Base::rehash_threads;
+        using Base::reserve;
+        using Base::set_rehash_threads;
+        using Base::size;
+
+        FileBackedSet(FileBackedSet&&) noexcept = default;
+        FileBackedSet& operator=(FileBackedSet&&) = delete;
+
+        /// Writes the header, so that the file can be reopened once the kernel has written
+        /// the pages back. flush() also waits for that.
+        ~FileBackedSet() { writeHeader(); }
+
+        /// Creates an empty set in the file at path, replacing the file if it exists, with
+        /// room for capacity elements before the first rehash.
+        static std::expected<FileBackedSet, Error> create(std::filesystem::path const& path,
+                                                          size_type capacity = 0)
+        {
+            try
+            {
+                FileBackedSet set(std::make_shared<MappedFileArena>(path));
+                set.allocateInitial(capacity);
+                return set;
+            }
+            catch (std::system_error const&)
+            {
+                return std::unexpected(Error::IoFailure);
+            }
+        }
+
+        /// Maps a set that was flushed to the file at path. Fails with
+        /// Error::IncompatibleFormat if it holds another Set type, was modified after its
+        /// last flush and not closed since, or its control bytes disagree with the header.
+        /// Inserts rely on the header's counts to keep an empty slot, so unlike FrozenSet
+        /// this reads every control byte.
+        static std::expected<FileBackedSet, Error> open(std::filesystem::path const& path)
+        {
+            auto arena = std::make_shared<MappedFileArena>(path);
+            auto file = arena->mapExisting();
+            if (!file)
+            {
+                return std::unexpected(file.error());
+            }
+            auto* buffer = file->data() + MappedFileArena::headerSize;
+            SerializedTableHeader header;
+            std::memcpy(&header, file->data(), sizeof(header));
+            bool valid = header.sameType(Base::serializedHeader(hashSeedOf<Hash>()))
+                && header.capacity != 0
+                && header.consistentShape(Backend::GroupSize,
+                                          Layout::bufferSize(header.ctrlLen, header.capacity))
+                && file->size() - MappedFileArena::headerSize >= header.bufferSize
+                && savedBufferPlausible<Backend, Layout, Policy>(
+                       reinterpret_cast<ctrl_t const*>(buffer),
+                       reinterpret_cast<typename Layout::SlotType const*>(
+                           buffer + Layout::slotsOffset(header.ctrlLen)),
+                       header.capacity,
+                       header.ctrlLen,
+                       Hash())
+                && savedCountsMatch<Layout>(reinterpret_cast<ctrl_t const*>(buffer),
+                                            header.capacity,
+                                            header.size,
+                                            header.used);
+            if (!valid)
+            {
+                arena->deallocate(buffer);
+                return std::unexpected(Error::IncompatibleFormat);
+            }
+            FileBackedSet set(std::move(arena));
+            set.adoptBuffer(header, buffer);
+            set.headerCurrent_ = true;
+            return set;
+        }
+
+        /// Returns true if insertion took place. Throws std::system_error if growing the
+        /// set fails to create its new file, or the header cannot be cleared.
+        bool insert(T const& value)
+        {
+            clearHeader();
+            return Base::emplace_key(value, value).second;
+        }
+
+        [[nodiscard]] bool contains(T const& key) const
+        {
+            return Base::find_internal(key) != this->ctrlLen_;
+        }
+
+        size_type erase(T const& key)
+        {
+            size_t idx = Base::find_internal(key);
+            if (idx == this->ctrlLen_)
+            {
+                return 0;
+            }
+            clearHeader();
+            Base::erase_slot(idx);
+            return 1;
+        }
+
+        /// Empties the set, starting over in a new file.
+        void clear()
+        {
+            Base::clear();
+            headerCurrent_ = false;
+            allocateInitial(0);
+        }
+
+        /// Calls fn on every element, in slot order.
+        template<typename F>
+            requires std::invocable<F&, T const&>
+        void for_each(F&& fn) const
+        {
+            for (auto const& element : static_cast<Base const&>(*this))
+            {
+                std::invoke(fn, element);
+            }
+        }
+
+        /// Writes the header and every modified page to the file, returning once they
+        /// are on disk.
+        std::expected<void, Error> flush()
+        {
+            writeHeader();
+            auto synced = this->alloc_.arena()->sync(this->buffer_);
+            headerCurrent_ = synced.has_value();
+            return synced;
+        }
+
+        hasher hash_function() const { return this->hasher_; }
+
+      private:
+        explicit FileBackedSet(std::shared_ptr<MappedFileArena> arena)
+            : Base(MappedFileAllocator<std::byte>(std::move(arena)))
+        {
+        }
+
+        /// Allocates the file's buffer up front, so that no element is kept inline.
+        void allocateInitial(size_type capacity)
+        {
+            Base::reserve(std::max<size_type>(capacity, Base::inlineCapacity + 1));
+        }
+
+        void writeHeader() noexcept
+        {
+            if (this->buffer_ != nullptr)
+            {
+                auto header = Base::contentsHeader(hashSeedOf<Hash>());
+                std::memcpy(MappedFileArena::headerOf(this->buffer_), &header, sizeof(header));
+            }
+        }
+
+        /// Called before the first modification after a flush or open, so that open()
+        /// rejects the file until the header is written again.
+        void clearHeader()
+        {
+            if (headerCurrent_)
+            {
+                this->alloc_.arena()->clearHeader(this->buffer_);
+                headerCurrent_ = false;
+            }
+        }
+
+        /// Whether the header on disk describes the contents, as after flush() or open().
+        bool headerCurrent_ = false;
+    };
+
+    /// The part of a SharedMemoryMap that every process sees, in a segment of its own: the
+    /// lock that serializes writers, and which buffer segment is current and what it holds.
+    /// Like the buffers, it holds no pointers, as every process maps segments where it likes.
+    struct SharedMapControl
+    {
+        pthread_rwlock_t lock {};
+        SerializedTableHeader header;     // Type and dimensions of the current buffer
+        uint64_t generation = 0;          // Segment holding the current buffer
+        uint64_t lastGeneration = 0;      // Segment created last
+        std::atomic<uint32_t> ready {0};  // Set once the creator has allocated the first buffer
+    };
+
+    /// Holds lock for reading or for writing for as long as it lives.
+    class SharedMapLock
+    {
+      public:
+        SharedMapLock(pthread_rwlock_t& lock, bool exclusive) noexcept
+            : lock_(lock)
+        {
+            if (exclusive)
+            {
+                ::pthread_rwlock_wrlock(&lock_);
+            }
+            else
+            {
+                ::pthread_rwlock_rdlock(&lock_);
+            }
+        }
+
+        SharedMapLock(SharedMapLock const&) = delete;
+        SharedMapLock& operator=(SharedMapLock const&) = delete;
+
+        ~SharedMapLock() { ::pthread_rwlock_unlock(&lock_); }
+
+      private:
+        pthread_rwlock_t& lock_;
+    };
+
+    /// The POSIX shared-memory segments of one SharedMemoryMap, as mapped by one process: the
+    /// control segment called name, and a segment name.<generation> for every buffer. A
+    /// rehash creates the next generation and removes the old one, which stays mapped in
+    /// other processes until they next look at the control segment.
+    class SharedMemoryArena
+    {
+      public:
+        SharedMemoryArena(std::string name, SharedMapControl* control) noexcept
+            : name_(std::move(name))
+            , control_(control)
+        {
+        }
+
+        SharedMemoryArena(SharedMemoryArena const&) = delete;
+        SharedMemoryArena& operator=(SharedMemoryArena const&) = delete;
+
+        /// Every buffer has been unmapped.
+        ~SharedMemoryArena() { ::munmap(control_, sizeof(SharedMapControl)); }
+
+        /// Creates the control segment called name, which must not exist yet, and sets up
+        /// its lock. The creator then allocates the first buffer and marks it ready.
+        static std::expected<std::shared_ptr<SharedMemoryArena>, Error> create(
+            std::string const& name)
+        {
+            int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+            if (fd < 0)
+            {
+                return std::unexpected(Error::IoFailure);
+            }
+            auto* base = ::ftruncate(fd, sizeof(SharedMapControl)) == 0
+                ? mapShared(fd, sizeof(SharedMapControl))
+                : nullptr;
+            ::close(fd);
+            if (base == nullptr)
+            {
+                ::shm_unlink(name.c_str());
+                return std::unexpected(Error::IoFailure);
+            }
+            auto* control = new (base) SharedMapControl();
+            pthread_rwlockattr_t attributes;
+            ::pthread_rwlockattr_init(&attributes);
+            ::pthread_rwlockattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+            ::pthread_rwlock_init(&control->lock, &attributes);
+            ::pthread_rwlockattr_destroy(&attributes);
+            return std::make_shared<SharedMemoryArena>(name, control);
+        }
+
+        /// Maps the control segment called name, once its creator has marked it ready.
+        static std::expected<std::shared_ptr<SharedMemoryArena>, Error> open(
+            std::string const& name)
+        {
+            auto arena = attach(name);
+            if (arena && (*arena)->control().ready.load(std::memory_order_acquire) == 0)
+            {
+                return std::unexpected(Error::IoFailure);
+            }
+            return arena;
+        }
+
+        /// Removes the segments called name: the control segment and the current buffer's.
+        static void remove(std::string const& name) noexcept
+        {
+            if (auto arena = attach(name))
+            {
+                auto& control = (*arena)->control();
+                if (control.ready.load(std::memory_order_acquire) != 0)
+                {
+                    SharedMapLock lock(control.lock, false);
+                    ::shm_unlink(segmentName(name, control.generation).c_str());
+                }
+            }
+            ::shm_unlink(name.c_str());
+        }
+
+        [[nodiscard]] SharedMapControl& control() const noexcept { return *control_; }
+
+        /// Creates and maps the segment of a new buffer. Called with the lock held for
+        /// writing. Throws std::system_error if the segment cannot be created or mapped.
+        std::byte* allocate(size_t bytes)
+        {
+            uint64_t generation = ++control_->lastGeneration;
+            auto segment = segmentName(name_, generation);
+            int fd = ::shm_open(segment.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+            if (fd < 0)
+            {
+                throw std::system_error(errno, std::generic_category(), "alp: shm_open");
+            }
+            int error = reserveFile(fd, bytes);
+            auto* base = error == 0 ? mapShared(fd, bytes) : nullptr;
+            error = base == nullptr && error == 0 ? errno : error;
+            ::close(fd);
+            if (base == nullptr)
+            {
+                ::shm_unlink(segment.c_str());
+                throw std::system_error(error, std::generic_category(), "alp: shm segment");
+            }
+            return track({base, bytes, generation});
+        }
+
+        /// Maps the segment of the buffer another process allocated for generation.
+        /// Throws std::system_error if it is gone.
+        std::byte* mapSegment(uint64_t generation, size_t bytes)
+        {
+            int fd = ::shm_open(segmentName(name_, generation).c_str(), O_RDWR, 0);
+            if (fd < 0)
+            {
+                throw std::system_error(errno, std::generic_category(), "alp: shm_open");
+            }
+            auto* base = mapShared(fd, bytes);
+            int error = errno;
+            ::close(fd);
+            if (base == nullptr)
+            {
+                throw std::system_error(error, std::generic_category(), "alp: mmap");
+            }
+            return track({base, bytes, generation});
+        }
+
+        /// Unmaps a buffer in this process only.
+        void unmap(std::byte* buffer) noexcept
+        {
+            auto& region = regionOf(buffer);
+            ::munmap(region.base, region.length);
+            region = {};
+        }
+
+        /// Unmaps a buffer and removes its segment, which other processes that still map
+        /// it keep until they let go of it too.
+        void deallocate(std::byte* buffer) noexcept
+        {
+            ::shm_unlink(segmentName(name_, generationOf(buffer)).c_str());
+            unmap(buffer);
+        }
+
+        [[nodiscard]] uint64_t generationOf(std::byte* buffer) noexcept
+        {
+            return regionOf(buffer).generation;
+        }
+
+      private:
+        struct Region
+        {
+            std::byte* base = nullptr;
+            size_t length = 0;
+            uint64_t generation = 0;
+        };
+
+        static std::expected<std::shared_ptr<SharedMemoryArena>, Error> attach(
+            std::string const& name)
+        {
+            int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+            if (fd < 0)
+            {
+                return std::unexpected(Error::IoFailure);
+            }
+            struct stat status {};
+            bool complete = ::fstat(fd, &status) == 0
+                && static_cast<size_t>(status.st_size) >= sizeof(SharedMapControl);
+            auto* base = complete ? mapShared(fd, sizeof(SharedMapControl)) : nullptr;
+            ::close(fd);
+            if (base == nullptr)
+            {
+                return std::unexpected(Error::IoFailure);
+            }
+            return std::make_shared<SharedMemoryArena>(
+                name, std::launder(reinterpret_cast<SharedMapControl*>(base)));
+        }
+
+        static std::string segmentName(std::string const& name, uint64_t generation)
+        {
+            return name + '.' + std::to_string(generation);
+        }
+
+        static std::byte* mapShared(int fd, size_t length) noexcept
+        {
+            void* base = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            return base == MAP_FAILED ? nullptr : static_cast<std::byte*>(base);
+        }
+
+        std::byte* track(Region region) noexcept
+        {
+            auto& free = regions_[regions_[0].base == nullptr ? 0 : 1];
+            assert(free.base == nullptr);
+            free = region;
+            return region.base;
+        }
+
+        Region& regionOf(std::byte* buffer) noexcept
+        {
+            assert(buffer == regions_[0].base || buffer == regions_[1].base);
+            return regions_[buffer == regions_[0].base ? 0 : 1];
+        }
+
+        std::string name_;
+        SharedMapControl* control_;
+        /// The buffers mapped here: one, or two while a rehash moves elements between them.
+        std::array<Region, 2> regions_ {};
+    };
+
+    /// Allocates each table buffer in a shared-memory segment of its own. Buffers start on a
+    /// page boundary.
+    template<typename T>
+    class SharedMemoryAllocator
+    {
+      public:
+        using value_type = T;
+        static constexpr size_t alignment = 4096;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+
+        /// Not bound to any segment, as a table left behind by a move holds; it must not
+        /// allocate.
+        SharedMemoryAllocator() noexcept = default;
+
+        explicit SharedMemoryAllocator(std::shared_ptr<SharedMemoryArena> arena) noexcept
+            : arena_(std::move(arena))
+        {
+        }
+
+        template<typename U>
+        SharedMemoryAllocator(SharedMemoryAllocator<U> const& other) noexcept
+            : arena_(other.arena())
+        {
+        }
+
+        T* allocate(size_t n) { return reinterpret_cast<T*>(arena_->allocate(n * sizeof(T))); }
+
+        void deallocate(T* p, size_t) noexcept
+        {
+            arena_->deallocate(reinterpret_cast<std::byte*>(p));
+        }
+
+        [[nodiscard]] std::shared_ptr<SharedMemoryArena> const& arena() const noexcept
+        {
+            return arena_;
+        }
+
+        template<typename U>
+        bool operator==(SharedMemoryAllocator<U> const& other) const noexcept
+        {
+            return arena_ == other.arena();
+        }
+
+      private:
+        std::shared_ptr<SharedMemoryArena> arena_;
+    };
+
+    /// A Map of trivially copyable keys and values in POSIX shared memory, so that worker
+    /// processes share one copy of a cache rather than building one each. One process
+    /// create()s it under a name such as "/cache", the others open() it. The buffer holds
+    /// no pointers: each process maps it where it likes and finds the slots at their fixed
+    /// offset from its start. A process-shared reader-writer lock lets lookups run in
+    /// parallel and serializes writers; every call takes it once. Instances are not
+    /// thread-safe: each thread opens its own. A process that dies while holding the lock
+    /// leaves it held, and the segments outlive every process until remove().
+    export template<typename Key,
+                    typename Value,
+                    typename Hash = RapidHasher,
+                    typename Equal = std::equal_to<Key>,
+                    typename Policy = HashPolicySelector<Key, Hash>::type,
+                    SimdBackend Backend = DefaultBackend,
+                    typename LoadFactorRatio = typename DefaultLoadFactorSelector<Backend>::type,
+                    typename HashStoragePolicy =
+                        typename HashStorageSelector<std::pair<Key const, Value>>::type,
+                    typename Prober = DefaultProber>
+        requires bitwiseSerializable<std::pair<Key const, Value>>
+    class SharedMemoryMap
+    {
+        using Base = Table<std::pair<Key const, Value>,
+                           MapHashAdapter<Key, Hash>,
+                           MapEqualAdapter<Key, Equal>,
+                           Policy,
+                           Backend,
+                           SharedMemoryAllocator<std::byte>,
+                           LoadFactorRatio,
+                           HashStoragePolicy,
+                           Prober,
+                           NoShrinkPolicy,
+                           void,
+                           ContiguousCtrlTag>;
+
+      public:
+        using key_type = Key;
+        using mapped_type = Value;
+        using value_type = std::pair<Key const, Value>;
+        using size_type = std::size_t;
+        using hasher = Hash;
+        using key_equal = Equal;
+
+        SharedMemoryMap(SharedMemoryMap&&) noexcept = default;
+        SharedMemoryMap& operator=(SharedMemoryMap&&) = delete;
+
+        /// Unmaps the buffer; the map itself stays for the other processes.
+        ~SharedMemoryMap()
+        {
+            if (auto* buffer = view_.buffer())
+            {
+                view_.releaseBuffer();
+                view_.arena().unmap(buffer);
+            }
+        }
+
+        /// Creates an empty map called name, with room for capacity elements before the
+        /// first rehash. Fails with Error::IoFailure if the name is taken.
+        static std::expected<SharedMemoryMap, Error> create(std::string const& name,
+                                                            size_type capacity = 0)
+        {
+            auto arena = SharedMemoryArena::create(name);
+            if (!arena)
+            {
+                return std::unexpected(arena.error());
+            }
+            auto& control = (*arena)->control();
+            try
+            {
+                SharedMemoryMap map(std::move(*arena));
+                control.header = Base::serializedHeader(hashSeedOf<Hash>());
+                map.write([&] { map.allocateInitial(capacity); });
+                control.ready.store(1, std::memory_order_release);
+                return map;
+            }
+            catch (std::system_error const&)
+            {
+                ::shm_unlink(name.c_str());
+                return std::unexpected(Error::IoFailure);
+            }
+        }
+
+        /// Opens the map another process created under name. Fails with
+        /// Error::IoFailure if there is none yet, and with Error::IncompatibleFormat if it
+        /// holds another Map type.
+        static std::expected<SharedMemoryMap, Error> open(std::string const& name)
+        {
+            auto arena = SharedMemoryArena::open(name);
+            if (!arena)
+            {
+                return std::unexpected(arena.error());
+            }
+            if (!(*arena)->control().header.sameType(Base::serializedHeader(hashSeedOf<Hash>())))
+            {
+                return std::unexpected(Error::IncompatibleFormat);
+            }
+            return SharedMemoryMap(std::move(*arena));
+        }
+
+        /// Removes the map called name once every process is done with it.
+        static void remove(std::string const& name) noexcept { SharedMemoryArena::remove(name); }
+
+        /// Returns true if insertion took place. Throws std::system_error if growing the
+        /// map fails to create its new segment, as when /dev/shm is full.
+        bool insert(Key const& key, Value const& value)
+        {
+            return write([&] { return emplace(key, value).second; });
+        }
+
+        /// Inserts value for key, or assigns it if key is present. Returns true if
+        /// insertion took place.
+        bool insert_or_assign(Key const& key, Value const& value)
+        {
+            return write(
+                [&]
+                {
+                    auto [idx, inserted] = emplace(key, value);
+                    if (!inserted)
+                    {
+                        view_.slotAt(idx)->element()->second = value;
+                    }
+                    return inserted;
+                });
+        }
+
+        size_type erase(Key const& key)
+        {
+            return write(
+                [&]() -> size_type
+                {
+                    size_t idx = view_.find_internal(key);
+                    if (idx == view_.notFound())
+                    {
+                        return 0;
+                    }
+                    view_.erase_slot(idx);
+                    return 1;
+                });
+        }
+
+        [[nodiscard]] bool contains(Key const& key) const
+        {
+            return read([&] { return view_.find_internal(key) != view_.notFound(); });
+        }
+
+        /// Returns a copy of the value for key, as the element may change once the lock is
+        /// released.
+        std::expected<Value, Error> get(Key const& key) const
+        {
+            return read(
+                [&]() -> std::expected<Value, Error>
+                {
+                    size_t idx = view_.find_internal(key);
+                    if (idx == view_.notFound())
+                    {
+                        return std::unexpected(Error::NotFound);
+                    }
+                    return view_.slotAt(idx)->element()->second;
+                });
+        }
+
+        /// Calls fn with the element for key, if there is one, under the lock held for
+        /// reading. Returns whether there was one.
+        template<typename F>
+            requires std::invocable<F&, value_type const&>
+        bool cvisit(Key const& key, F&& fn) const
+        {
+            return read(
+                [&]
+                {
+                    size_t idx = view_.find_internal(key);
+                    if (idx == view_.notFound())
+                    {
+                        return false;
+                    }
+                    std::invoke(fn, std::as_const(*view_.slotAt(idx)->element()));
+                    return true;
+                });
+        }
+
+        /// Calls fn on every element, in slot order, under the lock held for reading.
+        template<typename F>
+            requires std::invocable<F&, value_type const&>
+        void for_each(F&& fn) const
+        {
+            read(
+                [&]
+                {
+                    for (auto const& element : static_cast<Base const&>(view_))
+                    {
+                        std::invoke(fn, element);
+                    }
+                });
+        }
+
+        [[nodiscard]] size_type size() const
+        {
+            return read([&] { return view_.size(); });
+        }
+
+        [[nodiscard]] bool empty() const { return size() == 0; }
+
+        /// Empties the map, starting over in a new segment.
+        void clear()
+        {
+            write(
+                [&]
+                {
+                    view_.clear();
+                    allocateInitial(0);
+                });
+        }
+
+        void reserve(size_type count)
+        {
+            write([&] { view_.reserve(count); });
+        }
+
+        hasher hash_function() const { return view_.hash_function(); }
+
+      private:
+        /// The table as this process sees it, with the shared buffer mapped at an address of
+        /// its own. It is refreshed under the lock at every call, since other processes may
+        /// have changed the table's dimensions or replaced its buffer since the last one.
+        struct View : Base
+        {
+            explicit View(SharedMemoryAllocator<std::byte> const& alloc)
+                : Base(alloc)
+            {
+            }
+
+            using Base::emplace_key;
+            using Base::erase_slot;
+            using Base::find_internal;
+            using Base::inlineCapacity;
+            using Base::reserve;
+            using Base::slotAt;
+
+            [[nodiscard]] std::byte* buffer() const noexcept { return this->buffer_; }
+            [[nodiscard]] size_t notFound() const noexcept { return this->ctrlLen_; }
+            [[nodiscard]] SharedMemoryArena& arena() const noexcept
+            {
+                return *this->alloc_.arena();
+            }
+            [[nodiscard]] Hash hash_function() const { return this->hasher_.hasher; }
+        };
+
+        explicit SharedMemoryMap(std::shared_ptr<SharedMemoryArena> arena)
+            : view_(SharedMemoryAllocator<std::byte>(std::move(arena)))
+        {
+        }
+
+        std::pair<size_t, bool> emplace(Key const& key, Value const& value)
+        {
+            return view_.emplace_key(key,
+                                     std::piecewise_construct,
+                                     std::forward_as_tuple(key),
+                                     std::forward_as_tuple(value));
+        }
+
+        /// Allocates the first buffer up front, so that no element is kept inline.
+        void allocateInitial(size_type capacity)
+        {
+            view_.reserve(std::max<size_type>(capacity, View::inlineCapacity + 1));
+        }
+
+        template<typename F>
+        decltype(auto) read(F&& fn) const
+        {
+            SharedMapLock lock(view_.arena().control().lock, false);
+            attach();
+            return fn();
+        }
+
+        /// Runs fn with the lock held for writing, then publishes the table's new
+        /// dimensions and buffer, even if fn throws after changing them.
+        template<typename F>
+        decltype(auto) write(F&& fn)
+        {
+            SharedMapLock lock(view_.arena().control().lock, true);
+            attach();
+            struct Publisher
+            {
+                SharedMemoryMap& map;
+                ~Publisher() { map.publish(); }
+            } publisher {*this};
+            return fn();
+        }
+
+        /// Points the view at the current buffer, mapping it if another process replaced
+        /// the one mapped here.
+        void attach() const
+        {
+            auto& arena = view_.arena();
+            auto const& control = arena.control();
+            auto* buffer = view_.buffer();
+            view_.releaseBuffer();
+            if (buffer != nullptr && arena.generationOf(buffer) != control.generation)
+            {
+                arena.unmap(buffer);
+                buffer = nullptr;
+            }
+            if (control.header.capacity == 0)
+            {
+                return;
+            }
+            if (buffer == nullptr)
+            {
+                buffer = arena.mapSegment(control.generation, control.header.bufferSize);
+            }
+            view_.adoptBuffer(control.header, buffer);
+        }
+
+        void publish() noexcept
+        {
+            auto& control = view_.arena().control();
+            control.header = view_.contentsHeader(hashSeedOf<Hash>());
+            if (auto* buffer = view_.buffer())
+            {
+                control.generation = view_.arena().generationOf(buffer);
+            }
+        }
+
+        mutable View view_;
+    };
+#endif
+}  // namespace alp
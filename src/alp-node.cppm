@@ -0,0 +1,721 @@
+module;
+
+#include <algorithm>
+#include <cstddef>
+#include <expected>
+#include <functional>
+#include <memory>
+#include <ratio>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+export module alp:node;
+
+import :set;
+import :map;
+import :rapid_hash;
+
+namespace alp
+{
+    /// Hashes the element a node pointer refers to, and forwards any other key unchanged.
+    template<typename Hash, typename T>
+    struct NodeHashAdapter
+    {
+        [[no_unique_address]] Hash hasher;
+
+        auto operator()(T* const& node) const noexcept(noexcept(hasher(*node)))
+        {
+            return hasher(*node);
+        }
+
+        template<typename K>
+            requires(!std::is_same_v<K, T*>)
+        auto operator()(K const& key) const noexcept(noexcept(hasher(key)))
+        {
+            return hasher(key);
+        }
+    };
+
+    /// Compares a key (or an element) with the element a node pointer refers to.
+    template<typename Equal>
+    struct NodeEqualAdapter
+    {
+        [[no_unique_address]] Equal eq;
+
+        template<typename K, typename T>
+        bool operator()(K const& key, T* const& node) const
+        {
+            return eq(key, *node);
+        }
+    };
+
+    /// Converts to a node built by make(), so that emplace_internal only allocates
+    /// and constructs a node once it has established that the key is absent.
+    template<typename F>
+    struct LazyNode
+    {
+        F make;
+
+        operator std::invoke_result_t<F const&>() const { return make(); }
+    };
+
+    /// Hands out storage for single T objects, carved from blocks obtained from Allocator.
+    /// Released storage is kept on a free list for reuse and blocks are only given back
+    /// to Allocator by release() or the destructor, once no object lives in them.
+    template<typename T, typename Allocator>
+    class NodePool
+    {
+        union Node
+        {
+            Node* next;
+            alignas(T) std::byte storage[sizeof(T)];
+        };
+
+        struct Block
+        {
+            Node* nodes;
+            size_t count;
+        };
+
+        using NodeAlloc = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+        using NodeAllocTraits = std::allocator_traits<NodeAlloc>;
+        using BlockAlloc = typename std::allocator_traits<Allocator>::template rebind_alloc<Block>;
+
+        /// Blocks double in size from firstBlockNodes up to roughly 64 KiB, so that small
+        /// tables stay small and large ones make few, large allocations.
+        static constexpr size_t firstBlockNodes = 8;
+        static constexpr size_t maxBlockNodes =
+            std::max<size_t>(firstBlockNodes, (size_t {1} << 16) / sizeof(Node));
+
+      public:
+        explicit NodePool(Allocator const& alloc = Allocator())
+            : alloc_(alloc)
+            , blocks_(BlockAlloc(alloc))
+        {
+        }
+
+        NodePool(NodePool const&) = delete;
+        NodePool& operator=(NodePool const&) = delete;
+
+        ~NodePool() { release(); }
+
+        T* allocate()
+        {
+            if (free_ != nullptr)
+            {
+                Node* node = free_;
+                free_ = node->next;
+                return reinterpret_cast<T*>(node->storage);
+            }
+            if (nextUnused_ == blockEnd_)
+            {
+                grow();
+            }
+            return reinterpret_cast<T*>((nextUnused_++)->storage);
+        }
+
+        void deallocate(T* p) noexcept
+        {
+            auto* node = reinterpret_cast<Node*>(p);
+            node->next = free_;
+            free_ = node;
+        }
+
+        /// Returns every block to the allocator. No object may live in the pool.
+        void release() noexcept
+        {
+            for (Block const& block : blocks_)
+            {
+                NodeAllocTraits::deallocate(alloc_, block.nodes, block.count);
+            }
+            blocks_.clear();
+            free_ = nullptr;
+            nextUnused_ = nullptr;
+            blockEnd_ = nullptr;
+        }
+
+        void swap(NodePool& other) noexcept
+        {
+            using std::swap;
+            swap(alloc_, other.alloc_);
+            blocks_.swap(other.blocks_);
+            swap(free_, other.free_);
+            swap(nextUnused_, other.nextUnused_);
+            swap(blockEnd_, other.blockEnd_);
+        }
+
+      private:
+        void grow()
+        {
+            size_t count = blocks_.empty()
+                ? firstBlockNodes
+                : std::min(blocks_.back().count * 2, maxBlockNodes);
+            blocks_.reserve(blocks_.size() + 1);
+            Node* nodes = NodeAllocTraits::allocate(alloc_, count);
+            blocks_.push_back({nodes, count});
+            nextUnused_ = nodes;
+            blockEnd_ = nodes + count;
+        }
+
+        [[no_unique_address]] NodeAlloc alloc_;
+        std::vector<Block, BlockAlloc> blocks_;
+        Node* free_ = nullptr;
+        Node* nextUnused_ = nullptr;
+        Node* blockEnd_ = nullptr;
+    };
+
+    /// Iterator over a node table, yielding the elements its node pointers refer to.
+    export template<typename Inner, typename Value>
+    struct NodeIterator
+    {
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::remove_const_t<Value>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Value*;
+        using reference = Value&;
+
+        Inner inner;
+
+        NodeIterator() = default;
+        explicit NodeIterator(Inner it) noexcept
+            : inner(it)
+        {
+        }
+
+        /// Allow conversion from iterator to const_iterator
+        template<typename OtherInner, typename OtherValue>
+            requires std::is_convertible_v<OtherInner, Inner>
+            && (!std::is_same_v<OtherInner, Inner>)
+        NodeIterator(NodeIterator<OtherInner, OtherValue> const& other) noexcept
+            : inner(other.inner)
+        {
+        }
+
+        template<typename OtherInner, typename OtherValue>
+        friend bool operator==(NodeIterator const& lhs,
+                               NodeIterator<OtherInner, OtherValue> const& rhs) noexcept
+        {
+            return lhs.inner == rhs.inner;
+        }
+
+        Value& operator*() const noexcept { return **inner; }
+        Value* operator->() const noexcept { return *inner; }
+
+        NodeIterator& operator++() noexcept
+        {
+            ++inner;
+            return *this;
+        }
+    };
+
+    /// A hash set that stores each element in its own node, so references and pointers
+    /// to elements stay valid across rehashing. The table itself only holds node pointers
+    /// and their hashes, and nodes are allocated from a pool owned by the set.
+    export template<typename T,
+                    typename Hash = RapidHasher,
+                    typename Equal = std::equal_to<T>,
+                    typename Policy = HashPolicySelector<T, Hash>::type,
+                    SimdBackend Backend = DefaultBackend,
+                    typename Allocator = std::allocator<std::byte>,
+                    typename LoadFactorRatio = typename DefaultLoadFactorSelector<Backend>::type>
+    class NodeSet
+        : Table<T*,
+                NodeHashAdapter<Hash, T>,
+                NodeEqualAdapter<Equal>,
+                Policy,
+                Backend,
+                Allocator,
+                LoadFactorRatio,
+                StoreHashTag>
+    {
+        using Base = Table<T*,
+                           NodeHashAdapter<Hash, T>,
+                           NodeEqualAdapter<Equal>,
+                           Policy,
+                           Backend,
+                           Allocator,
+                           LoadFactorRatio,
+                           StoreHashTag>;
+
+      public:
+        using value_type = T;
+        using size_type = Base::size_type;
+        using difference_type = Base::difference_type;
+        using hasher = Hash;
+        using key_equal = Equal;
+        using reference = value_type&;
+        using const_reference = value_type const&;
+        using pointer = value_type*;
+        using const_pointer = value_type const*;
+        using allocator_type = typename Base::allocator_type;
+
+        using iterator = NodeIterator<typename Base::const_iterator, T const>;
+        using const_iterator = iterator;
+
+        using Base::capacity;
+        using Base::empty;
+        using Base::incremental_rehash;
+        using Base::rehash_threads;
+        using Base::reserve;
+        using Base::set_incremental_rehash;
+        using Base::set_rehash_threads;
+        using Base::shrink_to_fit;
+        using Base::size;
+
+        NodeSet() = default;
+
+        explicit NodeSet(Allocator const& alloc)
+            : Base(alloc)
+            , pool_(alloc)
+        {
+        }
+
+        explicit NodeSet(size_type capacity, Allocator const& alloc = Allocator())
+            : Base(capacity, alloc)
+            , pool_(alloc)
+        {
+        }
+
+        /// Copies the elements along with the hasher, equality and rehash settings.
+        NodeSet(NodeSet const& other)
+            : Base(typename Base::CopySettingsTag {}, other)
+            , pool_(this->alloc_)
+        {
+            reserve(other.size());
+            for (T const& value : other)
+            {
+                emplace(value);
+            }
+        }
+
+        NodeSet(NodeSet&& other) noexcept
+            : Base(other.alloc_)
+            , pool_(other.alloc_)
+        {
+            swap(other);
+        }
+
+        NodeSet& operator=(NodeSet const& other)
+        {
+            if (this != &other)
+            {
+                NodeSet copy(other);
+                swap(copy);
+            }
+            return *this;
+        }
+
+        NodeSet& operator=(NodeSet&& other) noexcept
+        {
+            NodeSet moved(std::move(other));
+            swap(moved);
+            return *this;
+        }
+
+        ~NodeSet() { destroyNodes(); }
+
+        iterator begin() const { return iterator {Base::begin()}; }
+        iterator end() const { return iterator {Base::end()}; }
+        const_iterator cbegin() const { return begin(); }
+        const_iterator cend() const { return end(); }
+
+        template<typename K>
+            requires std::is_same_v<std::remove_cvref_t<K>, T>
+            || requires { typename Hash::is_transparent; }
+        [[nodiscard]] iterator find(K const& key) const
+        {
+            size_t idx = Base::find_internal(key);
+            if (idx == this->ctrlLen_)
+                return end();
+            return iterator {Base::iteratorAt(idx)};
+        }
+
+        template<typename K>
+            requires std::is_same_v<std::remove_cvref_t<K>, T>
+            || requires { typename Hash::is_transparent; }
+        bool contains(K const& key) const
+        {
+            return Base::find_internal(key) != this->ctrlLen_;
+        }
+
+        hasher hash_function() const { return this->hasher_.hasher; }
+
+        /// Constructs an element from args if no equal element exists.
+        /// A single T is probed for directly and only copied or moved into a new node
+        /// on a miss; other arguments build the node first and release it on a hit.
+        template<typename... Args>
+        std::pair<iterator, bool> emplace(Args&&... args)
+        {
+            if constexpr (sizeof...(Args) == 1
+                          && (std::is_same_v<std::remove_cvref_t<Args>, T> && ...))
+            {
+                LazyNode node {[&] { return makeNode(std::forward<Args>(args)...); }};
+                auto [idx, success] = Base::emplace_key(args..., node);
+                return {iterator {Base::iteratorAt(idx)}, success};
+            }
+            else
+            {
+                auto [idx, success] = emplaceNode(makeNode(std::forward<Args>(args)...));
+                return {iterator {Base::iteratorAt(idx)}, success};
+            }
+        }
+
+        std::pair<iterator, bool> insert(T const& value) { return emplace(value); }
+
+        std::pair<iterator, bool> insert(T&& value) { return emplace(std::move(value)); }
+
+        void erase(const_iterator pos)
+        {
+            T* node = *pos.inner;
+            Base::erase_slot(Base::indexOf(pos.inner));
+            destroyNode(node);
+        }
+
+        size_type erase(T const& key)
+        {
+            auto it = find(key);
+            if (it == end())
+                return 0;
+            erase(it);
+            return 1;
+        }
+
+        [[nodiscard]]
+        std::expected<std::reference_wrapper<T const>, Error> get(T const& key) const
+        {
+            auto it = find(key);
+            if (it != end())
+            {
+                return std::cref(*it);
+            }
+            return std::unexpected(Error::NotFound);
+        }
+
+        /// Destroys all elements and returns the node pool's memory to the allocator.
+        void clear() noexcept
+        {
+            destroyNodes();
+            Base::clear();
+            pool_.release();
+        }
+
+        void swap(NodeSet& other) noexcept
+        {
+            Base::swap(other);
+            pool_.swap(other.pool_);
+        }
+
+        friend void swap(NodeSet& lhs, NodeSet& rhs) noexcept { lhs.swap(rhs); }
+
+      private:
+        template<typename... Args>
+        T* makeNode(Args&&... args)
+        {
+            T* node = pool_.allocate();
+            try
+            {
+                std::construct_at(node, std::forward<Args>(args)...);
+            }
+            catch (...)
+            {
+                pool_.deallocate(node);
+                throw;
+            }
+            return node;
+        }
+
+        void destroyNode(T* node) noexcept
+        {
+            std::destroy_at(node);
+            pool_.deallocate(node);
+        }
+
+        /// Inserts an already built node, destroying it if an equal element exists.
+        std::pair<size_t, bool> emplaceNode(T* node)
+        {
+            std::pair<size_t, bool> result;
+            try
+            {
+                result = Base::emplace_key(*node, node);
+            }
+            catch (...)
+            {
+                destroyNode(node);
+                throw;
+            }
+            if (!result.second)
+            {
+                destroyNode(node);
+            }
+            return result;
+        }
+
+        void destroyNodes() noexcept
+        {
+            for (auto it = Base::begin(); it != Base::end(); ++it)
+            {
+                std::destroy_at(*it);
+            }
+        }
+
+        NodePool<T, Allocator> pool_;
+    };
+
+    /// A hash map (unordered_map) that stores each key-value pair in its own node, so
+    /// references and pointers to pairs stay valid across rehashing. Suited to large
+    /// values, which a flat table would move on every growth.
+    export template<typename Key,
+                    typename Value,
+                    typename Hash = RapidHasher,
+                    typename Equal = std::equal_to<Key>,
+                    typename Policy = HashPolicySelector<Key, Hash>::type,
+                    SimdBackend Backend = DefaultBackend,
+                    typename Allocator = std::allocator<std::byte>,
+                    typename LoadFactorRatio = typename DefaultLoadFactorSelector<Backend>::type>
+    class NodeMap
+        : Table<std::pair<Key const, Value>*,
+                NodeHashAdapter<MapHashAdapter<Key, Hash>, std::pair<Key const, Value>>,
+                NodeEqualAdapter<MapEqualAdapter<Key, Equal>>,
+                Policy,
+                Backend,
+                Allocator,
+                LoadFactorRatio,
+                StoreHashTag>,
+          public MapOperations<
+              NodeMap<Key, Value, Hash, Equal, Policy, Backend, Allocator, LoadFactorRatio>,
+              Key,
+              Value>
+    {
+        using PairType = std::pair<Key const, Value>;
+        using Base = Table<PairType*,
+                           NodeHashAdapter<MapHashAdapter<Key, Hash>, PairType>,
+                           NodeEqualAdapter<MapEqualAdapter<Key, Equal>>,
+                           Policy,
+                           Backend,
+                           Allocator,
+                           LoadFactorRatio,
+                           StoreHashTag>;
+        using Operations = MapOperations<NodeMap, Key, Value>;
+
+      public:
+        using key_type = Key;
+        using mapped_type = Value;
+        using hasher = Hash;
+        using key_equal = Equal;
+        using value_type = PairType;
+        using size_type = Base::size_type;
+        using allocator_type = typename Base::allocator_type;
+        using iterator = NodeIterator<typename Base::iterator, PairType>;
+        using const_iterator = NodeIterator<typename Base::const_iterator, PairType const>;
+
+        using Base::capacity;
+        using Base::empty;
+        using Base::incremental_rehash;
+        using Base::rehash_threads;
+        using Base::reserve;
+        using Base::set_incremental_rehash;
+        using Base::set_rehash_threads;
+        using Base::shrink_to_fit;
+        using Base::size;
+
+        NodeMap() = default;
+
+        explicit NodeMap(Allocator const& alloc)
+            : Base(alloc)
+            , pool_(alloc)
+        {
+        }
+
+        explicit NodeMap(size_type capacity, Allocator const& alloc = Allocator())
+            : Base(capacity, alloc)
+            , pool_(alloc)
+        {
+        }
+
+        /// Copies the elements along with the hasher, equality and rehash settings.
+        NodeMap(NodeMap const& other)
+            : Base(typename Base::CopySettingsTag {}, other)
+            , pool_(this->alloc_)
+        {
+            reserve(other.size());
+            for (PairType const& pair : other)
+            {
+                emplace(pair);
+            }
+        }
+
+        NodeMap(NodeMap&& other) noexcept
+            : Base(other.alloc_)
+            , pool_(other.alloc_)
+        {
+            swap(other);
+        }
+
+        NodeMap& operator=(NodeMap const& other)
+        {
+            if (this != &other)
+            {
+                NodeMap copy(other);
+                swap(copy);
+            }
+            return *this;
+        }
+
+        NodeMap& operator=(NodeMap&& other) noexcept
+        {
+            NodeMap moved(std::move(other));
+            swap(moved);
+            return *this;
+        }
+
+        ~NodeMap() { destroyNodes(); }
+
+        iterator begin() { return iterator {Base::begin()}; }
+        iterator end() { return iterator {Base::end()}; }
+        const_iterator begin() const { return const_iterator {Base::begin()}; }
+        const_iterator end() const { return const_iterator {Base::end()}; }
+        const_iterator cbegin() const { return begin(); }
+        const_iterator cend() const { return end(); }
+
+        iterator find(Key const& key)
+        {
+            size_t idx = Base::find_internal(key);
+            if (idx == this->ctrlLen_)
+                return end();
+            return iterator {Base::iteratorAt(idx)};
+        }
+
+        const_iterator find(Key const& key) const
+        {
+            size_t idx = Base::find_internal(key);
+            if (idx == this->ctrlLen_)
+                return end();
+            return const_iterator {Base::iteratorAt(idx)};
+        }
+
+        bool contains(Key const& key) const { return Base::find_internal(key) != this->ctrlLen_; }
+
+        hasher hash_function() const { return this->hasher_.hasher.hasher; }
+
+        /// Constructs a key-value pair from args if the key is not present.
+        /// When the key can be read from args, it is probed for directly and a node is
+        /// only built on a miss; otherwise the node is built first and released on a hit.
+        template<typename... Args>
+        std::pair<iterator, bool> emplace(Args&&... args)
+        {
+            if constexpr (requires { Operations::extractKey(args...); })
+            {
+                LazyNode node {[&] { return makeNode(std::forward<Args>(args)...); }};
+                auto [idx, success] = Base::emplace_key(Operations::extractKey(args...), node);
+                return {iterator {Base::iteratorAt(idx)}, success};
+            }
+            else
+            {
+                auto [idx, success] = emplaceNode(makeNode(std::forward<Args>(args)...));
+                return {iterator {Base::iteratorAt(idx)}, success};
+            }
+        }
+
+        std::pair<iterator, bool> insert(value_type const& value) { return emplace(value); }
+
+        std::pair<iterator, bool> insert(value_type&& value) { return emplace(std::move(value)); }
+
+        [[nodiscard]]
+        std::expected<std::reference_wrapper<Value>, Error> get(Key const& key)
+        {
+            auto it = find(key);
+            if (it != end())
+            {
+                return std::ref(it->second);
+            }
+            return std::unexpected(Error::NotFound);
+        }
+
+        void erase(const_iterator pos)
+        {
+            PairType* node = *pos.inner;
+            Base::erase_slot(Base::indexOf(pos.inner));
+            destroyNode(node);
+        }
+
+        size_type erase(Key const& key)
+        {
+            auto it = find(key);
+            if (it == end())
+                return 0;
+            erase(it);
+            return 1;
+        }
+
+        /// Destroys all pairs and returns the node pool's memory to the allocator.
+        void clear() noexcept
+        {
+            destroyNodes();
+            Base::clear();
+            pool_.release();
+        }
+
+        void swap(NodeMap& other) noexcept
+        {
+            Base::swap(other);
+            pool_.swap(other.pool_);
+        }
+
+        friend void swap(NodeMap& lhs, NodeMap& rhs) noexcept { lhs.swap(rhs); }
+
+      private:
+        template<typename... Args>
+        PairType* makeNode(Args&&... args)
+        {
+            PairType* node = pool_.allocate();
+            try
+            {
+                std::construct_at(node, std::forward<Args>(args)...);
+            }
+            catch (...)
+            {
+                pool_.deallocate(node);
+                throw;
+            }
+            return node;
+        }
+
+        void destroyNode(PairType* node) noexcept
+        {
+            std::destroy_at(node);
+            pool_.deallocate(node);
+        }
+
+        /// Inserts an already built node, destroying it if its key is present.
+        std::pair<size_t, bool> emplaceNode(PairType* node)
+        {
+            std::pair<size_t, bool> result;
+            try
+            {
+                result = Base::emplace_key(node->first, node);
+            }
+            catch (...)
+            {
+                destroyNode(node);
+                throw;
+            }
+            if (!result.second)
+            {
+                destroyNode(node);
+            }
+            return result;
+        }
+
+        void destroyNodes() noexcept
+        {
+            for (auto it = Base::begin(); it != Base::end(); ++it)
+            {
+                std::destroy_at(*it);
+            }
+        }
+
+        NodePool<PairType, Allocator> pool_;
+    };
+}  // namespace alp
@@ -0,0 +1,666 @@
+module;
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <istream>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+export module alp:perfect;
+
+import :set;
+import :map;
+import :rapid_hash;
+
+namespace alp
+{
+    /// Maps a 64-bit hash onto [0, n) with a multiplication rather than a division. Without
+    /// 128-bit arithmetic, only the upper half of the hash is used, and n must fit 32 bits.
+    constexpr size_t reduceHash(uint64_t hash, size_t n) noexcept
+    {
+#if defined(__SIZEOF_INT128__)
+        return static_cast<size_t>((static_cast<unsigned __int128>(hash) * n) >> 64);
+#else
+        return static_cast<size_t>(((hash >> 32) * static_cast<uint64_t>(n)) >> 32);
+#endif
+    }
+
+    /// Start of a PerfectSet or PerfectMap written by save(), followed by its pilots and then
+    /// its slots. Fields are in the byte order of the machine that wrote them, which the magic
+    /// number also checks.
+    struct PerfectTableHeader
+    {
+        uint64_t magic = 0x01'00'46'48'50'50'4C'41;  // "ALPPHF", version 1
+        uint32_t slotSize = 0;
+        uint32_t slotAlignment = 0;
+        uint64_t hashSeed = 0;    // hashSeedOf the hash function
+        uint64_t buildSeed = 0;   // Seed the builder settled on
+        uint64_t size = 0;
+        uint64_t slotCount = 0;
+        uint64_t bucketCount = 0;
+        uint64_t fillerSlot = 0;
+
+        [[nodiscard]] bool sameType(PerfectTableHeader const& other) const noexcept
+        {
+            return magic == other.magic && slotSize == other.slotSize
+                && slotAlignment == other.slotAlignment && hashSeed == other.hashSeed;
+        }
+    };
+
+    /// Whether every element of source converts to T, so that a perfect table can be built
+    /// from it. Sets, maps and ranges all qualify.
+    template<typename Source, typename T>
+    concept PerfectTableSource = requires(Source const& source) {
+        { *std::begin(source) } -> std::convertible_to<T>;
+        std::end(source);
+    };
+
+    /// Slots and pilots of a PerfectSet or PerfectMap, a PTHash-style perfect hash over a fixed
+    /// set of keys. Every key hashes to a bucket of a few keys, and the builder finds for each
+    /// bucket a pilot that sends all of its keys to free slots. A lookup reads its bucket's
+    /// pilot and then the one slot its key can be in, so it compares a single element.
+    /// Slots no key maps to hold a copy of the element in fillerSlot_: no other key can
+    /// match it, and its own key is never sent there.
+    template<typename T, typename Hash, typename Equal, typename Policy>
+    class PerfectTable
+    {
+      public:
+        /// Whether save() and load() can copy the slots as they are in memory.
+        static constexpr bool serializable =
+            bitwiseSerializable<T> && std::is_default_constructible_v<T>;
+
+        /// Slots for n elements: one spare in a hundred keeps the last pilot searches short.
+        static constexpr size_t slotCountFor(size_t n) noexcept
+        {
+            return n == 0 ? 0 : n + n / 100 + 1;
+        }
+
+        /// Buckets for n elements, about log2(n) / 7 keys each on average as in PTHash.
+        static constexpr size_t bucketCountFor(size_t n) noexcept
+        {
+            return n == 0 ? 0 : std::max<size_t>(1, 7 * n / std::bit_width(n));
+        }
+
+      protected:
+        using Pilot = uint16_t;
+
+        /// Seeds the builder tries before giving up. Each fails with a small probability
+        /// that does not grow with the number of keys.
+        static constexpr uint64_t maxBuildAttempts = 64;
+
+        /// Builds the table over the elements of source. Of elements with equal keys, the
+        /// first is kept. Throws std::invalid_argument if two keys have the same 64-bit hash,
+        /// which no seed tells apart, or if no seed yields a pilot for every bucket.
+        template<typename Source>
+        void build(Source const& source)
+        {
+            std::vector<T> elements;
+            std::vector<uint64_t> hashes;
+            for (auto const& element : source)
+            {
+                elements.emplace_back(element);
+                hashes.push_back(Policy::apply(hasher_(elements.back())));
+            }
+            auto kept = withoutDuplicates(elements, hashes);
+
+            std::vector<size_t> slotOf;
+            for (uint64_t attempt = 0; attempt < maxBuildAttempts; ++attempt)
+            {
+                seed_ = MixHashPolicy::apply(hashSeedOf<Hash>() + attempt);
+                if (placeAll(kept, hashes, slotOf))
+                {
+                    fillSlots(elements, kept, slotOf);
+                    return;
+                }
+            }
+            throw std::invalid_argument("alp: no perfect hash found for these keys");
+        }
+
+        /// Returns the element key would be, or nullptr if there is none. Reads one pilot
+        /// and one slot.
+        template<typename K>
+        [[nodiscard]] T const* find(K const& key) const noexcept
+        {
+            if (slots_.empty())
+            {
+                return nullptr;
+            }
+            T const& slot = slots_[slotOf(Policy::apply(hasher_(key)))];
+            return equal_(key, slot) ? &slot : nullptr;
+        }
+
+        /// Calls fn on every element, in slot order, skipping the filler copies.
+        template<typename F>
+        void forEachElement(F&& fn) const
+        {
+            for (size_t slot = 0; slot < slots_.size(); ++slot)
+            {
+                if (slot == fillerSlot_ || !equal_(slots_[slot], slots_[fillerSlot_]))
+                {
+                    std::invoke(fn, slots_[slot]);
+                }
+            }
+        }
+
+        /// Header describing the table's type and dimensions.
+        [[nodiscard]] PerfectTableHeader header() const noexcept
+        {
+            PerfectTableHeader header;
+            header.slotSize = sizeof(T);
+            header.slotAlignment = alignof(T);
+            header.hashSeed = hashSeedOf<Hash>();
+            header.buildSeed = seed_;
+            header.size = size_;
+            header.slotCount = slots_.size();
+            header.bucketCount = pilots_.size();
+            header.fillerSlot = fillerSlot_;
+            return header;
+        }
+
+        /// Writes the header, the pilots and the slots, verbatim.
+        std::expected<void, Error> saveTo(std::ostream& out) const
+            requires serializable
+        {
+            auto saved = header();
+            out.write(reinterpret_cast<char const*>(&saved), sizeof(saved));
+            out.write(reinterpret_cast<char const*>(pilots_.data()),
+                      static_cast<std::streamsize>(pilots_.size() * sizeof(Pilot)));
+            out.write(reinterpret_cast<char const*>(slots_.data()),
+                      static_cast<std::streamsize>(slots_.size() * sizeof(T)));
+            if (!out)
+            {
+                return std::unexpected(Error::IoFailure);
+            }
+            return {};
+        }
+
+        /// Restores a table written by saveTo into this empty table, without rebuilding it.
+        /// The header must match this table's type, and a sample of the keys must find
+        /// themselves.
+        std::expected<void, Error> loadFrom(std::istream& in)
+            requires serializable
+        {
+            PerfectTableHeader saved;
+            if (!in.read(reinterpret_cast<char*>(&saved), sizeof(saved)))
+            {
+                return std::unexpected(Error::IoFailure);
+            }
+            if (!saved.sameType(header()) || saved.slotCount != slotCountFor(saved.size)
+                || saved.bucketCount != bucketCountFor(saved.size)
+                || (saved.size != 0 && saved.fillerSlot >= saved.slotCount))
+            {
+                return std::unexpected(Error::IncompatibleFormat);
+            }
+
+            std::vector<Pilot> pilots(saved.bucketCount);
+            std::vector<T> slots(saved.slotCount);
+            if (!in.read(reinterpret_cast<char*>(pilots.data()),
+                         static_cast<std::streamsize>(pilots.size() * sizeof(Pilot)))
+                || !in.read(reinterpret_cast<char*>(slots.data()),
+                            static_cast<std::streamsize>(slots.size() * sizeof(T))))
+            {
+                return std::unexpected(Error::IoFailure);
+            }
+            seed_ = saved.buildSeed;
+            size_ = saved.size;
+            fillerSlot_ = saved.fillerSlot;
+            pilots_ = std::move(pilots);
+            slots_ = std::move(slots);
+            if (!loadedSlotsConsistent())
+            {
+                *this = PerfectTable();
+                return std::unexpected(Error::IncompatibleFormat);
+            }
+            return {};
+        }
+
+        size_t size_ = 0;
+        uint64_t seed_ = 0;
+        size_t fillerSlot_ = 0;
+        std::vector<Pilot> pilots_;
+        std::vector<T> slots_;
+        [[no_unique_address]] Hash hasher_;
+        [[no_unique_address]] Equal equal_;
+
+      private:
+        /// The hash that picks a key's bucket, and with a pilot its slot. The key's hash is
+        /// mixed already, so a multiplication is enough to draw new buckets for a new seed.
+        [[nodiscard]] uint64_t seeded(uint64_t hash) const noexcept
+        {
+            return (hash ^ seed_) * 0x9e3779b97f4a7c15ULL;
+        }
+
+        /// Sends 60% of the keys to the first 30% of the buckets, as PTHash does: the builder
+        /// places those large buckets while most slots are free, which leaves mostly single
+        /// keys for the crowded end.
+        [[nodiscard]] static size_t bucketOf(uint64_t seeded, size_t bucketCount) noexcept
+        {
+            constexpr uint64_t denseKeys = 0x9999'9999'9999'9999ULL;  // 60% of the hashes
+            size_t denseBuckets = std::max<size_t>(bucketCount * 3 / 10, 1);
+            uint64_t bits = std::rotl(seeded, 32);
+            return seeded < denseKeys
+                ? reduceHash(bits, denseBuckets)
+                : denseBuckets + reduceHash(bits, bucketCount - denseBuckets);
+        }
+
+        [[nodiscard]] static size_t positionOf(uint64_t seeded,
+                                               Pilot pilot,
+                                               size_t slotCount) noexcept
+        {
+            return reduceHash((seeded ^ (pilot * 0xbf58476d1ce4e5b9ULL)) * 0x94d049bb133111ebULL,
+                              slotCount);
+        }
+
+        [[nodiscard]] size_t slotOf(uint64_t hash) const noexcept
+        {
+            uint64_t key = seeded(hash);
+            return positionOf(key, pilots_[bucketOf(key, pilots_.size())], slots_.size());
+        }
+
+        /// Indices of the elements to keep: all but the later ones of equal keys.
+        std::vector<size_t> withoutDuplicates(std::vector<T> const& elements,
+                                              std::vector<uint64_t> const& hashes) const
+        {
+            // Elements sort by hash, and those with equal hashes in their order in the source
+            std::vector<std::pair<uint64_t, size_t>> byHash(elements.size());
+            for (size_t i = 0; i < elements.size(); ++i)
+            {
+                byHash[i] = {hashes[i], i};
+            }
+            std::ranges::sort(byHash);
+
+            std::vector<size_t> kept;
+            kept.reserve(byHash.size());
+            for (size_t run = 0; run < byHash.size();)
+            {
+                size_t end = run + 1;
+                while (end < byHash.size() && byHash[end].first == byHash[run].first)
+                {
+                    ++end;
+                }
+                for (size_t i = run + 1; i < end; ++i)
+                {
+                    if (!equal_(elements[byHash[i].second], elements[byHash[run].second]))
+                    {
+                        throw std::invalid_argument("alp: keys with equal hashes");
+                    }
+                }
+                kept.push_back(byHash[run].second);
+                run = end;
+            }
+            return kept;
+        }
+
+        /// Finds a pilot for every bucket with the current seed, largest buckets first while
+        /// most slots are still free. Fills slotOf for the kept elements and returns true,
+        /// or returns false if some bucket has no pilot.
+        bool placeAll(std::vector<size_t> const& kept,
+                      std::vector<uint64_t> const& hashes,
+                      std::vector<size_t>& slotOf)
+        {
+            size_t const n = kept.size();
+            size_t const slotCount = slotCountFor(n);
+            size_t const bucketCount = bucketCountFor(n);
+
+            // Elements grouped by bucket, counting sort style
+            std::vector<uint64_t> keys(n);
+            std::vector<size_t> bucketStart(bucketCount + 1, 0);
+            for (size_t i = 0; i < n; ++i)
+            {
+                keys[i] = seeded(hashes[kept[i]]);
+                ++bucketStart[bucketOf(keys[i], bucketCount) + 1];
+            }
+            std::partial_sum(bucketStart.begin(), bucketStart.end(), bucketStart.begin());
+            std::vector<size_t> members(n);
+            auto next = bucketStart;
+            for (size_t i = 0; i < n; ++i)
+            {
+                members[next[bucketOf(keys[i], bucketCount)]++] = i;
+            }
+
+            std::vector<size_t> buckets(bucketCount);
+            std::iota(buckets.begin(), buckets.end(), size_t {0});
+            std::ranges::stable_sort(buckets,
+                                     std::greater {},
+                                     [&](size_t b) { return bucketStart[b + 1] - bucketStart[b]; });
+
+            std::vector<Pilot> pilots(bucketCount, 0);
+            std::vector<uint64_t> taken((slotCount + 63) / 64, 0);
+            std::vector<size_t> positions;
+            slotOf.assign(n, 0);
+            for (size_t bucket : buckets)
+            {
+                auto first = bucketStart[bucket];
+                auto last = bucketStart[bucket + 1];
+                if (first == last)
+                {
+                    break;
+                }
+                bool placed = false;
+                for (uint32_t pilot = 0; pilot <= std::numeric_limits<Pilot>::max() && !placed;
+                     ++pilot)
+                {
+                    positions.clear();
+                    for (size_t m = first; m < last; ++m)
+                    {
+                        size_t position =
+                            positionOf(keys[members[m]], static_cast<Pilot>(pilot), slotCount);
+                        if ((taken[position / 64] >> (position % 64) & 1) != 0
+                            || std::ranges::find(positions, position) != positions.end())
+                        {
+                            break;
+                        }
+                        positions.push_back(position);
+                    }
+                    if (positions.size() == last - first)
+                    {
+                        placed = true;
+                        pilots[bucket] = static_cast<Pilot>(pilot);
+                        for (size_t m = first; m < last; ++m)
+                        {
+                            size_t position = positions[m - first];
+                            taken[position / 64] |= uint64_t {1} << (position % 64);
+                            slotOf[members[m]] = position;
+                        }
+                    }
+                }
+                if (!placed)
+                {
+                    return false;
+                }
+            }
+            pilots_ = std::move(pilots);
+            return true;
+        }
+
+        /// Copies the kept elements into their slots, and one of them into the rest.
+        void fillSlots(std::vector<T> const& elements,
+                       std::vector<size_t> const& kept,
+                       std::vector<size_t> const& slotOf)
+        {
+            size_ = kept.size();
+            std::vector<size_t> elementAt(slotCountFor(size_), kept.empty() ? 0 : kept[0]);
+            for (size_t i = 0; i < kept.size(); ++i)
+            {
+                elementAt[slotOf[i]] = kept[i];
+            }
+            fillerSlot_ = kept.empty() ? 0 : slotOf[0];
+            slots_.clear();
+            slots_.reserve(elementAt.size());
+            for (size_t index : elementAt)
+            {
+                slots_.push_back(elements[index]);
+            }
+        }
+
+        /// Whether keys spread over the slots find themselves, as they do in a table saved
+        /// with the same hash function.
+        [[nodiscard]] bool loadedSlotsConsistent() const noexcept
+        {
+            size_t const samples = std::min<size_t>(slots_.size(), 64);
+            for (size_t i = 0; i < samples; ++i)
+            {
+                T const& slot = slots_[i * slots_.size() / samples];
+                if (find(slot) == nullptr)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    /// Writes a PerfectSet or PerfectMap to the file at path, replacing it.
+    template<typename Table>
+    std::expected<void, Error> savePerfectTable(Table const& table,
+                                                std::filesystem::path const& path)
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            return std::unexpected(Error::IoFailure);
+        }
+        auto saved = table.save(out);
+        out.close();
+        if (saved && !out)
+        {
+            return std::unexpected(Error::IoFailure);
+        }
+        return saved;
+    }
+
+    template<typename Table>
+    std::expected<Table, Error> loadPerfectTable(std::filesystem::path const& path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+        {
+            return std::unexpected(Error::IoFailure);
+        }
+        return Table::load(in);
+    }
+
+    /// An immutable Set of keys fixed up front, such as protocol field names or country codes,
+    /// stored with a perfect hash: every lookup compares one element, without probing. It
+    /// takes about 1% more slots than elements, plus 2 bytes per bucket of a few keys. Build
+    /// it from a Set, any range of elements or a list; save() and load() store it without
+    /// rebuilding.
+    export template<typename T,
+                    typename Hash = RapidHasher,
+                    typename Equal = std::equal_to<T>,
+                    typename Policy = HashPolicySelector<T, Hash>::type>
+    class PerfectSet : PerfectTable<T, Hash, Equal, Policy>
+    {
+        using Base = PerfectTable<T, Hash, Equal, Policy>;
+
+      public:
+        using key_type = T;
+        using value_type = T;
+        using size_type = std::size_t;
+        using hasher = Hash;
+        using key_equal = Equal;
+
+        /// An empty set.
+        PerfectSet() = default;
+
+        /// Builds a set of the elements of source, which may repeat. Throws
+        /// std::invalid_argument if two distinct elements have the same 64-bit hash.
+        template<typename Source>
+            requires PerfectTableSource<Source, T>
+        static PerfectSet build(Source const& source)
+        {
+            PerfectSet set;
+            set.Base::build(source);
+            return set;
+        }
+
+        static PerfectSet build(std::initializer_list<T> elements)
+        {
+            return build<std::initializer_list<T>>(elements);
+        }
+
+        [[nodiscard]] bool contains(T const& key) const { return Base::find(key) != nullptr; }
+
+        [[nodiscard]] size_type count(T const& key) const { return contains(key) ? 1 : 0; }
+
+        [[nodiscard]]
+        std::expected<std::reference_wrapper<T const>, Error> get(T const& key) const
+        {
+            auto const* element = Base::find(key);
+            if (element == nullptr)
+            {
+                return std::unexpected(Error::NotFound);
+            }
+            return std::cref(*element);
+        }
+
+        [[nodiscard]] size_type size() const noexcept { return this->size_; }
+        [[nodiscard]] bool empty() const noexcept { return this->size_ == 0; }
+        [[nodiscard]] size_type capacity() const noexcept { return this->slots_.size(); }
+
+        /// Calls fn on every element, in slot order.
+        template<typename F>
+            requires std::invocable<F&, T const&>
+        void for_each(F&& fn) const
+        {
+            Base::forEachElement(fn);
+        }
+
+        /// Writes the set to out, for load() to restore without rebuilding it.
+        std::expected<void, Error> save(std::ostream& out) const
+            requires Base::serializable
+        {
+            return Base::saveTo(out);
+        }
+
+        std::expected<void, Error> save(std::filesystem::path const& path) const
+            requires Base::serializable
+        {
+            return savePerfectTable(*this, path);
+        }
+
+        /// Restores a set written by save(). Fails with Error::IncompatibleFormat if it was
+        /// written by another PerfectSet type or with another hash function.
+        static std::expected<PerfectSet, Error> load(std::istream& in)
+            requires Base::serializable
+        {
+            PerfectSet set;
+            if (auto loaded = set.loadFrom(in); !loaded)
+            {
+                return std::unexpected(loaded.error());
+            }
+            return set;
+        }
+
+        static std::expected<PerfectSet, Error> load(std::filesystem::path const& path)
+            requires Base::serializable
+        {
+            return loadPerfectTable<PerfectSet>(path);
+        }
+
+        hasher hash_function() const { return this->hasher_; }
+    };
+
+    /// An immutable Map over keys fixed up front, stored with a perfect hash like PerfectSet:
+    /// every lookup compares one element, whose value sits next to its key. Build it from a
+    /// Map or any range of key-value pairs.
+    export template<typename Key,
+                    typename Value,
+                    typename Hash = RapidHasher,
+                    typename Equal = std::equal_to<Key>,
+                    typename Policy = HashPolicySelector<Key, Hash>::type>
+    class PerfectMap
+        : PerfectTable<std::pair<Key const, Value>,
+                       MapHashAdapter<Key, Hash>,
+                       MapEqualAdapter<Key, Equal>,
+                       Policy>
+    {
+        using Base = PerfectTable<std::pair<Key const, Value>,
+                                  MapHashAdapter<Key, Hash>,
+                                  MapEqualAdapter<Key, Equal>,
+                                  Policy>;
+
+      public:
+        using key_type = Key;
+        using mapped_type = Value;
+        using value_type = std::pair<Key const, Value>;
+        using size_type = std::size_t;
+        using hasher = Hash;
+        using key_equal = Equal;
+
+        /// An empty map.
+        PerfectMap() = default;
+
+        /// Builds a map of the key-value pairs of source. Of pairs with equal keys, the first
+        /// is kept. Throws std::invalid_argument if two distinct keys have the same 64-bit
+        /// hash.
+        template<typename Source>
+            requires PerfectTableSource<Source, value_type>
+        static PerfectMap build(Source const& source)
+        {
+            PerfectMap map;
+            map.Base::build(source);
+            return map;
+        }
+
+        static PerfectMap build(std::initializer_list<value_type> elements)
+        {
+            return build<std::initializer_list<value_type>>(elements);
+        }
+
+        [[nodiscard]] bool contains(Key const& key) const { return Base::find(key) != nullptr; }
+
+        [[nodiscard]] size_type count(Key const& key) const { return contains(key) ? 1 : 0; }
+
+        [[nodiscard]]
+        std::expected<std::reference_wrapper<Value const>, Error> get(Key const& key) const
+        {
+            auto const* element = Base::find(key);
+            if (element == nullptr)
+            {
+                return std::unexpected(Error::NotFound);
+            }
+            return std::cref(element->second);
+        }
+
+        [[nodiscard]] size_type size() const noexcept { return this->size_; }
+        [[nodiscard]] bool empty() const noexcept { return this->size_ == 0; }
+        [[nodiscard]] size_type capacity() const noexcept { return this->slots_.size(); }
+
+        /// Calls fn with every key and its value, in slot order.
+        template<typename F>
+            requires std::invocable<F&, Key const&, Value const&>
+        void for_each(F&& fn) const
+        {
+            Base::forEachElement([&](value_type const& element)
+                                 { std::invoke(fn, element.first, element.second); });
+        }
+
+        /// Writes the map to out, for load() to restore without rebuilding it.
+        std::expected<void, Error> save(std::ostream& out) const
+            requires Base::serializable
+        {
+            return Base::saveTo(out);
+        }
+
+        std::expected<void, Error> save(std::filesystem::path const& path) const
+            requires Base::serializable
+        {
+            return savePerfectTable(*this, path);
+        }
+
+        /// Restores a map written by save(). Fails with Error::IncompatibleFormat if it was
+        /// written by another PerfectMap type or with another hash function.
+        static std::expected<PerfectMap, Error> load(std::istream& in)
+            requires Base::serializable
+        {
+            PerfectMap map;
+            if (auto loaded = map.loadFrom(in); !loaded)
+            {
+                return std::unexpected(loaded.error());
+            }
+            return map;
+        }
+
+        static std::expected<PerfectMap, Error> load(std::filesystem::path const& path)
+            requires Base::serializable
+        {
+            return loadPerfectTable<PerfectMap>(path);
+        }
+
+        hasher hash_function() const { return this->hasher_.hasher; }
+    };
+}  // namespace alp
@@ -1,15 +1,26 @@
 module;
 
+#include <algorithm>
 #include <bit>
 #include <cassert>
 #include <cmath>
 #include <cstdint>
 #include <cstring>
+#include <exception>
 #include <expected>
+#include <filesystem>
+#include <fstream>
 #include <functional>
+#include <istream>
+#include <limits>
 #include <memory>
 #include <optional>
+#include <ostream>
+#include <ranges>
 #include <ratio>
+#include <span>
+#include <system_error>
+#include <thread>
 #include <tuple>
 #include <utility>
 #include <vector>
@@ -40,6 +51,7 @@ namespace alp
         { B::match(B::load(ptr), val) } -> std::same_as<typename B::Mask>;
         { B::matchEmpty(B::load(ptr)) } -> std::same_as<typename B::Mask>;
         { B::matchFull(B::load(ptr)) } -> std::same_as<typename B::Mask>;
+        { B::matchEmptyOrDeleted(B::load(ptr)) } -> std::same_as<typename B::Mask>;
 
         // Mask query operations
         { B::any(typename B::Mask {}) } -> std::convertible_to<bool>;
@@ -58,15 +70,32 @@ namespace alp
 
     using ctrl_t = uint8_t;
 
+    /// Hints the CPU to start loading the cache line at ptr.
+    inline void prefetch(void const* ptr) noexcept
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(ptr);
+#else
+        (void)ptr;
+#endif
+    }
+
     export enum class Error : uint8_t
     {
         NotFound,
+        /// Reading or writing a stream or file failed.
+        IoFailure,
+        /// Serialized data is malformed or was written by a table of another type.
+        IncompatibleFormat,
     };
 
     enum class Ctrl : ctrl_t
     {
         Empty = 0b10000000,
         Deleted = 0b11111110,
+        // Marks the last slot of a buffer being drained by an incremental rehash, whose last
+        // group records where the live buffer starts. Neither full nor empty, like Deleted.
+        Handoff = 0b11111101,
         // The sentinel value indicates that we have reached the end of the array.
         // It is located at the last byte of the control array.
         Sentinel = 0b11111111,
@@ -78,6 +107,12 @@ namespace alp
     struct NoStoreHashTag
     {
     };
+    /// Stores bits 7 to 38 of each hash in a 32-bit array after the slots. Together with
+    /// the control byte, that places elements without rehashing them in tables of up to
+    /// 2^32 groups, for half the memory of StoreHashTag and no padding inside the slots.
+    struct CompactHashTag
+    {
+    };
 
     export template<typename T>
     struct HashStorageSelector
@@ -124,6 +159,123 @@ namespace alp
 
     export using DefaultProber = QuadraticProbing;
 
+    /// Shrink policy that never releases memory on erase (the default).
+    /// Capacity only goes down through an explicit shrink_to_fit() or clear().
+    export struct NoShrinkPolicy
+    {
+        static constexpr bool shouldShrink(size_t /*size*/, size_t /*capacity*/) noexcept
+        {
+            return false;
+        }
+    };
+
+    /// Shrink policy that rebuilds the table once its size falls below Ratio of its capacity.
+    /// Erase only notes that the table has become too sparse, so it never invalidates other
+    /// iterators; the next insertion of a new key then resizes the table to fit its elements
+    /// and that key, the same way shrink_to_fit() does.
+    export template<typename Ratio = std::ratio<1, 4>>
+    struct ShrinkBelowRatio
+    {
+        static constexpr bool shouldShrink(size_t size, size_t capacity) noexcept
+        {
+            return size * Ratio::den < capacity * Ratio::num;
+        }
+    };
+
+    export template<typename S>
+    concept ShrinkPolicy = requires(size_t size, size_t capacity) {
+        { S::shouldShrink(size, capacity) } -> std::convertible_to<bool>;
+    };
+
+    export using DefaultShrinkPolicy = NoShrinkPolicy;
+
+    /// Whether values of T can be written to a file and read back as raw bytes. Pairs
+    /// qualify when their members do, even though std::pair itself is not trivially
+    /// copyable.
+    template<typename T>
+    inline constexpr bool bitwiseSerializable = std::is_trivially_copyable_v<T>;
+
+    template<typename A, typename B>
+    inline constexpr bool bitwiseSerializable<std::pair<A, B>> =
+        std::is_trivially_copyable_v<A> && std::is_trivially_copyable_v<B>;
+
+    /// Seed of a hasher that exposes one, recorded by serialized tables so that loading
+    /// them with a differently seeded hasher is caught. 0 for other hashers.
+    template<typename Hash>
+    constexpr uint64_t hashSeedOf() noexcept
+    {
+        if constexpr (requires { Hash::SEED; })
+        {
+            return Hash::SEED;
+        }
+        else
+        {
+            return 0;
+        }
+    }
+
+    /// Start of a table serialized by Set::save or Map::save, followed by the table's buffer.
+    /// Fields are in the byte order of the machine that wrote them, which the magic number
+    /// also checks.
+    struct SerializedTableHeader
+    {
+        /// "ALPTBL" and format version 2.
+        static constexpr uint64_t currentMagic = 0x02'00'4C'42'54'50'4C'41;
+        /// Bits of layoutFlags.
+        static constexpr uint32_t blockedFlag = 1;
+        static constexpr uint32_t storesHashFlag = 2;
+        static constexpr uint32_t compactHashFlag = 4;
+
+        uint64_t magic = currentMagic;
+        uint32_t groupSize = 0;
+        uint32_t layoutFlags = 0;
+        uint32_t slotSize = 0;
+        uint32_t slotAlignment = 0;
+        uint32_t mappedSize = 0;
+        uint32_t bufferAlignment = 0;
+        uint64_t loadFactorNum = 0;
+        uint64_t loadFactorDen = 0;
+        uint64_t hashSeed = 0;
+        uint64_t capacity = 0;
+        uint64_t ctrlLen = 0;
+        uint64_t groups = 0;
+        uint64_t size = 0;
+        uint64_t used = 0;
+        uint64_t bufferSize = 0;
+        /// Pads the header so that a buffer following it at the start of a file is aligned
+        /// for mapping the file.
+        uint64_t reserved[3] = {};
+
+        /// Whether both headers describe tables of the same type, whatever their contents.
+        [[nodiscard]] bool sameType(SerializedTableHeader const& other) const noexcept
+        {
+            return magic == other.magic && groupSize == other.groupSize
+                && layoutFlags == other.layoutFlags && slotSize == other.slotSize
+                && slotAlignment == other.slotAlignment && mappedSize == other.mappedSize
+                && bufferAlignment == other.bufferAlignment
+                && loadFactorNum == other.loadFactorNum && loadFactorDen == other.loadFactorDen
+                && hashSeed == other.hashSeed;
+        }
+
+        /// Whether the dimensions agree with each other and with expectedBufferSize, the
+        /// buffer size the table's layout computes for them. Rejects sizes that overflow,
+        /// and full or deleted slots beyond the load factor: lookups only stop at an empty
+        /// slot, so a table without one would make them probe forever.
+        [[nodiscard]] bool consistentShape(size_t laneCount,
+                                           size_t expectedBufferSize) const noexcept
+        {
+            return std::has_single_bit(groups) && groups <= bufferSize / laneCount
+                && ctrlLen == groups * laneCount && capacity < ctrlLen
+                && capacity <= bufferSize / slotSize && size <= used && used < capacity
+                && loadFactorDen != 0
+                && capacity <= std::numeric_limits<uint64_t>::max()
+                        / std::max(loadFactorNum, loadFactorDen)
+                && used * loadFactorDen <= capacity * loadFactorNum
+                && bufferSize == expectedBufferSize;
+        }
+    };
+    static_assert(sizeof(SerializedTableHeader) == 128);
+
     /// A slot stores an element of type T using aligned raw storage.
     /// This allows us to manually control construction and destruction.
     /// Primary template: stores the full hash to avoid recomputation during rehash.
@@ -148,6 +300,16 @@ namespace alp
         T const* element() const { return reinterpret_cast<T const*>(storage); }
     };
 
+    /// Specialization: hash fragments are kept in a separate array (see CompactHashTag)
+    template<typename T>
+    struct Slot<T, CompactHashTag>
+    {
+        alignas(T) uint8_t storage[sizeof(T)];
+
+        T* element() { return reinterpret_cast<T*>(storage); }
+        T const* element() const { return reinterpret_cast<T const*>(storage); }
+    };
+
     /// A byte wrapper that carries alignment in the type system.
     /// Allocators respecting alignof(value_type) will automatically align.
     template<size_t Alignment>
@@ -224,30 +386,262 @@ namespace alp
         bool operator==(AlignedAllocatorAdapter const& other) const = default;
     };
 
+    /// The allocator a table allocates its buffer with: Alloc itself if it declares a static
+    /// alignment of at least Alignment for every allocation, otherwise an adapter that
+    /// over-allocates to align.
+    template<typename Alloc, size_t Alignment>
+    struct AlignedByteAllocatorSelector
+    {
+        using type = AlignedAllocatorAdapter<
+            typename std::allocator_traits<Alloc>::template rebind_alloc<AlignedByte<Alignment>>,
+            Alignment>;
+    };
+
+    template<typename Alloc, size_t Alignment>
+        requires(Alloc::alignment >= Alignment)
+    struct AlignedByteAllocatorSelector<Alloc, Alignment>
+    {
+        using type = typename std::allocator_traits<Alloc>::template rebind_alloc<std::byte>;
+    };
+
+    /// Control byte layout policy keeping all control bytes in one array in front of the slots.
+    struct ContiguousCtrlTag
+    {
+    };
+
+    /// Control byte layout policy placing each group's control bytes directly in front of that
+    /// group's slots, so a probe usually touches one or two adjacent cache lines and a single
+    /// page. Not available with CompactHashTag or with mapped values.
+    struct BlockedCtrlTag
+    {
+    };
+
     /// Helper for computing co-located memory layout.
-    /// Memory layout: [ctrl bytes][padding][slots...]
-    template<typename T, size_t GroupSize, typename HashStoragePolicy = StoreHashTag>
+    /// Memory layout: [ctrl bytes][padding][slots...][padding][hash fragments...]
+    ///                [padding][mapped values...]
+    /// Hash fragments are only present with CompactHashTag, and mapped values only when
+    /// Mapped is not void, i.e. for maps that keep their values apart from their keys.
+    /// With BlockedCtrlTag, the buffer is instead a sequence of blocks, one per group:
+    ///                [GroupSize ctrl bytes][padding][GroupSize slots][padding]
+    /// Elements are addressed by index through ctrlAt and slotAt in both cases.
+    template<typename T,
+             size_t GroupSize,
+             typename HashStoragePolicy = StoreHashTag,
+             typename Mapped = void,
+             typename CtrlLayout = ContiguousCtrlTag>
     struct TableLayout
     {
+        using SlotType = Slot<T, HashStoragePolicy>;
         static constexpr size_t ctrlAlignment = GroupSize;
-        static constexpr size_t slotAlignment = alignof(Slot<T, HashStoragePolicy>);
+        static constexpr size_t slotAlignment = alignof(SlotType);
+        static constexpr bool hasFragments = std::is_same_v<HashStoragePolicy, CompactHashTag>;
+        static constexpr bool hasMapped = !std::is_void_v<Mapped>;
+        static constexpr bool blocked = std::is_same_v<CtrlLayout, BlockedCtrlTag>;
+        static_assert(!blocked || (!hasFragments && !hasMapped),
+                      "BlockedCtrlTag cannot be combined with CompactHashTag or mapped values");
+
+        /// With BlockedCtrlTag, offset from the start of a block to its first slot.
+        static constexpr size_t blockSlotsOffset =
+            (GroupSize + slotAlignment - 1) & ~(slotAlignment - 1);
+        /// With BlockedCtrlTag, distance between the starts of consecutive blocks. Blocks stay
+        /// aligned to GroupSize so that their control bytes can be loaded as one group.
+        static constexpr size_t blockSize =
+            (blockSlotsOffset + GroupSize * sizeof(SlotType) + std::max(GroupSize, slotAlignment)
+             - 1)
+            & ~(std::max(GroupSize, slotAlignment) - 1);
+        /// Bytes an iterator skips when it moves past the last control byte of a group
+        /// (ctrlGap) or the last slot of a group (slotGap): zero for contiguous control bytes.
+        static constexpr size_t ctrlGap = blocked ? blockSize - GroupSize : 0;
+        static constexpr size_t slotGap = blocked ? blockSize - GroupSize * sizeof(SlotType) : 0;
 
         /// Computes the offset from buffer start to the slots array.
         static constexpr size_t slotsOffset(size_t ctrlLen)
         {
+            if constexpr (blocked)
+            {
+                return blockSlotsOffset;
+            }
             size_t ctrlSize = ctrlLen * sizeof(ctrl_t);
             // Round up to slot alignment
             return (ctrlSize + slotAlignment - 1) & ~(slotAlignment - 1);
         }
 
+        /// Returns the control byte of element idx, given the buffer's first control byte.
+        template<typename C>
+        static C* ctrlAt(C* ctrl, size_t idx) noexcept
+        {
+            if constexpr (blocked)
+            {
+                return ctrl + (idx / GroupSize) * blockSize + idx % GroupSize;
+            }
+            return ctrl + idx;
+        }
+
+        /// Returns the slot of element idx, given the buffer's first slot.
+        template<typename S>
+        static S* slotAt(S* slots, size_t idx) noexcept
+        {
+            if constexpr (blocked)
+            {
+                using Byte = std::conditional_t<std::is_const_v<S>, std::byte const, std::byte>;
+                auto* block = reinterpret_cast<Byte*>(slots) + (idx / GroupSize) * blockSize;
+                return reinterpret_cast<S*>(block) + idx % GroupSize;
+            }
+            return slots + idx;
+        }
+
+        /// Inverse of ctrlAt.
+        static size_t indexOf(ctrl_t const* ctrl, ctrl_t const* pos) noexcept
+        {
+            auto offset = static_cast<size_t>(pos - ctrl);
+            if constexpr (blocked)
+            {
+                return (offset / blockSize) * GroupSize + offset % blockSize;
+            }
+            return offset;
+        }
+
+        /// Bytes taken in the slots of the last group of a retired buffer by the position of
+        /// the live buffer: its first control byte and the base-2 logarithm of its length.
+        static constexpr size_t handoffSize = sizeof(ctrl_t*) + 1;
+        static_assert((GroupSize - 1) * sizeof(SlotType) >= handoffSize);
+
+        /// Records the live buffer in the last group of a retired buffer, whose elements must
+        /// already have been moved out, and marks that group with Ctrl::Handoff.
+        static void writeHandoff(ctrl_t* ctrl,
+                                 SlotType* slots,
+                                 size_t capacity,
+                                 ctrl_t* liveCtrl,
+                                 size_t liveCtrlLen) noexcept
+        {
+            auto* bytes = reinterpret_cast<std::byte*>(slotAt(slots, capacity + 1 - GroupSize));
+            std::memcpy(bytes, &liveCtrl, sizeof(liveCtrl));
+            bytes[sizeof(liveCtrl)] = static_cast<std::byte>(std::countr_zero(liveCtrlLen));
+            *ctrlAt(ctrl, capacity - 1) = static_cast<ctrl_t>(Ctrl::Handoff);
+        }
+
+        /// Returns the live buffer recorded by writeHandoff, given the first control byte and
+        /// slot of the last group of a buffer, or null pointers if the buffer is not retired.
+        static std::pair<ctrl_t const*, SlotType*> readHandoff(ctrl_t const* groupCtrl,
+                                                               SlotType* groupSlots) noexcept
+        {
+            if (groupCtrl[GroupSize - 2] != static_cast<ctrl_t>(Ctrl::Handoff))
+            {
+                return {nullptr, nullptr};
+            }
+            auto const* bytes = reinterpret_cast<std::byte const*>(groupSlots);
+            ctrl_t* liveCtrl;
+            std::memcpy(&liveCtrl, bytes, sizeof(liveCtrl));
+            size_t liveCtrlLen = size_t {1} << static_cast<unsigned>(bytes[sizeof(liveCtrl)]);
+            auto* liveSlots = reinterpret_cast<std::byte*>(liveCtrl) + slotsOffset(liveCtrlLen);
+            return {liveCtrl, reinterpret_cast<SlotType*>(liveSlots)};
+        }
+
+        /// Marks the first capacity control bytes as empty and the rest up to ctrlLen as
+        /// sentinels.
+        static void initCtrl(ctrl_t* ctrl, size_t capacity, size_t ctrlLen) noexcept
+        {
+            if constexpr (blocked)
+            {
+                for (size_t group = 0; group < ctrlLen / GroupSize; ++group)
+                {
+                    std::memset(
+                        ctrl + group * blockSize, static_cast<ctrl_t>(Ctrl::Empty), GroupSize);
+                }
+            }
+            else
+            {
+                std::memset(ctrl, static_cast<ctrl_t>(Ctrl::Empty), capacity);
+            }
+            std::memset(
+                ctrlAt(ctrl, capacity), static_cast<ctrl_t>(Ctrl::Sentinel), ctrlLen - capacity);
+        }
+
         /// Computes total buffer size for given control length and capacity.
         static constexpr size_t bufferSize(size_t ctrlLen, size_t capacity)
         {
-            return slotsOffset(ctrlLen) + capacity * sizeof(Slot<T, HashStoragePolicy>);
+            if constexpr (blocked)
+            {
+                return ctrlLen / GroupSize * blockSize;
+            }
+            size_t slotsEnd = slotsOffset(ctrlLen) + capacity * sizeof(Slot<T, HashStoragePolicy>);
+            size_t end = fragmentsEnd(slotsEnd, capacity);
+            if constexpr (hasMapped)
+            {
+                end = alignUp(end, alignof(Mapped)) + capacity * sizeof(Mapped);
+            }
+            return end;
+        }
+
+        /// Returns the hash fragments of the buffer holding capacity slots at slots.
+        static uint32_t* fragments(Slot<T, HashStoragePolicy> const* slots, size_t capacity)
+        {
+            auto slotsEnd = reinterpret_cast<uintptr_t>(slots + capacity);
+            return reinterpret_cast<uint32_t*>(alignUp(slotsEnd, alignof(uint32_t)));
+        }
+
+        /// Returns the mapped values of the buffer holding capacity slots at slots.
+        static auto* mapped(Slot<T, HashStoragePolicy> const* slots, size_t capacity)
+            requires hasMapped
+        {
+            auto slotsEnd = reinterpret_cast<uintptr_t>(slots + capacity);
+            auto offset = alignUp(fragmentsEnd(slotsEnd, capacity), alignof(Mapped));
+            return reinterpret_cast<Mapped*>(offset);
         }
 
         /// Maximum alignment requirement for the buffer.
-        static constexpr size_t bufferAlignment() { return std::max(ctrlAlignment, slotAlignment); }
+        static constexpr size_t bufferAlignment()
+        {
+            size_t alignment = std::max(ctrlAlignment, slotAlignment);
+            if constexpr (hasMapped)
+            {
+                alignment = std::max(alignment, alignof(Mapped));
+            }
+            return alignment;
+        }
+
+      private:
+        static constexpr size_t alignUp(size_t offset, size_t alignment)
+        {
+            return (offset + alignment - 1) & ~(alignment - 1);
+        }
+
+        static constexpr size_t fragmentsEnd(size_t slotsEnd, size_t capacity)
+        {
+            if constexpr (hasFragments)
+            {
+                return alignUp(slotsEnd, alignof(uint32_t)) + capacity * sizeof(uint32_t);
+            }
+            return slotsEnd;
+        }
+    };
+
+    /// Number of elements a table keeps inside the table object itself, so that tables
+    /// that never grow past it never allocate. Capped at one group minus the sentinel.
+    /// The default of 0 keeps every table object small; specialize to opt in for element
+    /// types that move without throwing, e.g. with 128 / sizeof(T) for elements of up to
+    /// 16 bytes, which holds at least 7 of them within the load factor.
+    /// Moving or swapping a table whose elements are inline moves the elements themselves,
+    /// so references and iterators to them do not carry over to the other table.
+    export template<typename T>
+    struct InlineCapacitySelector
+    {
+        static constexpr size_t value = 0;
+    };
+
+    /// One group of control bytes and Capacity slots, stored inside a table object.
+    /// Control bytes past Capacity are sentinels, so probing and iteration never reach
+    /// the slots that are not there.
+    template<typename SlotType, size_t GroupSize, size_t Capacity>
+    struct InlineBuffer
+    {
+        alignas(GroupSize) ctrl_t ctrl[GroupSize];
+        alignas(SlotType) std::byte slots[Capacity * sizeof(SlotType)];
+    };
+
+    template<typename SlotType, size_t GroupSize>
+    struct InlineBuffer<SlotType, GroupSize, 0>
+    {
     };
 
     /// A group of control bytes, the fundamental unit of Swiss Table probing.
@@ -279,6 +673,10 @@ namespace alp
 
         Mask matchEmpty() const noexcept { return Backend::matchEmpty(data); }
 
+        /// Returns a mask of all slots in the group that can accept a new element.
+        /// (Empty or deleted, but never the sentinel)
+        Mask matchEmptyOrDeleted() const noexcept { return Backend::matchEmptyOrDeleted(data); }
+
         /// Returns true if and only if there exists a slot in the group that has Ctrl::Empty.
         bool anyEmpty() const noexcept { return Backend::any(matchEmpty()); }
 
@@ -295,6 +693,11 @@ namespace alp
     // Export hash storage policy tags
     export using StoreHashTag = StoreHashTag;
     export using NoStoreHashTag = NoStoreHashTag;
+    export using CompactHashTag = CompactHashTag;
+
+    // Export control byte layout policy tags
+    export using ContiguousCtrlTag = ContiguousCtrlTag;
+    export using BlockedCtrlTag = BlockedCtrlTag;
 
     /// Forward declaration of the Table base class.
     export template<typename T,
@@ -305,17 +708,25 @@ namespace alp
                     typename Allocator,
                     typename LoadFactorRatio,
                     typename HashStoragePolicy,
-                    typename Prober>
+                    typename Prober,
+                    typename Shrink,
+                    typename Mapped,
+                    typename CtrlLayout>
     class Table;
 
     /// Iterator for traversing elements in a Swiss Table.
     /// Uses the control byte array to efficiently skip empty/deleted slots.
-    export template<typename T, SimdBackend Backend, typename HashStoragePolicy = StoreHashTag>
+    export template<typename T,
+                    SimdBackend Backend,
+                    typename HashStoragePolicy = StoreHashTag,
+                    typename CtrlLayout = ContiguousCtrlTag>
     struct SetIterator
     {
         static constexpr size_t LANE_COUNT = Backend::GroupSize;
+        using Layout =
+            TableLayout<std::remove_const_t<T>, LANE_COUNT, HashStoragePolicy, void, CtrlLayout>;
 
-        template<typename U, SimdBackend B, typename HSP>
+        template<typename U, SimdBackend B, typename HSP, typename CL>
         friend struct SetIterator;
 
         /// Pointer to the current control byte.
@@ -330,7 +741,10 @@ namespace alp
         }
 
         // Converting constructor: allows iterator to convert to const_iterator
-        SetIterator(SetIterator<std::remove_const_t<T>, Backend, HashStoragePolicy> const& other)
+        SetIterator(SetIterator<std::remove_const_t<T>,
+                                Backend,
+                                HashStoragePolicy,
+                                CtrlLayout> const& other)
             requires std::is_const_v<T> && (!std::is_same_v<T, std::remove_const_t<T>>)
             : ctrl(other.ctrl)
             , slot(reinterpret_cast<Slot<std::remove_const_t<T>, HashStoragePolicy>*>(other.slot))
@@ -342,8 +756,8 @@ namespace alp
 
         // Update comparison to work across iterator/const_iterator
         template<typename U>
-        friend bool operator==(SetIterator<T, Backend, HashStoragePolicy> const& lhs,
-                               SetIterator<U, Backend, HashStoragePolicy> const& rhs)
+        friend bool operator==(SetIterator<T, Backend, HashStoragePolicy, CtrlLayout> const& lhs,
+                               SetIterator<U, Backend, HashStoragePolicy, CtrlLayout> const& rhs)
         {
             return lhs.ctrl == rhs.ctrl;
         }
@@ -355,6 +769,10 @@ namespace alp
         {
             ++ctrl;
             ++slot;
+            if (Layout::blocked && groupOffset() == 0)
+            {
+                skipGap();
+            }
 
             if (isFull(*ctrl))
             {
@@ -408,9 +826,10 @@ namespace alp
             int jumpToNext = LANE_COUNT - offset;
             ctrl += jumpToNext;
             slot += jumpToNext;
+            skipGap();
             if (g.atEnd()) [[unlikely]]
             {
-                return *this;
+                return continueInNext();
             }
             return skipEmptySlotsAligned();
         }
@@ -432,13 +851,44 @@ namespace alp
 
                 ctrl += LANE_COUNT;
                 slot += LANE_COUNT;
+                skipGap();
                 if (g.atEnd()) [[unlikely]]
                 {
-                    return *this;
+                    return continueInNext();
                 }
             }
         }
 
+        /// Moves from the end of one group to the start of the next with BlockedCtrlTag,
+        /// stepping over the slots or control bytes of the block in between.
+        void skipGap() noexcept
+        {
+            if constexpr (Layout::blocked)
+            {
+                ctrl += Layout::ctrlGap;
+                slot = reinterpret_cast<decltype(slot)>(reinterpret_cast<std::byte*>(slot)
+                                                        + Layout::slotGap);
+            }
+        }
+
+        /// Called past the end of a buffer: moves on to the live buffer if this iterator
+        /// was in one that an incremental rehash is draining, otherwise stays at end().
+        /// The drained buffer records the live one in its last group.
+        SetIterator& continueInNext() noexcept
+        {
+            auto* lastSlots = reinterpret_cast<std::byte*>(slot) - Layout::slotGap
+                - LANE_COUNT * sizeof(*slot);
+            auto [liveCtrl, liveSlots] = Layout::readHandoff(
+                ctrl - Layout::ctrlGap - LANE_COUNT, reinterpret_cast<decltype(slot)>(lastSlots));
+            if (liveCtrl == nullptr)
+            {
+                return *this;
+            }
+            ctrl = liveCtrl;
+            slot = liveSlots;
+            return skipEmptySlotsAligned();
+        }
+
         template<typename U,
                  typename Hash,
                  typename Equal,
@@ -447,7 +897,10 @@ namespace alp
                  typename Allocator,
                  typename LoadFactorRatio,
                  typename H,
-                 typename Prober>
+                 typename Prober,
+                 typename Shrink,
+                 typename Mapped,
+                 typename CL>
         friend class Table;
     };
 
@@ -509,26 +962,59 @@ namespace alp
              typename Allocator = std::allocator<std::byte>,
              typename LoadFactorRatio = DefaultLoadFactorSelector<Backend>::type,
              typename HashStoragePolicy = HashStorageSelector<T>::type,
-             typename Prober = DefaultProber>
+             typename Prober = DefaultProber,
+             typename Shrink = DefaultShrinkPolicy,
+             typename Mapped = void,
+             typename CtrlLayout = ContiguousCtrlTag>
     class Table
     {
       protected:
         static constexpr size_t LANE_COUNT = Backend::GroupSize;
         static constexpr double loadFactor =
             static_cast<double>(LoadFactorRatio::num) / static_cast<double>(LoadFactorRatio::den);
+        /// Number of keys hashed and prefetched together by find_many_internal.
+        static constexpr size_t findBatchSize = 16;
+        /// Number of elements hashed and prefetched together by insert_range_internal.
+        static constexpr size_t insertBatchSize = 64;
+        /// Smallest table, in elements, that is rehashed on several threads when enabled.
+        /// Below this, starting threads costs more than the rehash itself.
+        static constexpr size_t parallelRehashMinSize = size_t {1} << 16;
+        /// Whether each element has a value of type Mapped, kept in an array of its own
+        /// parallel to the slots rather than inside them.
+        static constexpr bool hasMapped = !std::is_void_v<Mapped>;
+        /// Whether placing an element during a rehash cannot throw: moving it, and hashing it
+        /// unless its hash is kept in the table. Required wherever an exception could not be
+        /// recovered from: on worker threads, where it would terminate the program, and when
+        /// purging tombstones in place, where it would leave elements marked as deleted.
+        static constexpr bool rehashNothrow =
+            std::is_nothrow_move_constructible_v<T>
+            && std::is_nothrow_move_constructible_v<std::conditional_t<hasMapped, Mapped, T>>
+            && (!std::is_same_v<HashStoragePolicy, NoStoreHashTag>
+                || std::is_nothrow_invocable_v<Hash const&, T const&>);
+        /// Number of elements stored inside the table object before the first allocation.
+        /// Not used with CompactHashTag, whose fragments only pay off for larger elements,
+        /// nor with mapped values, which live apart from the slots.
+        static constexpr size_t inlineCapacity =
+            std::is_same_v<HashStoragePolicy, CompactHashTag> || hasMapped
+            ? 0
+            : std::min<size_t>(InlineCapacitySelector<T>::value, LANE_COUNT - 1);
+        static_assert(inlineCapacity == 0 || std::is_nothrow_move_constructible_v<T>,
+                      "Inline elements are moved by swap, which must not throw");
+        /// Share of the load factor limit that tombstones must occupy before an insertion
+        /// purges them in place instead of growing the table.
+        static constexpr double tombstonePurgeFraction = 0.125;
 
         using value_type = T;
         using size_type = std::size_t;
         using difference_type = std::ptrdiff_t;
-        using iterator = SetIterator<T, Backend, HashStoragePolicy>;
-        using const_iterator = SetIterator<T const, Backend, HashStoragePolicy>;
+        using iterator = SetIterator<T, Backend, HashStoragePolicy, CtrlLayout>;
+        using const_iterator = SetIterator<T const, Backend, HashStoragePolicy, CtrlLayout>;
 
         using allocator_type = Allocator;
         using AllocTraits = std::allocator_traits<Allocator>;
-        using AlignedByteType = AlignedByte<LANE_COUNT>;
-        using InnerAlloc = typename AllocTraits::template rebind_alloc<AlignedByteType>;
-        using ByteAlloc = AlignedAllocatorAdapter<InnerAlloc, LANE_COUNT>;
+        using ByteAlloc = AlignedByteAllocatorSelector<Allocator, LANE_COUNT>::type;
         using ByteAllocTraits = std::allocator_traits<ByteAlloc>;
+        using InlineStorage = InlineBuffer<Slot<T, HashStoragePolicy>, LANE_COUNT, inlineCapacity>;
 
         Table()
             : alloc_()
@@ -557,11 +1043,15 @@ namespace alp
 
         Table(Table const& other)
             requires std::copy_constructible<T>
+            && (!hasMapped || std::copy_constructible<std::conditional_t<hasMapped, Mapped, T>>)
             : size_(other.size_)
             , used_(other.used_)
             , capacity_(other.capacity_)
             , ctrlLen_(other.ctrlLen_)
             , groups_(other.groups_)
+            , rehashThreads_(other.rehashThreads_)
+            , shrinkPending_(other.shrinkPending_)
+            , migrateGroups_(other.migrateGroups_)
             , alloc_(AllocTraits::select_on_container_copy_construction(other.alloc_))
             , byte_alloc_(alloc_)
             , hasher_(other.hasher_)
@@ -572,35 +1062,77 @@ namespace alp
                 return;
             }
 
-            // Allocate co-located buffer
-            buffer_ = allocateBuffer(ctrlLen_, capacity_);
-            ctrl_ = reinterpret_cast<ctrl_t*>(buffer_);
-            slots_ = reinterpret_cast<Slot<T, HashStoragePolicy>*>(buffer_
-                                                                   + Layout::slotsOffset(ctrlLen_));
+            if (other.isInline())
+            {
+                pointAtInline();
+            }
+            else
+            {
+                // Allocate co-located buffer
+                buffer_ = allocateBuffer(ctrlLen_, capacity_);
+                ctrl_ = reinterpret_cast<ctrl_t*>(buffer_);
+                slots_ = reinterpret_cast<Slot<T, HashStoragePolicy>*>(
+                    buffer_ + Layout::slotsOffset(ctrlLen_));
+            }
 
-            std::memset(ctrl_, static_cast<ctrl_t>(Ctrl::Empty), ctrlLen_ * sizeof(ctrl_t));
+            // Tombstones are kept, since probe sequences may run past them.
+            // Full slots are marked once their element has been copied.
+            constexpr auto deleted = static_cast<ctrl_t>(Ctrl::Deleted);
+            Layout::initCtrl(ctrl_, capacity_, ctrlLen_);
+            for (size_t i = 0; i < capacity_; ++i)
+            {
+                if (*Layout::ctrlAt(other.ctrl_, i) == deleted)
+                {
+                    *Layout::ctrlAt(ctrl_, i) = deleted;
+                }
+            }
 
             if (capacity_ > 0)
             {
                 try
                 {
-                    for (auto it = other.begin(); it != other.end(); ++it)
+                    for (size_t gIdx = 0; gIdx < groups_; ++gIdx)
                     {
-                        size_t offset = it.ctrl - other.ctrl_;
-                        AllocTraits::construct(alloc_, slots_[offset].element(), *it);
+                        Group<Backend> g {Layout::ctrlAt(other.ctrl_, gIdx * LANE_COUNT)};
+                        for (int i : Backend::iterate(g.matchFull()))
+                        {
+                            size_t offset = gIdx * LANE_COUNT + i;
+                            copyElement(offset, other.slots_, other.capacity_, offset);
+                            setSlotHash(slots_,
+                                        capacity_,
+                                        offset,
+                                        other.getSlotHash(
+                                            other.ctrl_, other.slots_, other.capacity_, offset));
+                            *Layout::ctrlAt(ctrl_, offset) = *Layout::ctrlAt(other.ctrl_, offset);
+                        }
+                    }
 
-                        ctrl_[offset] = other.ctrl_[offset];
+                    // Elements other has not migrated yet go where a migration would put them
+                    auto const& retired = other.retired_;
+                    for (size_t gIdx = 0; gIdx < retired.groups; ++gIdx)
+                    {
+                        Group<Backend> g {Layout::ctrlAt(retired.ctrl, gIdx * LANE_COUNT)};
+                        for (int i : Backend::iterate(g.matchFull()))
+                        {
+                            size_t srcIdx = gIdx * LANE_COUNT + i;
+                            size_t hash = other.getSlotHash(
+                                retired.ctrl, retired.slots, retired.capacity, srcIdx);
+                            size_t idx = findEmptySlot(hash);
+                            copyElement(idx, retired.slots, retired.capacity, srcIdx);
+                            setSlotHash(slots_, capacity_, idx, hash);
+                            *Layout::ctrlAt(ctrl_, idx) = h2(hash);
+                            ++used_;
+                        }
                     }
-                    ctrl_[capacity_] = static_cast<ctrl_t>(Ctrl::Sentinel);
                 }
                 catch (...)
                 {
                     // Clean up: destroy all successfully constructed elements
                     for (size_t i = 0; i < capacity_; ++i)
                     {
-                        if ((ctrl_[i] & 0x80) == 0)  // isFull check
+                        if ((*Layout::ctrlAt(ctrl_, i) & 0x80) == 0)  // isFull check
                         {
-                            AllocTraits::destroy(alloc_, slots_[i].element());
+                            destroyElement(slots_, capacity_, i);
                         }
                     }
                     deallocateBuffer(buffer_, ctrlLen_, capacity_);
@@ -609,6 +1141,7 @@ namespace alp
             }
         }
 
+        /// Takes over other's buffer, or moves its elements across if they are inline.
         Table(Table&& other) noexcept { this->swap(other); }
 
         Table& operator=(Table const& other)
@@ -635,7 +1168,7 @@ namespace alp
       public:
         iterator begin()
         {
-            auto it = iteratorAt(0);
+            auto it = firstPosition();
             if (it != end())
             {
                 it.skipEmptySlots();
@@ -645,7 +1178,7 @@ namespace alp
         iterator end() { return iteratorAt(ctrlLen_); }
         const_iterator begin() const
         {
-            auto it = iteratorAt(0);
+            const_iterator it = firstPosition();
             if (it != end())
             {
                 it.skipEmptySlots();
@@ -658,32 +1191,216 @@ namespace alp
 
         [[nodiscard]] bool empty() const { return size_ == 0; }
         [[nodiscard]] size_t size() const { return size_; }
+        /// Returns the number of slots that can hold elements (before the load factor applies).
+        [[nodiscard]] size_t capacity() const { return capacity_; }
+
+        /// Reduces capacity to the smallest power-of-two group count that holds the current
+        /// elements within the load factor. An empty table releases its buffer entirely.
+        /// Invalidates iterators if the table is rebuilt.
+        void shrink_to_fit()
+        {
+            if (size_ == 0)
+            {
+                clear();
+                return;
+            }
+            shrinkToSize(size_);
+        }
+
+        /// Sets the number of threads used to rehash large tables when they grow or shrink.
+        /// The default of 1 rehashes on the calling thread, 0 uses one per hardware thread,
+        /// and other counts are rounded down to a power of two. Unless hashes are stored,
+        /// Hash must be safe to call concurrently. Elements whose move constructor may throw,
+        /// or whose hasher may throw when hashes are not stored, are always rehashed on the
+        /// calling thread.
+        void set_rehash_threads(unsigned threads) noexcept
+        {
+            rehashThreads_ =
+                threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+        }
+        [[nodiscard]] unsigned rehash_threads() const noexcept { return rehashThreads_; }
+
+        /// Whether the table can be saved and loaded as raw bytes.
+        static constexpr bool serializable = bitwiseSerializable<T>
+            && (!hasMapped
+                || std::is_trivially_copyable_v<std::conditional_t<hasMapped, Mapped, T>>);
+
+        /// Header fields that describe the table's type rather than its contents.
+        static SerializedTableHeader serializedHeader(uint64_t hashSeed) noexcept
+        {
+            SerializedTableHeader header;
+            header.groupSize = LANE_COUNT;
+            header.layoutFlags = (Layout::blocked ? SerializedTableHeader::blockedFlag : 0)
+                | (std::is_same_v<HashStoragePolicy, StoreHashTag>
+                       ? SerializedTableHeader::storesHashFlag
+                       : 0)
+                | (Layout::hasFragments ? SerializedTableHeader::compactHashFlag : 0);
+            header.slotSize = sizeof(Slot<T, HashStoragePolicy>);
+            header.slotAlignment = alignof(Slot<T, HashStoragePolicy>);
+            if constexpr (hasMapped)
+            {
+                header.mappedSize = sizeof(Mapped);
+            }
+            header.bufferAlignment = Layout::bufferAlignment();
+            header.loadFactorNum = LoadFactorRatio::num;
+            header.loadFactorDen = LoadFactorRatio::den;
+            header.hashSeed = hashSeed;
+            return header;
+        }
+
+        /// Header describing the table's type and the dimensions of its current buffer.
+        SerializedTableHeader contentsHeader(uint64_t hashSeed) const noexcept
+        {
+            auto header = serializedHeader(hashSeed);
+            header.capacity = capacity_;
+            header.ctrlLen = ctrlLen_;
+            header.groups = groups_;
+            header.size = size_;
+            header.used = used_;
+            header.bufferSize = buffer_ == nullptr ? 0 : Layout::bufferSize(ctrlLen_, capacity_);
+            return header;
+        }
+
+        /// Writes a header describing the table followed by its buffer, verbatim. hashSeed
+        /// identifies the hash function, which loadFrom must be given as well.
+        std::expected<void, Error> saveTo(std::ostream& out, uint64_t hashSeed) const
+            requires serializable
+        {
+            if (retired_.buffer != nullptr)
+            {
+                // A copy has all elements in a single buffer
+                return Table(*this).saveTo(out, hashSeed);
+            }
+
+            auto header = contentsHeader(hashSeed);
+            out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+            if (!isInline())
+            {
+                out.write(reinterpret_cast<char const*>(buffer_),
+                          static_cast<std::streamsize>(header.bufferSize));
+            }
+            else
+            {
+                // Inline storage has the same layout, but only as many slots as it uses
+                std::vector<std::byte> payload(header.bufferSize);
+                std::memcpy(payload.data(), ctrl_, ctrlLen_);
+                std::memcpy(payload.data() + Layout::slotsOffset(ctrlLen_),
+                            slots_,
+                            capacity_ * sizeof(Slot<T, HashStoragePolicy>));
+                out.write(reinterpret_cast<char const*>(payload.data()),
+                          static_cast<std::streamsize>(payload.size()));
+            }
+            if (!out)
+            {
+                return std::unexpected(Error::IoFailure);
+            }
+            return {};
+        }
+
+        /// Restores a table written by saveTo into this empty table with a single read and
+        /// no rehashing. The header must match this table's type, and the control bytes
+        /// and the first elements' hashes are checked against it.
+        std::expected<void, Error> loadFrom(std::istream& in, uint64_t hashSeed)
+            requires serializable
+        {
+            assert(buffer_ == nullptr);
+            SerializedTableHeader header;
+            if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)))
+            {
+                return std::unexpected(Error::IoFailure);
+            }
+            if (!header.sameType(serializedHeader(hashSeed)))
+            {
+                return std::unexpected(Error::IncompatibleFormat);
+            }
+            if (header.capacity == 0)
+            {
+                return {};
+            }
+            if (!header.consistentShape(LANE_COUNT,
+                                        Layout::bufferSize(header.ctrlLen, header.capacity)))
+            {
+                return std::unexpected(Error::IncompatibleFormat);
+            }
+
+            auto* buffer = allocateBuffer(header.ctrlLen, header.capacity);
+            if (!in.read(reinterpret_cast<char*>(buffer),
+                         static_cast<std::streamsize>(header.bufferSize)))
+            {
+                deallocateBuffer(buffer, header.ctrlLen, header.capacity);
+                return std::unexpected(Error::IoFailure);
+            }
+            adoptBuffer(header, buffer);
+            if (!loadedBufferConsistent())
+            {
+                // Elements are trivially destructible, so the buffer can simply be dropped
+                deallocateBuffer(buffer_, ctrlLen_, capacity_);
+                releaseBuffer();
+                return std::unexpected(Error::IncompatibleFormat);
+            }
+            return {};
+        }
+
+        /// Makes this empty table use buffer, allocated by its allocator for the dimensions
+        /// in header and holding a table saved with it, without checking its contents.
+        void adoptBuffer(SerializedTableHeader const& header, std::byte* buffer) noexcept
+            requires serializable
+        {
+            assert(buffer_ == nullptr);
+            buffer_ = buffer;
+            ctrl_ = reinterpret_cast<ctrl_t*>(buffer);
+            slots_ = reinterpret_cast<Slot<T, HashStoragePolicy>*>(
+                buffer + Layout::slotsOffset(header.ctrlLen));
+            capacity_ = header.capacity;
+            ctrlLen_ = header.ctrlLen;
+            groups_ = header.groups;
+            size_ = header.size;
+            used_ = header.used;
+        }
+
+        /// Leaves this table empty without destroying its elements or freeing its buffer,
+        /// which whoever adopted it keeps.
+        void releaseBuffer() noexcept
+            requires serializable
+        {
+            assert(retired_.buffer == nullptr);
+            buffer_ = nullptr;
+            ctrl_ = nullptr;
+            slots_ = nullptr;
+            size_ = used_ = capacity_ = ctrlLen_ = groups_ = 0;
+        }
+
+        /// Makes growth on insertion incremental: the old buffer is kept next to the new one,
+        /// and every following insertion moves groupsPerInsert of its groups across, so that
+        /// no single insertion pays for the whole rehash. Lookups check both buffers until
+        /// then. The default of 0 rehashes in one go. Explicit reserve() and rehashes for
+        /// other reasons always complete the move first.
+        void set_incremental_rehash(size_t groupsPerInsert) noexcept
+        {
+            migrateGroups_ = groupsPerInsert;
+        }
+        [[nodiscard]] size_t incremental_rehash() const noexcept { return migrateGroups_; }
 
         void clear() noexcept
         {
             if (buffer_ != nullptr)
             {
-                if constexpr (!std::is_trivially_destructible_v<T>)
-                {
-                    for (size_t gIdx = 0; gIdx < groups_; ++gIdx)
-                    {
-                        Group<Backend> g {ctrl_ + gIdx * LANE_COUNT};
-                        auto fullMask = g.matchFull();
-
-                        for (int i : Backend::iterate(fullMask))
-                        {
-                            size_t idx = gIdx * LANE_COUNT + i;
-                            AllocTraits::destroy(alloc_, slots_[idx].element());
-                        }
-                    }
-                }
+                destroyElements(ctrl_, slots_, capacity_, groups_);
                 deallocateBuffer(buffer_, ctrlLen_, capacity_);
             }
+            if (retired_.buffer != nullptr)
+            {
+                destroyElements(
+                    retired_.ctrl, retired_.slots, retired_.capacity, retired_.groups);
+                deallocateBuffer(retired_.buffer, retired_.ctrlLen, retired_.capacity);
+                retired_ = {};
+            }
 
             size_ = 0;
             used_ = 0;
             capacity_ = 0;
             ctrlLen_ = 0;
+            shrinkPending_ = false;
             buffer_ = nullptr;
             ctrl_ = nullptr;
             slots_ = nullptr;
@@ -692,12 +1409,18 @@ namespace alp
         void swap(Table& other) noexcept
             requires SafeSwappableAllocator<Allocator>
         {
+            bool thisInline = isInline();
+            bool otherInline = other.isInline();
             using std::swap;
             swap(size_, other.size_);
             swap(used_, other.used_);
             swap(capacity_, other.capacity_);
             swap(ctrlLen_, other.ctrlLen_);
             swap(groups_, other.groups_);
+            swap(rehashThreads_, other.rehashThreads_);
+            swap(shrinkPending_, other.shrinkPending_);
+            swap(migrateGroups_, other.migrateGroups_);
+            swap(retired_, other.retired_);
             if constexpr (AllocTraits::propagate_on_container_swap::value)
             {
                 swap(alloc_, other.alloc_);
@@ -708,9 +1431,31 @@ namespace alp
             swap(buffer_, other.buffer_);
             swap(ctrl_, other.ctrl_);
             swap(slots_, other.slots_);
+
+            // Inline elements stay in their table object unless moved across explicitly
+            if (thisInline || otherInline) [[unlikely]]
+            {
+                swapInlineElements(other, thisInline, otherInline);
+            }
         }
 
       protected:
+        struct CopySettingsTag
+        {
+        };
+
+        /// Makes an empty table with the hasher, equality, rehash settings and (as selected
+        /// for copy construction) allocator of other, for tables that copy elements themselves.
+        Table(CopySettingsTag, Table const& other)
+            : rehashThreads_(other.rehashThreads_)
+            , migrateGroups_(other.migrateGroups_)
+            , alloc_(AllocTraits::select_on_container_copy_construction(other.alloc_))
+            , byte_alloc_(alloc_)
+            , hasher_(other.hasher_)
+            , equal_(other.equal_)
+        {
+        }
+
         /// Finds the index of the slot containing the given key.
         /// Returns ctrlLen_ if not found.
         template<typename K>
@@ -721,23 +1466,112 @@ namespace alp
                 return ctrlLen_;
             }
 
-            auto hash = Policy::apply(hasher_(key));
-            size_t mask = groups_ - 1;
-            auto group = h1(hash) & mask;  // Since groups_ is a power of 2
-            auto h2Val = h2(hash);
+            return find_internal(key, Policy::apply(hasher_(key)));
+        }
 
-            Prober prober {group};
-            while (true)
+        /// Finds the index of the slot containing the given key, whose hash
+        /// (with Policy already applied) has been computed by the caller.
+        /// Returns ctrlLen_ if not found.
+        template<typename K>
+        [[nodiscard]] auto find_internal(K const& key, size_t hash) const -> size_t
+        {
+            if (size_ == 0)
+            {
+                return ctrlLen_;
+            }
+
+            size_t mask = groups_ - 1;
+            auto group = h1(hash) & mask;  // Since groups_ is a power of 2
+            auto h2Val = h2(hash);
+
+            Prober prober {group};
+            while (true)
             {
-                Group<Backend> g {ctrl_ + group * LANE_COUNT};
+                Group<Backend> g {Layout::ctrlAt(ctrl_, group * LANE_COUNT)};
                 for (int i : g.match(h2Val))
                 {
-                    if (equal_(key, *slots_[group * LANE_COUNT + i].element())) [[likely]]
+                    if (equal_(key, *Layout::slotAt(slots_, group * LANE_COUNT + i)->element()))
+                        [[likely]]
                     {
                         return group * LANE_COUNT + i;
                     }
                 }
                 if (g.anyEmpty()) [[likely]]
+                {
+                    if (retired_.buffer != nullptr) [[unlikely]]
+                    {
+                        return findRetired(key, hash);
+                    }
+                    return ctrlLen_;
+                }
+                group = prober.nextGroup(group, mask);
+            }
+        }
+
+        /// Like find_internal, but for a reader racing with a writer that is serialized by a
+        /// sequence counter. The live buffer is read first, then snapshotValid() must confirm
+        /// that no write overlapped that read before the buffer is probed. Returns the
+        /// matching element or nullptr, to be trusted only if no write overlapped the probe
+        /// either. Buffers the writer replaces must stay allocated while readers may still
+        /// probe them, and probing visits each group at most once, so that a buffer modified
+        /// underneath can neither be read past its end nor keep the reader looping.
+        template<typename K, typename F>
+        [[nodiscard]] T const* find_optimistic(K const& key, size_t hash, F&& snapshotValid) const
+        {
+            ctrl_t const* ctrl = ctrl_;
+            Slot<T, HashStoragePolicy> const* slots = slots_;
+            size_t groups = groups_;
+            if (!snapshotValid() || ctrl == nullptr)
+            {
+                return nullptr;
+            }
+
+            size_t mask = groups - 1;
+            auto group = h1(hash) & mask;
+            auto h2Val = h2(hash);
+            Prober prober {group};
+            for (size_t step = 0; step < groups; ++step)
+            {
+                Group<Backend> g {Layout::ctrlAt(ctrl, group * LANE_COUNT)};
+                for (int i : g.match(h2Val))
+                {
+                    T const* element = Layout::slotAt(slots, group * LANE_COUNT + i)->element();
+                    if (equal_(key, *element))
+                    {
+                        return element;
+                    }
+                }
+                if (g.anyEmpty())
+                {
+                    break;
+                }
+                group = prober.nextGroup(group, mask);
+            }
+            return nullptr;
+        }
+
+        /// Like find_internal, but searching the buffer an incremental rehash is draining.
+        /// Returns ctrlLen_ + 1 + the slot index there, or ctrlLen_ if not found.
+        template<typename K>
+        [[nodiscard]] auto findRetired(K const& key, size_t hash) const -> size_t
+        {
+            size_t mask = retired_.groups - 1;
+            auto group = h1(hash) & mask;
+            auto h2Val = h2(hash);
+
+            Prober prober {group};
+            while (true)
+            {
+                Group<Backend> g {Layout::ctrlAt(retired_.ctrl, group * LANE_COUNT)};
+                for (int i : g.match(h2Val))
+                {
+                    size_t idx = group * LANE_COUNT + i;
+                    if (equal_(key, *Layout::slotAt(retired_.slots, idx)->element()))
+                    {
+                        return ctrlLen_ + 1 + idx;
+                    }
+                }
+                if (g.anyEmpty())
                 {
                     return ctrlLen_;
                 }
@@ -745,65 +1579,166 @@ namespace alp
             }
         }
 
-        /// Core insertion logic. Checks for duplicates using SIMD probing,
-        /// triggers rehash if needed, and inserts into an empty slot.
+        /// Looks up every key and calls onResult(i, idx) with the slot index of keys[i]
+        /// (ctrlLen_ if not found).
+        /// Keys are processed in batches: all hashes of a batch are computed and their
+        /// starting groups prefetched, then the first candidate slot of each key is
+        /// prefetched, and only then are the keys probed. The cache misses of independent
+        /// lookups thereby overlap instead of being paid one after another.
+        template<typename K, typename F>
+        void find_many_internal(std::span<K const> keys, F&& onResult) const
+        {
+            if (size_ == 0)
+            {
+                for (size_t i = 0; i < keys.size(); ++i)
+                {
+                    onResult(i, ctrlLen_);
+                }
+                return;
+            }
+
+            size_t mask = groups_ - 1;
+            size_t hashes[findBatchSize];
+            for (size_t base = 0; base < keys.size(); base += findBatchSize)
+            {
+                size_t count = std::min(findBatchSize, keys.size() - base);
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    hashes[i] = Policy::apply(hasher_(keys[base + i]));
+                    prefetch(Layout::ctrlAt(ctrl_, (h1(hashes[i]) & mask) * LANE_COUNT));
+                }
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    size_t baseSlot = (h1(hashes[i]) & mask) * LANE_COUNT;
+                    Group<Backend> g {Layout::ctrlAt(ctrl_, baseSlot)};
+                    for (int j : g.match(h2(hashes[i])))
+                    {
+                        prefetch(Layout::slotAt(slots_, baseSlot + j)->element());
+                        break;
+                    }
+                }
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    onResult(base + i, find_internal(keys[base + i], hashes[i]));
+                }
+            }
+        }
+
+        /// Core insertion logic. Checks for the key using SIMD probing,
+        /// triggers rehash if needed, and on a miss constructs the element from args
+        /// directly in the first empty or deleted slot seen along the probe sequence.
         /// Returns the index and whether insertion occurred.
-        std::pair<size_t, bool> emplace_internal(T& value, size_t hash)
+        template<typename K, typename... Args>
+        std::pair<size_t, bool> emplace_internal(K const& key, size_t hash, Args&&... args)
         {
             if (capacity_ == 0)
             {
                 reserve(1);
             }
+            if (retired_.buffer != nullptr) [[unlikely]]
+            {
+                size_t step = std::max<size_t>(migrateGroups_, 1);
+                migrateGroupsUpTo(std::min(retired_.nextGroup + step, retired_.groups));
+            }
             auto h1Val = h1(hash);
             auto h2Val = h2(hash);
             size_t mask = groups_ - 1;
             size_t group = h1Val & mask;
 
+            // First free (empty or deleted) slot on the probe sequence.
+            // We can only claim it once we know the key is absent, i.e. after
+            // reaching a group that contains an empty slot.
+            size_t target = ctrlLen_;
+
             Prober prober {group};
             while (true)
             {
                 auto baseSlot = group * LANE_COUNT;
-                Group<Backend> g {ctrl_ + baseSlot};
+                Group<Backend> g {Layout::ctrlAt(ctrl_, baseSlot)};
 
                 typename Backend::Iterable candidates = g.match(h2Val);
                 for (auto i : candidates)
                 {
                     auto slotNumber = baseSlot + i;
-                    T const& result = *slots_[slotNumber].element();
+                    T const& result = *Layout::slotAt(slots_, slotNumber)->element();
 
-                    if (equal_(result, value))
+                    if (equal_(key, result))
                     {
                         return {slotNumber, false};
                     }
                 }
 
-                auto empty = g.matchEmpty();
-                auto emptyIdx = Backend::firstTrue(empty);
-                if (emptyIdx)
+                if (target == ctrlLen_)
                 {
-                    if (size_ + 1 > capacity_ * loadFactor)
+                    auto freeIdx = Backend::firstTrue(g.matchEmptyOrDeleted());
+                    if (freeIdx)
                     {
-                        reserve(size_ + 1);
-                        return emplace_internal(value, hash);
+                        target = baseSlot + static_cast<int>(*freeIdx);
                     }
+                }
 
-                    int offset = static_cast<int>(*emptyIdx);
-                    size_t idx = baseSlot + offset;
-
-                    ctrl_[idx] = h2Val;
-                    setSlotHash(slots_[idx],
-                                hash);  // Store full hash for fast rehashing if policy requires
-                    AllocTraits::construct(alloc_, slots_[idx].element(), std::move(value));
-                    size_++;
-
-                    return {idx, true};
+                if (g.anyEmpty())
+                {
+                    break;
                 }
                 group = prober.nextGroup(group, mask);
             }
+
+            if (retired_.buffer != nullptr) [[unlikely]]
+            {
+                size_t retiredIdx = findRetired(key, hash);
+                if (retiredIdx != ctrlLen_)
+                {
+                    return {retiredIdx, false};
+                }
+            }
+
+            // A shrink noted by erase happens once the key is known to be absent, sized for
+            // the element about to be added so that it cannot grow the table straight back
+            if (shrinkPending_) [[unlikely]]
+            {
+                shrinkToSize(size_ + 1);
+                return emplace_internal(key, hash, std::forward<Args>(args)...);
+            }
+
+            // Claiming a tombstone leaves the number of empty slots unchanged, so only
+            // insertions into empty slots are bounded by the load factor.
+            bool claimsEmpty = *Layout::ctrlAt(ctrl_, target) == static_cast<ctrl_t>(Ctrl::Empty);
+            if (claimsEmpty && used_ + 1 > capacity_ * loadFactor)
+            {
+                makeRoomForInsert();
+                return emplace_internal(key, hash, std::forward<Args>(args)...);
+            }
+
+            // Construct first so that a throwing constructor leaves the table untouched.
+            constructElement(target, std::forward<Args>(args)...);
+            *Layout::ctrlAt(ctrl_, target) = h2Val;
+            setSlotHash(slots_, capacity_, target, hash);  // For fast rehashing, if stored
+            size_++;
+            if (claimsEmpty)
+            {
+                used_++;
+            }
+
+            return {target, true};
+        }
+
+        /// Hashes the key and delegates to the core insertion logic.
+        /// The element is only constructed from args if the key is absent,
+        /// so args must build an element that compares equal to key.
+        template<typename K, typename... Args>
+        std::pair<size_t, bool> emplace_key(K const& key, Args&&... args)
+        {
+            auto hash = Policy::apply(hasher_(key));
+            return emplace_internal(key, hash, std::forward<Args>(args)...);
         }
 
         /// Wrapper that constructs a temporary element and computes the hash
         /// before delegating to the core insertion logic.
+        /// Only used when the key cannot be extracted from args without constructing.
         template<typename... Args>
         std::pair<size_t, bool> emplace_wrapper(Args&&... args)
         {
@@ -812,117 +1747,770 @@ namespace alp
                 std::construct_at(reinterpret_cast<T*>(tempStorage), std::forward<Args>(args)...);
 
             auto hash = Policy::apply(hasher_(*temp));
-            auto result = emplace_internal(*temp, hash);
+            auto result = emplace_internal(*temp, hash, std::move(*temp));
+
+            temp->~T();
+
+            return result;
+        }
+
+        /// Like emplace_wrapper, but with the element's hash (with Policy applied)
+        /// supplied by the caller instead of computed from the temporary.
+        template<typename... Args>
+        std::pair<size_t, bool> emplace_wrapper_hashed(size_t hash, Args&&... args)
+        {
+            alignas(T) uint8_t tempStorage[sizeof(T)];
+            T* temp =
+                std::construct_at(reinterpret_cast<T*>(tempStorage), std::forward<Args>(args)...);
+
+            auto result = emplace_internal(*temp, hash, std::move(*temp));
 
             temp->~T();
 
             return result;
         }
 
-        void reserve(size_type count)
+        /// Inserts every element of range.
+        /// If the number of elements can be determined up front, the table is grown
+        /// once for all of them. Elements that are referenced T values, or whose key
+        /// keyOf extracts, are then hashed a batch at a time and their home groups
+        /// prefetched before any is inserted.
+        template<typename R, typename KeyOf = std::identity>
+        void insert_range_internal(R&& range, KeyOf keyOf = {})
+        {
+            if constexpr (std::ranges::sized_range<R> || std::ranges::forward_range<R>)
+            {
+                reserve(size_ + static_cast<size_t>(std::ranges::distance(range)));
+            }
+
+            using Reference = std::ranges::range_reference_t<R>;
+            constexpr bool keyed = !std::is_same_v<KeyOf, std::identity>
+                || std::is_same_v<std::remove_cvref_t<Reference>, T>;
+            if constexpr (std::ranges::forward_range<R> && std::is_reference_v<Reference> && keyed)
+            {
+                insertBatched(std::ranges::begin(range), std::ranges::end(range), keyOf);
+            }
+            else
+            {
+                for (auto&& element : range)
+                {
+                    if constexpr (keyed)
+                    {
+                        emplace_key(keyOf(element), std::forward<decltype(element)>(element));
+                    }
+                    else
+                    {
+                        emplace_wrapper(std::forward<decltype(element)>(element));
+                    }
+                }
+            }
+        }
+
+        void reserve(size_type count)
+        {
+            finishMigration();
+            auto desired = static_cast<size_t>(std::ceil(count / loadFactor));
+            if (desired <= capacity_)
+            {
+                return;
+            }
+            if (buffer_ == nullptr && desired <= inlineCapacity)
+            {
+                useInlineStorage();
+                return;
+            }
+            rehash(desired);
+        }
+
+        void rehash(size_type count)
+        {
+            // We first find the smallest number of groups
+            // that satisfies size and power of 2 requirements.
+            size_t groupCount = findSmallestN(count);
+            return rehashImpl(groupCount);
+        }
+
+        /// Erases the element at the given slot index.
+        /// Marks the slot as deleted or empty based on group state.
+        void erase_slot(size_t offset)
+        {
+            if (offset > ctrlLen_) [[unlikely]]
+            {
+                eraseRetired(offset - ctrlLen_ - 1);
+                return;
+            }
+            destroyElement(slots_, capacity_, offset);
+            --size_;
+
+            auto* ctrl = Layout::ctrlAt(ctrl_, offset);
+            auto addr = reinterpret_cast<uintptr_t>(ctrl);
+            auto alignedAddr = addr & ~static_cast<uintptr_t>(LANE_COUNT - 1);
+            auto groupPtr = reinterpret_cast<ctrl_t*>(alignedAddr);
+
+            Group<Backend> g {groupPtr};
+            if (g.anyEmpty())
+            {
+                *ctrl = static_cast<ctrl_t>(Ctrl::Empty);
+                --used_;
+            }
+            else
+            {
+                *ctrl = static_cast<ctrl_t>(Ctrl::Deleted);
+            }
+
+            if (Shrink::shouldShrink(size_, capacity_))
+            {
+                shrinkPending_ = true;
+            }
+        }
+
+        /// Extracts the upper bits for group selection.
+        static constexpr size_t h1(size_t hash) noexcept { return hash >> 7; }
+        /// Extracts the lower 7 bits for control byte matching.
+        static constexpr ctrl_t h2(size_t hash) noexcept { return hash & 0x7F; }
+
+        /// Get the hash of the element in slot idx of the buffer with the given control
+        /// bytes, slots and capacity: stored, rebuilt from its fragment, or recomputed.
+        /// Rebuilt hashes only match the original in the bits that h1 and h2 use for
+        /// tables of up to 2^32 groups.
+        [[nodiscard]] size_t getSlotHash(ctrl_t const* ctrl,
+                                         Slot<T, HashStoragePolicy> const* slots,
+                                         size_t capacity,
+                                         size_t idx) const
+        {
+            if constexpr (std::is_same_v<HashStoragePolicy, StoreHashTag>)
+            {
+                return Layout::slotAt(slots, idx)->hash;
+            }
+            else if constexpr (std::is_same_v<HashStoragePolicy, CompactHashTag>)
+            {
+                return (size_t {Layout::fragments(slots, capacity)[idx]} << 7) | ctrl[idx];
+            }
+            else
+            {
+                return Policy::apply(hasher_(*Layout::slotAt(slots, idx)->element()));
+            }
+        }
+
+        /// Store hash if policy requires
+        void setSlotHash(Slot<T, HashStoragePolicy>* slots,
+                         size_t capacity,
+                         size_t idx,
+                         size_t hash) noexcept
+        {
+            if constexpr (std::is_same_v<HashStoragePolicy, StoreHashTag>)
+            {
+                Layout::slotAt(slots, idx)->hash = hash;
+            }
+            else if constexpr (std::is_same_v<HashStoragePolicy, CompactHashTag>)
+            {
+                Layout::fragments(slots, capacity)[idx] = static_cast<uint32_t>(h1(hash));
+            }
+            // NoStoreHashTag: no-op, optimized away by compiler
+        }
+
+        /// Slot indices past ctrlLen_ refer to the buffer an incremental rehash is draining,
+        /// as returned by find_internal and emplace_internal.
+        iterator iteratorAt(size_t offset) noexcept
+        {
+            if (offset > ctrlLen_) [[unlikely]]
+            {
+                size_t idx = offset - ctrlLen_ - 1;
+                return {Layout::ctrlAt(retired_.ctrl, idx), Layout::slotAt(retired_.slots, idx)};
+            }
+            return {Layout::ctrlAt(ctrl_, offset), Layout::slotAt(slots_, offset)};
+        }
+        const_iterator iteratorAt(size_t offset) const noexcept
+        {
+            return const_cast<Table*>(this)->iteratorAt(offset);
+        }
+
+        /// Inverse of iteratorAt.
+        [[nodiscard]] size_t indexOf(const_iterator pos) const noexcept
+        {
+            if (retired_.buffer != nullptr && inRetired(pos.ctrl)) [[unlikely]]
+            {
+                return ctrlLen_ + 1 + Layout::indexOf(retired_.ctrl, pos.ctrl);
+            }
+            return Layout::indexOf(ctrl_, pos.ctrl);
+        }
+
+        /// Mapped value of the element at index offset of the live buffer.
+        [[nodiscard]] auto* mappedAt(size_t offset) const noexcept
+            requires hasMapped
+        {
+            return Layout::mapped(slots_, capacity_) + offset;
+        }
+
+        [[nodiscard]] Slot<T, HashStoragePolicy>* slotAt(size_t offset) const noexcept
+        {
+            if (offset > ctrlLen_) [[unlikely]]
+            {
+                return Layout::slotAt(retired_.slots, offset - ctrlLen_ - 1);
+            }
+            return Layout::slotAt(slots_, offset);
+        }
+
+        using Layout = TableLayout<T, LANE_COUNT, HashStoragePolicy, Mapped, CtrlLayout>;
+
+        size_t size_ = 0;
+        size_t used_ = 0;  // Full plus deleted slots
+        size_t capacity_ = 0;
+        size_t ctrlLen_ = 0;
+        size_t groups_ = 0;
+        unsigned rehashThreads_ = 1;
+        bool shrinkPending_ = false;  // Set by erase when Shrink asks for a smaller table
+        size_t migrateGroups_ = 0;  // Groups moved per insertion; 0 rehashes in one go
+        [[no_unique_address]] Allocator alloc_;
+        [[no_unique_address]] ByteAlloc byte_alloc_;  // Rebound allocator for buffer
+        [[no_unique_address]] Hash hasher_;
+        [[no_unique_address]] Equal equal_;
+        std::byte* buffer_ = nullptr;  // Single co-located allocation
+        ctrl_t* ctrl_ = nullptr;  // Points into buffer_
+        Slot<T, HashStoragePolicy>* slots_ = nullptr;  // Points into buffer_ after ctrl
+
+        /// The previous buffer while an incremental rehash moves its elements across.
+        /// Moved elements leave deleted slots behind, so probe sequences stay intact.
+        struct RetiredBuffer
+        {
+            std::byte* buffer = nullptr;
+            ctrl_t* ctrl = nullptr;
+            Slot<T, HashStoragePolicy>* slots = nullptr;
+            size_t capacity = 0;
+            size_t ctrlLen = 0;
+            size_t groups = 0;
+            size_t size = 0;  // Elements not moved yet
+            size_t nextGroup = 0;  // First group not moved yet
+        };
+        RetiredBuffer retired_;
+        [[no_unique_address]] InlineStorage inline_;
+
+        /// Returns true if the elements live in inline_ rather than an allocated buffer.
+        [[nodiscard]] bool isInline() const noexcept
+        {
+            if constexpr (inlineCapacity == 0)
+            {
+                return false;
+            }
+            else
+            {
+                return buffer_ != nullptr && buffer_ == inlineBytes();
+            }
+        }
+
+      private:
+        [[nodiscard]] std::byte* inlineBytes() const noexcept
+        {
+            if constexpr (inlineCapacity == 0)
+            {
+                return nullptr;
+            }
+            else
+            {
+                return reinterpret_cast<std::byte*>(const_cast<InlineStorage*>(&inline_));
+            }
+        }
+
+        /// Points the table at inline_ without touching its contents.
+        void pointAtInline() noexcept
+        {
+            if constexpr (inlineCapacity > 0)
+            {
+                buffer_ = inlineBytes();
+                ctrl_ = inline_.ctrl;
+                slots_ = reinterpret_cast<Slot<T, HashStoragePolicy>*>(inline_.slots);
+            }
+        }
+
+        /// Makes an empty, unallocated table use inline_ for its elements.
+        void useInlineStorage() noexcept
+        {
+            pointAtInline();
+            std::memset(ctrl_, static_cast<ctrl_t>(Ctrl::Empty), inlineCapacity);
+            std::memset(ctrl_ + inlineCapacity,
+                        static_cast<ctrl_t>(Ctrl::Sentinel),
+                        LANE_COUNT - inlineCapacity);
+            capacity_ = inlineCapacity;
+            ctrlLen_ = LANE_COUNT;
+            groups_ = 1;
+            used_ = 0;
+        }
+
+        /// Moves the control bytes and elements of one inline buffer into another.
+        void relocateInline(InlineStorage& from, InlineStorage& to) noexcept
+        {
+            std::memcpy(to.ctrl, from.ctrl, LANE_COUNT);
+            auto* fromSlots = reinterpret_cast<Slot<T, HashStoragePolicy>*>(from.slots);
+            auto* toSlots = reinterpret_cast<Slot<T, HashStoragePolicy>*>(to.slots);
+            for (size_t i = 0; i < inlineCapacity; ++i)
+            {
+                if ((from.ctrl[i] & 0x80) == 0)  // isFull check
+                {
+                    transferSlot(toSlots[i], fromSlots[i]);
+                }
+            }
+        }
+
+        /// Second half of swap when either table was inline: after the members have been
+        /// swapped, moves the inline elements into the table object that now owns them.
+        void swapInlineElements(Table& other, bool thisWasInline, bool otherWasInline) noexcept
+        {
+            if constexpr (inlineCapacity > 0)
+            {
+                if (thisWasInline && otherWasInline)
+                {
+                    InlineStorage temp;
+                    relocateInline(inline_, temp);
+                    relocateInline(other.inline_, inline_);
+                    relocateInline(temp, other.inline_);
+                }
+                else if (otherWasInline)
+                {
+                    relocateInline(other.inline_, inline_);
+                }
+                else
+                {
+                    relocateInline(inline_, other.inline_);
+                }
+
+                if (otherWasInline)
+                {
+                    pointAtInline();
+                }
+                if (thisWasInline)
+                {
+                    other.pointAtInline();
+                }
+            }
+        }
+
+        /// Finds the smallest n such that 16 * n >= count + 1
+        /// with n being a power of 2.
+        static size_t findSmallestN(size_t count)
+        {
+            size_t min_capacity = count + 1;
+            return std::bit_ceil((min_capacity + LANE_COUNT - 1) / LANE_COUNT);
+        }
+
+        /// Rebuilds the table with the fewest groups that fit count elements, if that is
+        /// fewer than it has now. Always keeps at least one group allocated.
+        void shrinkToSize(size_t count)
+        {
+            auto desired = static_cast<size_t>(std::ceil(count / loadFactor));
+            size_t groupCount = findSmallestN(desired);
+            if (groupCount < groups_)
+            {
+                rehashImpl(groupCount);
+            }
+            shrinkPending_ = false;
+        }
+
+        /// Batch step of insert_range_internal for forward iterators over T, or over
+        /// elements whose key keyOf extracts.
+        template<typename It, typename Sentinel, typename KeyOf>
+        void insertBatched(It it, Sentinel last, KeyOf keyOf)
+        {
+            It iters[insertBatchSize];
+            size_t hashes[insertBatchSize];
+
+            while (it != last)
+            {
+                size_t mask = groups_ - 1;
+                size_t count = 0;
+                for (; count < insertBatchSize && it != last; ++it, ++count)
+                {
+                    iters[count] = it;
+                    hashes[count] = Policy::apply(hasher_(keyOf(*it)));
+                    prefetch(Layout::ctrlAt(ctrl_, (h1(hashes[count]) & mask) * LANE_COUNT));
+                }
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    emplace_internal(keyOf(*iters[i]), hashes[i], *iters[i]);
+                }
+            }
+        }
+
+        /// Called when an insertion would push full plus deleted slots past the load factor.
+        /// Purges tombstones in place if they make up a large enough share of the table,
+        /// and otherwise grows as if every tombstone were a live element.
+        void makeRoomForInsert()
+        {
+            finishMigration();
+            auto tombstones = used_ - size_;
+            if (tombstones >= capacity_ * loadFactor * tombstonePurgeFraction)
+            {
+                purgeTombstones();
+            }
+            else if (migrateGroups_ != 0 && !isInline() && !hasMapped)
+            {
+                auto desired = static_cast<size_t>(std::ceil((used_ + 1) / loadFactor));
+                startMigration(findSmallestN(desired));
+            }
+            else
+            {
+                reserve(used_ + 1);
+            }
+        }
+
+        /// Starts an incremental rehash into newGroupCount groups. The current buffer is
+        /// retired and drained by later insertions; new elements only go to the new one.
+        void startMigration(size_t newGroupCount)
+        {
+            auto count = LANE_COUNT * newGroupCount;
+            auto newCapacity = count - 1;
+            auto* newBuffer = allocateBuffer(count, newCapacity);
+
+            retired_ = {buffer_, ctrl_, slots_, capacity_, ctrlLen_, groups_, size_, 0};
+            buffer_ = newBuffer;
+            ctrl_ = reinterpret_cast<ctrl_t*>(newBuffer);
+            slots_ = reinterpret_cast<Slot<T, HashStoragePolicy>*>(newBuffer
+                                                                   + Layout::slotsOffset(count));
+            Layout::initCtrl(ctrl_, newCapacity, count);
+            ctrlLen_ = count;
+            capacity_ = newCapacity;
+            groups_ = newGroupCount;
+            used_ = 0;
+
+            // The last group is moved now, so that its slots can tell iterators running
+            // off the end of the retired buffer where the live one starts
+            migrateGroup(retired_.groups - 1);
+            if (retired_.size == 0)
+            {
+                deallocateBuffer(retired_.buffer, retired_.ctrlLen, retired_.capacity);
+                retired_ = {};
+                return;
+            }
+            Layout::writeHandoff(retired_.ctrl, retired_.slots, retired_.capacity, ctrl_, ctrlLen_);
+        }
+
+        /// Moves the elements of retired group gIdx into the live buffer.
+        void migrateGroup(size_t gIdx)
+        {
+            auto* groupCtrl = Layout::ctrlAt(retired_.ctrl, gIdx * LANE_COUNT);
+            Group<Backend> g {groupCtrl};
+            for (int i : Backend::iterate(g.matchFull()))
+            {
+                size_t hash = getSlotHash(
+                    retired_.ctrl, retired_.slots, retired_.capacity, gIdx * LANE_COUNT + i);
+                placeInGroups(ctrl_,
+                              slots_,
+                              groups_ - 1,
+                              0,
+                              groups_,
+                              retired_.slots,
+                              retired_.capacity,
+                              gIdx * LANE_COUNT + i,
+                              hash);
+                groupCtrl[i] = static_cast<ctrl_t>(Ctrl::Deleted);
+                --retired_.size;
+                ++used_;
+            }
+        }
+
+        /// Moves the elements of the retired groups before last into the live buffer,
+        /// releasing the retired buffer once it is empty.
+        void migrateGroupsUpTo(size_t last)
+        {
+            for (; retired_.nextGroup < last && retired_.size > 0; ++retired_.nextGroup)
+            {
+                migrateGroup(retired_.nextGroup);
+            }
+
+            if (retired_.size == 0)
+            {
+                deallocateBuffer(retired_.buffer, retired_.ctrlLen, retired_.capacity);
+                retired_ = {};
+            }
+        }
+
+        /// Returns true if pos points into the retired buffer.
+        [[nodiscard]] bool inRetired(ctrl_t const* pos) const noexcept
+        {
+            auto address = reinterpret_cast<uintptr_t>(pos);
+            auto first = reinterpret_cast<uintptr_t>(retired_.ctrl);
+            return address >= first
+                && address < first + Layout::bufferSize(retired_.ctrlLen, retired_.capacity);
+        }
+
+        /// Completes an incremental rehash, if one is in progress.
+        void finishMigration()
+        {
+            if (retired_.buffer != nullptr)
+            {
+                migrateGroupsUpTo(retired_.groups);
+            }
+        }
+
+        /// Erases the element at index idx of the retired buffer.
+        void eraseRetired(size_t idx)
+        {
+            destroyElement(retired_.slots, retired_.capacity, idx);
+            *Layout::ctrlAt(retired_.ctrl, idx) = static_cast<ctrl_t>(Ctrl::Deleted);
+            --size_;
+            if (--retired_.size == 0)
+            {
+                deallocateBuffer(retired_.buffer, retired_.ctrlLen, retired_.capacity);
+                retired_ = {};
+            }
+        }
+
+        /// Returns the position iteration starts from, before skipping empty slots.
+        /// Iteration covers the retired buffer first, if there is one.
+        iterator firstPosition() const noexcept
+        {
+            auto* self = const_cast<Table*>(this);
+            if (retired_.buffer != nullptr) [[unlikely]]
+            {
+                return {retired_.ctrl, retired_.slots};
+            }
+            return self->iteratorAt(0);
+        }
+
+        /// Returns the first empty slot on the probe sequence of hash in the live buffer.
+        [[nodiscard]] size_t findEmptySlot(size_t hash) const noexcept
+        {
+            size_t mask = groups_ - 1;
+            size_t group = h1(hash) & mask;
+            Prober prober {group};
+            while (true)
+            {
+                Group<Backend> g {Layout::ctrlAt(ctrl_, group * LANE_COUNT)};
+                auto emptyIdx = Backend::firstTrue(g.matchEmpty());
+                if (emptyIdx)
+                {
+                    return group * LANE_COUNT + static_cast<int>(*emptyIdx);
+                }
+                group = prober.nextGroup(group, mask);
+            }
+        }
+
+        /// Destroys the elements in the full slots of a buffer.
+        void destroyElements(ctrl_t const* ctrl,
+                             Slot<T, HashStoragePolicy>* slots,
+                             size_t capacity,
+                             size_t groups) noexcept
+        {
+            if constexpr (!std::is_trivially_destructible_v<T> || hasMapped)
+            {
+                for (size_t gIdx = 0; gIdx < groups; ++gIdx)
+                {
+                    Group<Backend> g {Layout::ctrlAt(ctrl, gIdx * LANE_COUNT)};
+                    for (int i : Backend::iterate(g.matchFull()))
+                    {
+                        destroyElement(slots, capacity, gIdx * LANE_COUNT + i);
+                    }
+                }
+            }
+        }
+
+        /// Constructs the element at index idx of the live buffer from args. With mapped
+        /// values, args are std::piecewise_construct and the argument tuples of the key
+        /// and the value.
+        template<typename... Args>
+        void constructElement(size_t idx, Args&&... args)
+        {
+            if constexpr (hasMapped)
+            {
+                constructSplit(idx, std::forward<Args>(args)...);
+            }
+            else
+            {
+                AllocTraits::construct(
+                    alloc_, Layout::slotAt(slots_, idx)->element(), std::forward<Args>(args)...);
+            }
+        }
+
+        template<typename KeyArgs, typename MappedArgs>
+        void constructSplit(size_t idx,
+                            std::piecewise_construct_t,
+                            KeyArgs&& keyArgs,
+                            MappedArgs&& mappedArgs)
+        {
+            std::apply(
+                [&](auto&&... a)
+                {
+                    AllocTraits::construct(
+                        alloc_,
+                        Layout::slotAt(slots_, idx)->element(),
+                        std::forward<decltype(a)>(a)...);
+                },
+                std::forward<KeyArgs>(keyArgs));
+            try
+            {
+                std::apply(
+                    [&](auto&&... a)
+                    {
+                        AllocTraits::construct(
+                            alloc_, mappedAt(idx), std::forward<decltype(a)>(a)...);
+                    },
+                    std::forward<MappedArgs>(mappedArgs));
+            }
+            catch (...)
+            {
+                AllocTraits::destroy(alloc_, Layout::slotAt(slots_, idx)->element());
+                throw;
+            }
+        }
+
+        /// Copy-constructs the element at index idx of the live buffer from the one at
+        /// srcIdx of the buffer with the given slots and capacity.
+        void copyElement(size_t idx,
+                         Slot<T, HashStoragePolicy> const* srcSlots,
+                         size_t srcCapacity,
+                         size_t srcIdx)
         {
-            auto desired = static_cast<size_t>(std::ceil(count / loadFactor));
-            if (desired <= capacity_)
+            AllocTraits::construct(alloc_,
+                                   Layout::slotAt(slots_, idx)->element(),
+                                   *Layout::slotAt(srcSlots, srcIdx)->element());
+            if constexpr (hasMapped)
             {
-                return;
+                try
+                {
+                    AllocTraits::construct(
+                        alloc_, mappedAt(idx), Layout::mapped(srcSlots, srcCapacity)[srcIdx]);
+                }
+                catch (...)
+                {
+                    AllocTraits::destroy(alloc_, Layout::slotAt(slots_, idx)->element());
+                    throw;
+                }
             }
-            rehash(desired);
         }
 
-        void rehash(size_type count)
+        /// Destroys the element, and its mapped value if any, at index idx of a buffer.
+        void destroyElement(Slot<T, HashStoragePolicy>* slots, size_t capacity, size_t idx) noexcept
         {
-            // We first find the smallest number of groups
-            // that satisfies size and power of 2 requirements.
-            size_t groupCount = findSmallestN(count);
-            return rehashImpl(groupCount);
+            if constexpr (!std::is_trivially_destructible_v<T>)
+            {
+                AllocTraits::destroy(alloc_, Layout::slotAt(slots, idx)->element());
+            }
+            if constexpr (hasMapped && !std::is_trivially_destructible_v<Mapped>)
+            {
+                AllocTraits::destroy(alloc_, Layout::mapped(slots, capacity) + idx);
+            }
         }
 
-        /// Erases the element at the given slot index.
-        /// Marks the slot as deleted or empty based on group state.
-        void erase_slot(size_t offset)
+        /// Rebuilds the table at its current capacity without allocating, turning every
+        /// deleted slot back into an empty one.
+        /// Every full slot is first relabelled as deleted to mark it as not yet placed.
+        /// Each such element is then moved to the first free slot on its probe sequence,
+        /// swapping with another unplaced element when that slot is still occupied.
+        void purgeTombstones()
         {
-            if constexpr (!std::is_trivially_destructible_v<T>)
+            if constexpr (std::is_same_v<HashStoragePolicy, CompactHashTag> || hasMapped
+                          || !rehashNothrow)
             {
-                AllocTraits::destroy(alloc_, slots_[offset].element());
+                // Relabelling would lose the control bytes that complete the fragments,
+                // swapping elements would need room for a mapped value on the side, and
+                // an exception partway through would leave live elements marked deleted
+                rehashImpl(groups_);
+                return;
             }
-            --size_;
 
-            auto addr = reinterpret_cast<uintptr_t>(ctrl_ + offset);
-            auto alignedAddr = addr & ~static_cast<uintptr_t>(LANE_COUNT - 1);
-            auto groupPtr = reinterpret_cast<ctrl_t*>(alignedAddr);
+            constexpr auto empty = static_cast<ctrl_t>(Ctrl::Empty);
+            constexpr auto deleted = static_cast<ctrl_t>(Ctrl::Deleted);
 
-            Group<Backend> g {groupPtr};
-            if (g.anyEmpty())
+            for (size_t i = 0; i < capacity_; ++i)
             {
-                ctrl_[offset] = static_cast<ctrl_t>(Ctrl::Empty);
+                auto* ctrl = Layout::ctrlAt(ctrl_, i);
+                *ctrl = (*ctrl & 0x80) == 0 ? deleted : empty;
             }
-            else
+
+            size_t mask = groups_ - 1;
+            for (size_t i = 0; i < capacity_;)
             {
-                ctrl_[offset] = static_cast<ctrl_t>(Ctrl::Deleted);
+                if (*Layout::ctrlAt(ctrl_, i) != deleted)
+                {
+                    ++i;
+                    continue;
+                }
+
+                size_t fullHash = getSlotHash(ctrl_, slots_, capacity_, i);
+                size_t group = h1(fullHash) & mask;
+                Prober prober {group};
+                while (true)
+                {
+                    Group<Backend> g {Layout::ctrlAt(ctrl_, group * LANE_COUNT)};
+                    if (Backend::any(g.matchEmptyOrDeleted()))
+                    {
+                        break;
+                    }
+                    group = prober.nextGroup(group, mask);
+                }
+
+                // Probing stops at the element's own group, so it can stay where it is.
+                if (group == i / LANE_COUNT)
+                {
+                    *Layout::ctrlAt(ctrl_, i) = h2(fullHash);
+                    ++i;
+                    continue;
+                }
+
+                Group<Backend> g {Layout::ctrlAt(ctrl_, group * LANE_COUNT)};
+                size_t target = group * LANE_COUNT + *Backend::firstTrue(g.matchEmptyOrDeleted());
+                if (*Layout::ctrlAt(ctrl_, target) == empty)
+                {
+                    transferSlot(*Layout::slotAt(slots_, target), *Layout::slotAt(slots_, i));
+                    *Layout::ctrlAt(ctrl_, target) = h2(fullHash);
+                    *Layout::ctrlAt(ctrl_, i) = empty;
+                    ++i;
+                }
+                else
+                {
+                    // The target holds another unplaced element: swap and process
+                    // the element that now lives in slot i.
+                    Slot<T, HashStoragePolicy> temp;
+                    transferSlot(temp, *Layout::slotAt(slots_, target));
+                    transferSlot(*Layout::slotAt(slots_, target), *Layout::slotAt(slots_, i));
+                    transferSlot(*Layout::slotAt(slots_, i), temp);
+                    *Layout::ctrlAt(ctrl_, target) = h2(fullHash);
+                }
             }
-        }
 
-        /// Extracts the upper bits for group selection.
-        static constexpr size_t h1(size_t hash) noexcept { return hash >> 7; }
-        /// Extracts the lower 7 bits for control byte matching.
-        static constexpr ctrl_t h2(size_t hash) noexcept { return hash & 0x7F; }
+            used_ = size_;
+        }
 
-        /// Get hash value (stored or recomputed)
-        [[nodiscard]] size_t getSlotHash(Slot<T, HashStoragePolicy> const& slot) const
+        /// Moves the element (and its cached hash, if any) from src into the raw
+        /// storage of dst, leaving src unconstructed.
+        void transferSlot(Slot<T, HashStoragePolicy>& dst, Slot<T, HashStoragePolicy>& src)
         {
-            if constexpr (std::is_same_v<HashStoragePolicy, StoreHashTag>)
+            if constexpr (std::is_trivially_copyable_v<T>)
             {
-                return slot.hash;
+                // Fast path: direct memcpy for trivially copyable types
+                std::memcpy(dst.storage, src.storage, sizeof(T));
             }
             else
             {
-                return Policy::apply(hasher_(*slot.element()));
+                // Standard path: move construct and destroy
+                AllocTraits::construct(alloc_, dst.element(), std::move(*src.element()));
+                AllocTraits::destroy(alloc_, src.element());
             }
-        }
-
-        /// Store hash if policy requires
-        void setSlotHash(Slot<T, HashStoragePolicy>& slot, size_t hash) noexcept
-        {
             if constexpr (std::is_same_v<HashStoragePolicy, StoreHashTag>)
             {
-                slot.hash = hash;
+                dst.hash = src.hash;
             }
-            // NoStoreHashTag: no-op, optimized away by compiler
-        }
-
-        iterator iteratorAt(size_t offset) noexcept { return {ctrl_ + offset, slots_ + offset}; }
-        const_iterator iteratorAt(size_t offset) const noexcept
-        {
-            return iterator {(ctrl_ + offset),
-                             const_cast<Slot<T, HashStoragePolicy>*>(slots_ + offset)};
         }
 
-        using Layout = TableLayout<T, LANE_COUNT, HashStoragePolicy>;
-
-        size_t size_ = 0;
-        size_t used_ = 0;
-        size_t capacity_ = 0;
-        size_t ctrlLen_ = 0;
-        size_t groups_ = 0;
-        [[no_unique_address]] Allocator alloc_;
-        [[no_unique_address]] ByteAlloc byte_alloc_;  // Rebound allocator for buffer
-        [[no_unique_address]] Hash hasher_;
-        [[no_unique_address]] Equal equal_;
-        std::byte* buffer_ = nullptr;  // Single co-located allocation
-        ctrl_t* ctrl_ = nullptr;  // Points into buffer_
-        Slot<T, HashStoragePolicy>* slots_ = nullptr;  // Points into buffer_ after ctrl
-
-      private:
-        /// Finds the smallest n such that 16 * n >= count + 1
-        /// with n being a power of 2.
-        static size_t findSmallestN(size_t count)
+        /// Moves a mapped value into the raw storage at dst, leaving src unconstructed.
+        template<typename M>
+        void transferMapped(M& dst, M& src)
         {
-            size_t min_capacity = count + 1;
-            return std::bit_ceil((min_capacity + LANE_COUNT - 1) / LANE_COUNT);
+            if constexpr (std::is_trivially_copyable_v<M>)
+            {
+                std::memcpy(static_cast<void*>(&dst), &src, sizeof(M));
+            }
+            else
+            {
+                AllocTraits::construct(alloc_, &dst, std::move(src));
+                AllocTraits::destroy(alloc_, &src);
+            }
         }
 
         void rehashImpl(size_t newGroupCount)
         {
+            finishMigration();
+
             auto count = LANE_COUNT * newGroupCount;
             auto newCapacity = count - 1;
 
@@ -932,63 +2520,44 @@ namespace alp
             auto* newSlots = reinterpret_cast<Slot<T, HashStoragePolicy>*>(
                 newBuffer + Layout::slotsOffset(count));
 
-            std::memset(newCtrl, static_cast<ctrl_t>(Ctrl::Empty), newCapacity);
-            newCtrl[newCapacity] = static_cast<ctrl_t>(Ctrl::Sentinel);
-
-            size_t mask = newGroupCount - 1;
+            Layout::initCtrl(newCtrl, newCapacity, count);
 
-            auto insertUnchecked = [&](Slot<T, HashStoragePolicy>& oldSlot)
+            if (capacity_ > 0)
             {
-                // Get hash (stored or recomputed)
-                size_t fullHash = getSlotHash(oldSlot);
-                auto h1Val = h1(fullHash);
-                auto h2Val = h2(fullHash);
-                size_t group = h1Val & mask;
-                Prober prober {group};
-
-                while (true)
+                size_t partitions =
+                    std::bit_floor(std::min<size_t>(rehashThreads_, newGroupCount));
+                if (rehashNothrow && partitions > 1 && size_ >= parallelRehashMinSize)
                 {
-                    Group<Backend> g {newCtrl + group * LANE_COUNT};
-                    auto emptyMask = g.matchEmpty();
-
-                    auto emptyIdx = Backend::firstTrue(emptyMask);
-                    if (emptyIdx)
+                    try
                     {
-                        int offset = static_cast<int>(*emptyIdx);
-                        size_t idx = group * LANE_COUNT + offset;
-
-                        if constexpr (std::is_trivially_copyable_v<T>)
-                        {
-                            // Fast path: direct memcpy for trivially copyable types
-                            std::memcpy(newSlots[idx].storage, oldSlot.storage, sizeof(T));
-                        }
-                        else
-                        {
-                            // Standard path: move construct and destroy
-                            AllocTraits::construct(
-                                alloc_, newSlots[idx].element(), std::move(*oldSlot.element()));
-                            AllocTraits::destroy(alloc_, oldSlot.element());
-                        }
-                        setSlotHash(newSlots[idx], fullHash);  // Store hash if policy requires
-                        newCtrl[idx] = h2Val;
-                        return;
+                        rehashParallel(newCtrl, newSlots, newGroupCount, partitions);
+                    }
+                    catch (...)
+                    {
+                        deallocateBuffer(newBuffer, count, newCapacity);
+                        throw;
                     }
-
-                    group = prober.nextGroup(group, mask);
                 }
-            };
-
-            if (capacity_ > 0)
-            {
-                for (size_t gIdx = 0; gIdx < groups_; ++gIdx)
+                else
                 {
-                    Group<Backend> g {ctrl_ + gIdx * LANE_COUNT};
-                    auto fullMask = g.matchFull();
-
-                    for (int i : Backend::iterate(fullMask))
+                    for (size_t gIdx = 0; gIdx < groups_; ++gIdx)
                     {
-                        size_t oldIdx = gIdx * LANE_COUNT + i;
-                        insertUnchecked(slots_[oldIdx]);
+                        Group<Backend> g {Layout::ctrlAt(ctrl_, gIdx * LANE_COUNT)};
+                        auto fullMask = g.matchFull();
+
+                        for (int i : Backend::iterate(fullMask))
+                        {
+                            size_t oldIdx = gIdx * LANE_COUNT + i;
+                            placeInGroups(newCtrl,
+                                          newSlots,
+                                          newGroupCount - 1,
+                                          0,
+                                          newGroupCount,
+                                          slots_,
+                                          capacity_,
+                                          oldIdx,
+                                          getSlotHash(ctrl_, slots_, capacity_, oldIdx));
+                        }
                     }
                 }
 
@@ -1004,6 +2573,181 @@ namespace alp
             used_ = size_;
         }
 
+        /// Moves the element at oldIdx of the old buffer, whose hash is fullHash, to the first
+        /// empty slot on its probe sequence in the new arrays, as long as that sequence stays
+        /// within groups [first, last). Returns false, leaving the element in place, if it
+        /// would leave them.
+        bool placeInGroups(ctrl_t* newCtrl,
+                           Slot<T, HashStoragePolicy>* newSlots,
+                           size_t mask,
+                           size_t first,
+                           size_t last,
+                           Slot<T, HashStoragePolicy>* oldSlots,
+                           size_t oldCapacity,
+                           size_t oldIdx,
+                           size_t fullHash)
+        {
+            size_t group = h1(fullHash) & mask;
+            Prober prober {group};
+
+            while (group >= first && group < last)
+            {
+                Group<Backend> g {Layout::ctrlAt(newCtrl, group * LANE_COUNT)};
+                auto emptyIdx = Backend::firstTrue(g.matchEmpty());
+                if (emptyIdx)
+                {
+                    size_t idx = group * LANE_COUNT + static_cast<int>(*emptyIdx);
+                    size_t newCapacity = (mask + 1) * LANE_COUNT - 1;
+                    transferSlot(*Layout::slotAt(newSlots, idx), *Layout::slotAt(oldSlots, oldIdx));
+                    if constexpr (hasMapped)
+                    {
+                        transferMapped(Layout::mapped(newSlots, newCapacity)[idx],
+                                       Layout::mapped(oldSlots, oldCapacity)[oldIdx]);
+                    }
+                    setSlotHash(newSlots, newCapacity, idx, fullHash);
+                    *Layout::ctrlAt(newCtrl, idx) = h2(fullHash);
+                    return true;
+                }
+                group = prober.nextGroup(group, mask);
+            }
+            return false;
+        }
+
+        /// Rehash step of rehashImpl for large tables, using one thread per partition.
+        /// The new groups are split into partitions by the high bits of the home group,
+        /// so each thread writes only to its own range of the new arrays:
+        /// 1. Each thread scans a slice of the old groups and buckets the indices of the
+        ///    elements it finds by destination partition.
+        /// 2. Each thread places the elements bucketed for its partition. Elements whose
+        ///    probe sequence would leave the partition are kept back in the bucket.
+        /// 3. The calling thread places the elements kept back.
+        /// Placement leaves every element after only full groups on its probe sequence,
+        /// so the result is as valid as a serial rehash, if laid out differently.
+        /// Needs temporary memory of one index per element.
+        void rehashParallel(ctrl_t* newCtrl,
+                            Slot<T, HashStoragePolicy>* newSlots,
+                            size_t newGroupCount,
+                            size_t partitions)
+        {
+            size_t mask = newGroupCount - 1;
+            size_t groupsPerPartition = newGroupCount / partitions;
+            auto shift = std::countr_zero(groupsPerPartition);
+
+            // buckets[source * partitions + destination]
+            std::vector<std::vector<size_t>> buckets(partitions * partitions);
+            std::vector<std::exception_ptr> errors(partitions);
+
+            runOnThreads(partitions,
+                         [&](size_t source)
+                         {
+                             try
+                             {
+                                 auto* row = buckets.data() + source * partitions;
+                                 for (size_t p = 0; p < partitions; ++p)
+                                 {
+                                     row[p].reserve(size_ / partitions / partitions * 9 / 8);
+                                 }
+                                 size_t firstGroup = groups_ * source / partitions;
+                                 size_t lastGroup = groups_ * (source + 1) / partitions;
+                                 for (size_t gIdx = firstGroup; gIdx < lastGroup; ++gIdx)
+                                 {
+                                     Group<Backend> g {Layout::ctrlAt(ctrl_, gIdx * LANE_COUNT)};
+                                     for (int i : Backend::iterate(g.matchFull()))
+                                     {
+                                         size_t oldIdx = gIdx * LANE_COUNT + i;
+                                         size_t home =
+                                             h1(getSlotHash(ctrl_, slots_, capacity_, oldIdx))
+                                             & mask;
+                                         row[home >> shift].push_back(oldIdx);
+                                     }
+                                 }
+                             }
+                             catch (...)
+                             {
+                                 errors[source] = std::current_exception();
+                             }
+                         });
+            for (auto& error : errors)
+            {
+                if (error)
+                {
+                    std::rethrow_exception(error);
+                }
+            }
+
+            // Nothing below allocates; kept back elements are compacted into their bucket.
+            runOnThreads(partitions,
+                         [&](size_t destination)
+                         {
+                             size_t first = destination * groupsPerPartition;
+                             size_t last = first + groupsPerPartition;
+                             for (size_t source = 0; source < partitions; ++source)
+                             {
+                                 auto& bucket = buckets[source * partitions + destination];
+                                 size_t keptBack = 0;
+                                 for (size_t oldIdx : bucket)
+                                 {
+                                     size_t hash = getSlotHash(ctrl_, slots_, capacity_, oldIdx);
+                                     if (!placeInGroups(newCtrl,
+                                                        newSlots,
+                                                        mask,
+                                                        first,
+                                                        last,
+                                                        slots_,
+                                                        capacity_,
+                                                        oldIdx,
+                                                        hash))
+                                     {
+                                         bucket[keptBack++] = oldIdx;
+                                     }
+                                 }
+                                 bucket.resize(keptBack);
+                             }
+                         });
+
+            for (auto& bucket : buckets)
+            {
+                for (size_t oldIdx : bucket)
+                {
+                    placeInGroups(newCtrl,
+                                  newSlots,
+                                  mask,
+                                  0,
+                                  newGroupCount,
+                                  slots_,
+                                  capacity_,
+                                  oldIdx,
+                                  getSlotHash(ctrl_, slots_, capacity_, oldIdx));
+                }
+            }
+        }
+
+        /// Calls fn(i) for every i in [0, count), each on its own thread, and waits for all.
+        /// Index 0, and any index whose thread cannot be started, runs on the calling thread.
+        template<typename F>
+        static void runOnThreads(size_t count, F const& fn)
+        {
+            std::vector<std::jthread> workers;
+            workers.reserve(count - 1);
+            size_t started = 1;
+            try
+            {
+                for (; started < count; ++started)
+                {
+                    workers.emplace_back([&fn, started] { fn(started); });
+                }
+            }
+            catch (std::system_error const&)
+            {
+                // Out of threads: the remaining indices run here instead
+            }
+            fn(0);
+            for (size_t i = started; i < count; ++i)
+            {
+                fn(i);
+            }
+        }
+
         /// Allocates a combined buffer for ctrl + slots using the allocator.
         std::byte* allocateBuffer(size_t ctrlLen, size_t capacity)
         {
@@ -1011,10 +2755,54 @@ namespace alp
             return ByteAllocTraits::allocate(byte_alloc_, size);
         }
 
+        /// Checks a buffer read by loadFrom: the control bytes must agree with the size and
+        /// the sentinels, and the first few elements must match their hashes.
+        [[nodiscard]] bool loadedBufferConsistent() const
+        {
+            size_t full = 0;
+            size_t deleted = 0;
+            size_t hashesChecked = 0;
+            for (size_t gIdx = 0; gIdx < groups_; ++gIdx)
+            {
+                Group<Backend> g {Layout::ctrlAt(ctrl_, gIdx * LANE_COUNT)};
+                for (int i : Backend::iterate(
+                         Backend::match(g.data, static_cast<ctrl_t>(Ctrl::Deleted))))
+                {
+                    deleted += gIdx * LANE_COUNT + i < capacity_;
+                }
+                for (int i : Backend::iterate(g.matchFull()))
+                {
+                    size_t idx = gIdx * LANE_COUNT + i;
+                    ++full;
+                    if (hashesChecked < LANE_COUNT)
+                    {
+                        // Fragments only keep the low 32 bits of h1
+                        ++hashesChecked;
+                        size_t hash =
+                            Policy::apply(hasher_(*Layout::slotAt(slots_, idx)->element()));
+                        auto storedH1 = h1(getSlotHash(ctrl_, slots_, capacity_, idx));
+                        if (idx >= capacity_ || *Layout::ctrlAt(ctrl_, idx) != h2(hash)
+                            || static_cast<uint32_t>(storedH1) != static_cast<uint32_t>(h1(hash)))
+                        {
+                            return false;
+                        }
+                    }
+                }
+            }
+            for (size_t idx = capacity_; idx < ctrlLen_; ++idx)
+            {
+                if (*Layout::ctrlAt(ctrl_, idx) != static_cast<ctrl_t>(Ctrl::Sentinel))
+                {
+                    return false;
+                }
+            }
+            return full == size_ && full + deleted == used_;
+        }
+
         /// Deallocates the combined buffer.
         void deallocateBuffer(std::byte* buffer, size_t ctrlLen, size_t capacity)
         {
-            if (buffer)
+            if (buffer && buffer != inlineBytes())
             {
                 auto size = Layout::bufferSize(ctrlLen, capacity);
                 ByteAllocTraits::deallocate(byte_alloc_, buffer, size);
@@ -1032,7 +2820,9 @@ namespace alp
                     typename Allocator = std::allocator<std::byte>,
                     typename LoadFactorRatio = typename DefaultLoadFactorSelector<Backend>::type,
                     typename HashStoragePolicy = typename HashStorageSelector<T>::type,
-                    typename Prober = DefaultProber>
+                    typename Prober = DefaultProber,
+                    ShrinkPolicy Shrink = DefaultShrinkPolicy,
+                    typename CtrlLayout = ContiguousCtrlTag>
         requires std::move_constructible<T>
     class Set
         : Table<T,
@@ -1043,7 +2833,10 @@ namespace alp
                 Allocator,
                 LoadFactorRatio,
                 HashStoragePolicy,
-                Prober>
+                Prober,
+                Shrink,
+                void,
+                CtrlLayout>
     {
         using Base = Table<T,
                            Hash,
@@ -1053,7 +2846,10 @@ namespace alp
                            Allocator,
                            LoadFactorRatio,
                            HashStoragePolicy,
-                           Prober>;
+                           Prober,
+                           Shrink,
+                           void,
+                           CtrlLayout>;
 
       public:
         using value_type = T;
@@ -1066,13 +2862,19 @@ namespace alp
         using pointer = value_type*;
         using const_pointer = value_type const*;
 
-        using iterator = SetIterator<T const, Backend, HashStoragePolicy>;
-        using const_iterator = SetIterator<T const, Backend, HashStoragePolicy>;
+        using iterator = SetIterator<T const, Backend, HashStoragePolicy, CtrlLayout>;
+        using const_iterator = SetIterator<T const, Backend, HashStoragePolicy, CtrlLayout>;
 
         using Base::Base;
+        using Base::capacity;
         using Base::clear;
         using Base::empty;
+        using Base::incremental_rehash;
+        using Base::rehash_threads;
         using Base::reserve;
+        using Base::set_incremental_rehash;
+        using Base::set_rehash_threads;
+        using Base::shrink_to_fit;
         using Base::size;
         using Base::swap;
 
@@ -1090,6 +2892,16 @@ namespace alp
         {
         }
 
+        /// Constructs the set from the elements of range, sizing it once up front
+        /// when the length of the range is known.
+        template<std::ranges::input_range R>
+            requires std::constructible_from<T, std::ranges::range_reference_t<R>>
+        Set(std::from_range_t, R&& range, Allocator const& alloc = Allocator())
+            : Base(alloc)
+        {
+            insert_range(std::forward<R>(range));
+        }
+
         iterator begin() { return Base::begin(); }
         iterator end() { return Base::end(); }
         const_iterator begin() const { return Base::begin(); }
@@ -1127,11 +2939,111 @@ namespace alp
             return find(key) != end();
         }
 
+        /// Returns a copy of the hasher. Its output for a key is what the *_with_hash
+        /// functions expect, so a key can be hashed once and then used with several
+        /// tables sharing the same hasher.
+        hasher hash_function() const { return this->hasher_; }
+
+        /// Like find(key), but with hash = hash_function()(key) precomputed by the caller.
+        template<typename K>
+            requires std::is_same_v<std::remove_cvref_t<K>, T>
+            || requires { typename Hash::is_transparent; }
+        [[nodiscard]] iterator find_with_hash(K const& key, size_t hash)
+        {
+            size_t idx = Base::find_internal(key, Policy::apply(hash));
+            if (idx == this->ctrlLen_)
+                return end();
+            return Base::iteratorAt(idx);
+        }
+
+        template<typename K>
+            requires std::is_same_v<std::remove_cvref_t<K>, T>
+            || requires { typename Hash::is_transparent; }
+        [[nodiscard]] const_iterator find_with_hash(K const& key, size_t hash) const
+        {
+            size_t idx = Base::find_internal(key, Policy::apply(hash));
+            if (idx == this->ctrlLen_)
+                return end();
+            return Base::iteratorAt(idx);
+        }
+
+        template<typename K>
+            requires std::is_same_v<std::remove_cvref_t<K>, T>
+            || requires { typename Hash::is_transparent; }
+        bool contains_with_hash(K const& key, size_t hash) const
+        {
+            return find_with_hash(key, hash) != end();
+        }
+
+        /// Looks up all keys at once, storing a pointer to each key's element in out
+        /// (nullptr if absent). Faster than repeated find() on tables that do not fit
+        /// in cache, since the memory accesses of the lookups are overlapped.
+        /// out must hold at least keys.size() entries.
+        void find_many(std::span<T const> keys, std::span<T const*> out) const
+        {
+            assert(out.size() >= keys.size());
+            Base::find_many_internal(keys,
+                                     [&](size_t i, size_t idx)
+                                     {
+                                         out[i] = idx == this->ctrlLen_
+                                             ? nullptr
+                                             : this->slotAt(idx)->element();
+                                     });
+        }
+
+        /// Looks up all keys at once, storing whether each is present in out.
+        /// Returns the number of keys found. out must hold at least keys.size() entries.
+        size_type contains_many(std::span<T const> keys, std::span<bool> out) const
+        {
+            assert(out.size() >= keys.size());
+            size_type found = 0;
+            Base::find_many_internal(keys,
+                                     [&](size_t i, size_t idx)
+                                     {
+                                         out[i] = idx != this->ctrlLen_;
+                                         found += out[i];
+                                     });
+            return found;
+        }
+
+        /// Constructs an element from args if no equal element exists.
+        /// When given a single T, it is hashed and probed for directly and only
+        /// copied or moved into the table on a miss; other arguments construct
+        /// a temporary first.
         template<typename... Args>
         std::pair<iterator, bool> emplace(Args&&... args)
         {
-            auto [idx, success] = Base::emplace_wrapper(std::forward<Args>(args)...);
-            return {Base::iteratorAt(idx), success};
+            if constexpr (sizeof...(Args) == 1
+                          && (std::is_same_v<std::remove_cvref_t<Args>, T> && ...))
+            {
+                auto [idx, success] = Base::emplace_key(args..., std::forward<Args>(args)...);
+                return {Base::iteratorAt(idx), success};
+            }
+            else
+            {
+                auto [idx, success] = Base::emplace_wrapper(std::forward<Args>(args)...);
+                return {Base::iteratorAt(idx), success};
+            }
+        }
+
+        /// Like emplace(args...), but with hash = hash_function()(element) precomputed
+        /// by the caller for the element that args construct.
+        template<typename... Args>
+        std::pair<iterator, bool> emplace_with_hash(size_t hash, Args&&... args)
+        {
+            if constexpr (sizeof...(Args) == 1
+                          && (std::is_same_v<std::remove_cvref_t<Args>, T> && ...))
+            {
+                auto [idx, success] = Base::emplace_internal(
+                    args..., Policy::apply(hash), std::forward<Args>(args)...);
+                return {Base::iteratorAt(idx), success};
+            }
+            else
+            {
+                auto [idx, success] =
+                    Base::emplace_wrapper_hashed(Policy::apply(hash), std::forward<Args>(args)...);
+                return {Base::iteratorAt(idx), success};
+            }
         }
 
         /// Inserts the given value into the set.
@@ -1144,10 +3056,21 @@ namespace alp
         /// whether insertion took place (true) or the element already existed (false).
         std::pair<iterator, bool> insert(T&& value) { return emplace(std::move(value)); }
 
+        /// Inserts every element of range, skipping those already present.
+        /// The table is grown once when the length of the range is known, and
+        /// elements are hashed and prefetched in batches before being inserted.
+        template<std::ranges::input_range R>
+            requires std::constructible_from<T, std::ranges::range_reference_t<R>>
+        void insert_range(R&& range)
+        {
+            Base::insert_range_internal(std::forward<R>(range));
+        }
+
+        /// Erases the element at pos. Erasing never rebuilds the table, so iterators to
+        /// other elements stay valid.
         void erase(const_iterator pos)
         {
-            size_t offset = pos.ctrl - this->ctrl_;
-            Base::erase_slot(offset);
+            Base::erase_slot(Base::indexOf(pos));
         }
 
         size_type erase(T const& key)
@@ -1181,6 +3104,71 @@ namespace alp
             return std::unexpected(Error::NotFound);
         }
 
+        /// Writes the set in a binary format that load() restores without rehashing: a
+        /// header describing the table's type, followed by its buffer, verbatim. Only for
+        /// trivially copyable elements; the file is specific to the machine's byte order.
+        std::expected<void, Error> save(std::ostream& out) const
+            requires Base::serializable
+        {
+            return Base::saveTo(out, hashSeedOf<Hash>());
+        }
+
+        std::expected<void, Error> save(std::filesystem::path const& path) const
+            requires Base::serializable
+        {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            if (!out)
+            {
+                return std::unexpected(Error::IoFailure);
+            }
+            auto saved = save(out);
+            out.close();
+            if (saved && !out)
+            {
+                return std::unexpected(Error::IoFailure);
+            }
+            return saved;
+        }
+
+        /// Reads a set written by save() by the same Set type, with a single read of
+        /// its buffer. Fails with Error::IncompatibleFormat if the data was written by
+        /// another type or with another hash function, or is corrupt.
+        static std::expected<Set, Error> load(std::istream& in,
+                                            Allocator const& alloc = Allocator())
+            requires Base::serializable
+        {
+            Set result(alloc);
+            if (auto loaded = result.loadFrom(in, hashSeedOf<Hash>()); !loaded)
+            {
+                return std::unexpected(loaded.error());
+            }
+            return result;
+        }
+
+        static std::expected<Set, Error> load(std::filesystem::path const& path,
+                                            Allocator const& alloc = Allocator())
+            requires Base::serializable
+        {
+            std::ifstream in(path, std::ios::binary);
+            if (!in)
+            {
+                return std::unexpected(Error::IoFailure);
+            }
+            return load(in, alloc);
+        }
+
         friend void swap(Set& lhs, Set& rhs) noexcept { lhs.swap(rhs); }
+
+      protected:
+        /// Like find_with_hash, but for readers that race with a writer and validate the
+        /// result against a sequence counter, as ConcurrentSet does with OptimisticReadsTag.
+        /// Only safe under the conditions of Table::find_optimistic, so it is left to
+        /// derived classes that provide them.
+        template<typename K, typename F>
+        [[nodiscard]] T const* find_optimistic(K const& key, size_t hash, F&& snapshotValid) const
+        {
+            return Base::find_optimistic(
+                key, Policy::apply(hash), std::forward<F>(snapshotValid));
+        }
     };
 }  // namespace alp
@@ -2,6 +2,10 @@ export module alp;
 
 export import :set;
 export import :map;
+export import :node;
+export import :concurrent;
+export import :mapped;
+export import :perfect;
 export import :rapid_hash;
 
 // Export backend interface partitions
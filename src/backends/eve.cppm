@@ -60,6 +60,13 @@ namespace alp
             return reg == static_cast<std::uint8_t>(0x80);
         }
 
+        /// Match all lanes marked as empty (0x80) or deleted (0xFE).
+        static Mask matchEmptyOrDeleted(Register reg) noexcept
+        {
+            return (reg == static_cast<std::uint8_t>(0x80))  // Empty
+                || (reg == static_cast<std::uint8_t>(0xFE));  // Deleted
+        }
+
         /// Match all lanes that contain a value (not empty, deleted, or sentinel).
         static Mask matchFull(Register reg) noexcept
         {
@@ -56,6 +56,14 @@ namespace alp
             return static_cast<Mask>(_mm_movemask_epi8(matched));
         }
 
+        static Mask matchEmptyOrDeleted(Register reg) noexcept
+        {
+            // Compared explicitly, since other special bytes (such as Handoff) are not free
+            auto empty = _mm_cmpeq_epi8(reg, _mm_set1_epi8(static_cast<char>(0x80)));
+            auto deleted = _mm_cmpeq_epi8(reg, _mm_set1_epi8(static_cast<char>(0xFE)));
+            return static_cast<Mask>(_mm_movemask_epi8(_mm_or_si128(empty, deleted)));
+        }
+
         static Mask matchFull(Register reg) noexcept
         {
             return (~static_cast<Mask>(_mm_movemask_epi8(reg))) & 0xFFFF;
@@ -80,6 +80,13 @@ namespace alp
         /// Match all lanes marked as empty (0x80).
         static Mask matchEmpty(Register reg) { return reg == static_cast<std::uint8_t>(0x80); }
 
+        /// Match all lanes marked as empty (0x80) or deleted (0xFE).
+        static Mask matchEmptyOrDeleted(Register reg)
+        {
+            return (reg == 0x80)  // Empty
+                || (reg == 0xFE);  // Deleted
+        }
+
         /// Match all lanes that contain a value (not empty, deleted, or sentinel).
         static Mask matchFull(Register reg)
         {
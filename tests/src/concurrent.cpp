@@ -0,0 +1,506 @@
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+import alp;
+
+namespace
+{
+    constexpr int threadCount = 8;
+
+    /// Runs fn(t) on threadCount threads and waits for all of them.
+    template<typename F>
+    void runThreads(F fn)
+    {
+        std::vector<std::jthread> threads;
+        for (int t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back(fn, t);
+        }
+    }
+
+    /// A value whose halves are written together, so that a torn read is detectable.
+    struct Checked
+    {
+        int64_t value;
+        int64_t negated;
+    };
+
+    /// A count whose sum throws when a negative count is added.
+    struct Count
+    {
+        int n = 0;
+
+        friend Count operator+(Count a, Count b)
+        {
+            if (b.n < 0)
+            {
+                throw std::runtime_error("negative count");
+            }
+            return {a.n + b.n};
+        }
+    };
+
+    template<typename Key, typename Value>
+    using OptimisticMap =
+        alp::ConcurrentMap<Key,
+                           Value,
+                           alp::RapidHasher,
+                           std::equal_to<Key>,
+                           typename alp::HashPolicySelector<Key, alp::RapidHasher>::type,
+                           alp::DefaultBackend,
+                           std::allocator<std::byte>,
+                           alp::DefaultLoadFactorSelector<alp::DefaultBackend>::type,
+                           typename alp::HashStorageSelector<std::pair<Key const, Value>>::type,
+                           alp::DefaultProber,
+                           alp::DefaultShrinkPolicy,
+                           alp::OptimisticReadsTag>;
+
+    template<typename T>
+    using OptimisticSet =
+        alp::ConcurrentSet<T,
+                           alp::RapidHasher,
+                           std::equal_to<T>,
+                           typename alp::HashPolicySelector<T, alp::RapidHasher>::type,
+                           alp::DefaultBackend,
+                           std::allocator<std::byte>,
+                           alp::DefaultLoadFactorSelector<alp::DefaultBackend>::type,
+                           typename alp::HashStorageSelector<T>::type,
+                           alp::DefaultProber,
+                           alp::DefaultShrinkPolicy,
+                           alp::OptimisticReadsTag>;
+}  // namespace
+
+TEST(ConcurrentMap, ParallelCountingSeesEveryIncrement)
+{
+    alp::ConcurrentMap<int, int> m(16);
+    EXPECT_EQ(m.shard_count(), 16);
+    runThreads(
+        [&](int)
+        {
+            for (int i = 0; i < 5000; ++i)
+            {
+                m.insert_or_visit({i % 1000, 1}, [](auto& element) { ++element.second; });
+            }
+        });
+
+    EXPECT_EQ(m.size(), 1000);
+    for (int i = 0; i < 1000; ++i)
+    {
+        int count = 0;
+        ASSERT_TRUE(m.cvisit(i, [&](auto const& element) { count = element.second; }));
+        ASSERT_EQ(count, 5 * threadCount) << "Key: " << i;
+    }
+    EXPECT_FALSE(m.cvisit(1000, [](auto const&) {}));
+}
+
+TEST(ConcurrentMap, MixedOperations)
+{
+    alp::ConcurrentMap<std::string, int> m;
+    std::atomic<int> inserted = 0;
+    runThreads(
+        [&](int t)
+        {
+            for (int i = 0; i < 2000; ++i)
+            {
+                auto key = std::to_string(t * 2000 + i);
+                inserted += m.try_emplace(key, i);
+                m.visit(key, [](auto& element) { element.second *= 2; });
+                if (i % 2 == 0)
+                {
+                    EXPECT_EQ(m.erase(key), 1);
+                }
+                // Reads of other threads' keys race with their writes
+                m.contains(std::to_string(((t + 1) % threadCount) * 2000 + i));
+            }
+        });
+
+    EXPECT_EQ(inserted, threadCount * 2000);
+    EXPECT_EQ(m.size(), threadCount * 1000);
+    long sum = 0;
+    m.cvisit_all([&](auto const& element) { sum += element.second; });
+    EXPECT_EQ(sum, threadCount * 2L * (1000L * 1000));
+
+    EXPECT_FALSE(m.insert_or_assign("1", 7));
+    EXPECT_TRUE(m.cvisit("1", [](auto const& element) { EXPECT_EQ(element.second, 7); }));
+    m.clear();
+    EXPECT_TRUE(m.empty());
+}
+
+TEST(ConcurrentSet, ParallelInsertDeduplicates)
+{
+    alp::ConcurrentSet<int> s(1);
+    s.reserve(10000);
+    std::atomic<int> inserted = 0;
+    std::atomic<int> duplicates = 0;
+    runThreads(
+        [&](int)
+        {
+            for (int i = 0; i < 10000; ++i)
+            {
+                if (s.insert_or_visit(i, [&](int) { ++duplicates; }))
+                {
+                    ++inserted;
+                }
+            }
+        });
+
+    EXPECT_EQ(inserted, 10000);
+    EXPECT_EQ(duplicates, (threadCount - 1) * 10000);
+    EXPECT_EQ(s.size(), 10000);
+    EXPECT_TRUE(s.visit(42, [](int v) { EXPECT_EQ(v, 42); }));
+    EXPECT_EQ(s.erase(42), 1);
+    EXPECT_FALSE(s.contains(42));
+}
+
+TEST(ConcurrentMap, OptimisticReadsNeverSeeTornValues)
+{
+    // A single shard, so that every write races with every read
+    OptimisticMap<int, Checked> m(1);
+    constexpr int keyCount = 20000;
+    runThreads(
+        [&](int t)
+        {
+            for (int i = 0; i < keyCount; ++i)
+            {
+                if (t % 2 == 0)
+                {
+                    // Writers grow the table and overwrite each other's values
+                    int64_t value = t * keyCount + i;
+                    m.insert_or_assign(i, Checked {value, -value});
+                    if (i % 16 == 0)
+                    {
+                        m.erase(i / 2);
+                    }
+                }
+                else
+                {
+                    m.cvisit(i / 2,
+                             [](auto const& element)
+                             { ASSERT_EQ(element.second.value, -element.second.negated); });
+                    m.contains(i);
+                }
+            }
+        });
+
+    for (int i = keyCount / 2; i < keyCount; ++i)
+    {
+        ASSERT_TRUE(m.contains(i)) << "Key: " << i;
+        EXPECT_TRUE(m.cvisit(i,
+                             [&](auto const& element)
+                             {
+                                 EXPECT_EQ(element.first, i);
+                                 EXPECT_EQ(element.second.value % keyCount, i);
+                             }));
+    }
+    m.clear();
+    EXPECT_FALSE(m.contains(keyCount - 1));
+}
+
+TEST(ConcurrentSet, OptimisticReadsFindEveryPublishedElement)
+{
+    OptimisticSet<int64_t> s(2);
+    std::atomic<int64_t> published = 0;
+    runThreads(
+        [&](int t)
+        {
+            if (t == 0)
+            {
+                for (int64_t i = 0; i < 50000; ++i)
+                {
+                    s.insert(i);
+                    published.store(i + 1, std::memory_order_release);
+                }
+                return;
+            }
+            // Elements are never erased, so everything published must be found
+            // however often the table is rehashed underneath
+            while (published.load(std::memory_order_acquire) < 50000)
+            {
+                int64_t count = published.load(std::memory_order_acquire);
+                if (count == 0)
+                {
+                    continue;
+                }
+                int64_t key = (count * 7919 + t) % count;
+                ASSERT_TRUE(s.contains(key)) << "Key: " << key;
+                EXPECT_TRUE(s.visit(key, [&](int64_t v) { EXPECT_EQ(v, key); }));
+                EXPECT_FALSE(s.contains(-1 - key));
+            }
+        });
+    EXPECT_EQ(s.size(), 50000);
+}
+
+TEST(ConcurrentSet, OptimisticReadsSurviveFreedBuffers)
+{
+    // Every round grows the table and then frees its buffer, while readers probe it
+    OptimisticSet<int64_t> s(1);
+    std::atomic<bool> done = false;
+    runThreads(
+        [&](int t)
+        {
+            if (t == 0)
+            {
+                for (int round = 0; round < 200; ++round)
+                {
+                    for (int64_t i = 0; i < 1000; ++i)
+                    {
+                        s.insert(i);
+                    }
+                    s.clear();
+                }
+                done.store(true, std::memory_order_release);
+                return;
+            }
+            for (int64_t i = t; !done.load(std::memory_order_acquire); i += threadCount)
+            {
+                s.contains(i % 1000);
+                ASSERT_FALSE(s.contains(-1 - i));
+            }
+        });
+    EXPECT_TRUE(s.empty());
+}
+
+TEST(SnapshotMap, ReadersSeeWholeVersions)
+{
+    alp::SnapshotMap<int, int> m;
+    constexpr int keyCount = 64;
+    constexpr int versionCount = 300;
+    runThreads(
+        [&](int t)
+        {
+            if (t == 0)
+            {
+                // Every version maps all keys to its generation
+                for (int generation = 1; generation <= versionCount; ++generation)
+                {
+                    m.update(
+                        [&](auto& map)
+                        {
+                            for (int key = 0; key < keyCount; ++key)
+                            {
+                                map.insert_or_assign(key, generation);
+                            }
+                        });
+                }
+                return;
+            }
+            int lastSeen = 0;
+            while (lastSeen < versionCount)
+            {
+                m.read(
+                    [&](auto const& map)
+                    {
+                        if (map.empty())
+                        {
+                            return;
+                        }
+                        ASSERT_EQ(map.size(), keyCount);
+                        int generation = map.find(0)->second;
+                        ASSERT_GE(generation, lastSeen);
+                        for (auto const& [key, value] : map)
+                        {
+                            ASSERT_EQ(value, generation) << "Key: " << key;
+                        }
+                        lastSeen = generation;
+                    });
+            }
+        });
+
+    EXPECT_EQ(m.size(), keyCount);
+    int value = 0;
+    EXPECT_TRUE(m.cvisit(5, [&](auto const& element) { value = element.second; }));
+    EXPECT_EQ(value, versionCount);
+}
+
+TEST(SnapshotMap, SingleUpdatesAndNestedReads)
+{
+    alp::SnapshotMap<std::string, int> m;
+    EXPECT_TRUE(m.empty());
+    EXPECT_TRUE(m.insert_or_assign("a", 1));
+    EXPECT_FALSE(m.insert_or_assign("a", 2));
+    EXPECT_TRUE(m.insert_or_assign("b", 3));
+
+    m.read(
+        [&](auto const& outer)
+        {
+            // A version read from stays valid while newer ones are published
+            EXPECT_EQ(m.erase("a"), 1);
+            EXPECT_EQ(m.erase("a"), 0);
+            EXPECT_FALSE(m.contains("a"));
+            EXPECT_EQ(outer.find("a")->second, 2);
+            EXPECT_EQ(outer.size(), 2);
+        });
+    EXPECT_EQ(m.size(), 1);
+
+    alp::SnapshotMap<std::string, int>::map_type replacement;
+    replacement.emplace("c", 4);
+    m.replace(std::move(replacement));
+    EXPECT_FALSE(m.contains("b"));
+    EXPECT_TRUE(m.contains("c"));
+    m.clear();
+    EXPECT_TRUE(m.empty());
+}
+
+TEST(GrowOnlySet, ParallelInsertAcrossResizes)
+{
+    // Starting from a single group, so that the threads resize it many times
+    alp::GrowOnlySet<int64_t> s;
+    std::atomic<int> inserted = 0;
+    constexpr int64_t perThread = 20000;
+    runThreads(
+        [&](int t)
+        {
+            for (int64_t i = 0; i < perThread; ++i)
+            {
+                // Every key is inserted by two threads
+                int64_t key = (t / 2) * perThread + i;
+                inserted += s.insert(key);
+                ASSERT_TRUE(s.contains(key)) << "Key: " << key;
+                ASSERT_TRUE(s.contains((t / 2) * perThread + i / 2));
+            }
+        });
+
+    EXPECT_EQ(inserted, threadCount / 2 * perThread);
+    EXPECT_EQ(s.size(), threadCount / 2 * perThread);
+    EXPECT_GE(s.capacity(), s.size());
+    int64_t count = 0;
+    int64_t sum = 0;
+    s.for_each(
+        [&](int64_t key)
+        {
+            ++count;
+            sum += key;
+        });
+    int64_t n = threadCount / 2 * perThread;
+    EXPECT_EQ(count, n);
+    EXPECT_EQ(sum, n * (n - 1) / 2);
+    EXPECT_FALSE(s.contains(n));
+}
+
+TEST(GrowOnlySet, StringsAndDuplicates)
+{
+    alp::GrowOnlySet<std::string> s(100);
+    size_t initialCapacity = s.capacity();
+    EXPECT_GE(initialCapacity, 100);
+    EXPECT_TRUE(s.empty());
+    runThreads(
+        [&](int t)
+        {
+            for (int i = 0; i < 3000; ++i)
+            {
+                s.insert(std::to_string((i * (t + 1)) % 3000));
+            }
+        });
+    EXPECT_EQ(s.size(), 3000);
+    EXPECT_GT(s.capacity(), initialCapacity);
+    EXPECT_FALSE(s.insert(std::string("2999")));
+    EXPECT_TRUE(s.contains("0"));
+    EXPECT_FALSE(s.contains("3000"));
+}
+
+TEST(ThreadPerCoreMap, ProducersMergeCounts)
+{
+    // Small rings, so that producers often find them full
+    alp::ThreadPerCoreMap<int, int> m(4, 64, 16);
+    EXPECT_EQ(m.worker_count(), 4);
+    runThreads(
+        [&](int)
+        {
+            auto producer = m.producer();
+            for (int i = 0; i < 5000; ++i)
+            {
+                producer.merge(i % 1000, 1);
+            }
+            producer.flush();
+        });
+
+    EXPECT_EQ(m.size(), 1000);
+    for (int i = 0; i < 1000; ++i)
+    {
+        int count = 0;
+        ASSERT_TRUE(m.cvisit(i, [&](auto const& element) { count = element.second; }));
+        ASSERT_EQ(count, 5 * threadCount) << "Key: " << i;
+    }
+    EXPECT_FALSE(m.cvisit(1000, [](auto const&) {}));
+
+    std::atomic<long> sum = 0;
+    m.visit_shards(
+        [&](auto const& shard)
+        {
+            for (auto const& [key, value] : shard)
+            {
+                sum += value;
+            }
+        });
+    EXPECT_EQ(sum, 5000L * threadCount);
+}
+
+TEST(ThreadPerCoreMap, OperationsApplyInProducerOrder)
+{
+    alp::ThreadPerCoreMap<std::string, std::string> m(2, 1024, 64);
+    auto producer = m.producer();
+    for (int i = 0; i < 500; ++i)
+    {
+        auto key = std::to_string(i);
+        producer.merge(key, "a");
+        producer.merge(key, "b");
+        if (i % 3 == 0)
+        {
+            producer.erase(key);
+        }
+        if (i % 5 == 0)
+        {
+            producer.insert_or_assign(key, "c");
+        }
+    }
+    // Published operations are covered by the barrier, unfinished batches are not
+    producer.send();
+    m.barrier();
+
+    for (int i = 0; i < 500; ++i)
+    {
+        std::string expected = i % 5 == 0 ? "c" : (i % 3 == 0 ? "" : "ab");
+        std::string value;
+        EXPECT_EQ(m.cvisit(std::to_string(i), [&](auto const& element) { value = element.second; }),
+                  !expected.empty());
+        EXPECT_EQ(value, expected) << "Key: " << i;
+    }
+    EXPECT_THROW(m.visit_shards([](auto const&) { throw std::runtime_error("shard"); }),
+                 std::runtime_error);
+    EXPECT_FALSE(m.empty());
+}
+
+TEST(ThreadPerCoreMap, FlushAndBarrierRethrowFailedOperations)
+{
+    alp::ThreadPerCoreMap<int, Count> m(2, 64, 8);
+    auto producer = m.producer();
+    for (int i = 0; i < 100; ++i)
+    {
+        producer.merge(i, Count {1});
+    }
+    producer.merge(7, Count {-1});
+    for (int i = 0; i < 100; ++i)
+    {
+        producer.merge(i, Count {1});
+    }
+    EXPECT_THROW(producer.flush(), std::runtime_error);
+    // Reported once, and the operations around the failed one were applied
+    EXPECT_NO_THROW(producer.flush());
+    for (int i = 0; i < 100; ++i)
+    {
+        int count = 0;
+        ASSERT_TRUE(m.cvisit(i, [&](auto const& element) { count = element.second.n; }));
+        ASSERT_EQ(count, 2) << "Key: " << i;
+    }
+
+    producer.merge(3, Count {-1});
+    producer.send();
+    EXPECT_THROW(m.barrier(), std::runtime_error);
+    EXPECT_NO_THROW(m.barrier());
+}
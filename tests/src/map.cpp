@@ -0,0 +1,517 @@
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+import alp;
+
+namespace
+{
+    // Counts every construction so tests can check when elements are built
+    struct ConstructionCounter
+    {
+        static int constructions;
+        static int copies;
+        static int moves;
+
+        std::string value;
+
+        explicit ConstructionCounter(std::string v)
+            : value(std::move(v))
+        {
+            ++constructions;
+        }
+        ConstructionCounter(ConstructionCounter const& other)
+            : value(other.value)
+        {
+            ++copies;
+        }
+        ConstructionCounter(ConstructionCounter&& other) noexcept
+            : value(std::move(other.value))
+        {
+            ++moves;
+        }
+        ConstructionCounter& operator=(ConstructionCounter const&) = default;
+        ConstructionCounter& operator=(ConstructionCounter&&) noexcept = default;
+        bool operator==(ConstructionCounter const& other) const { return value == other.value; }
+
+        static void reset()
+        {
+            constructions = 0;
+            copies = 0;
+            moves = 0;
+        }
+    };
+    int ConstructionCounter::constructions = 0;
+    int ConstructionCounter::copies = 0;
+    int ConstructionCounter::moves = 0;
+
+    // Counts hash computations to check that operations probe only once
+    int gHashCount = 0;
+    struct CountingHash
+    {
+        size_t operator()(int x) const noexcept
+        {
+            ++gHashCount;
+            return std::hash<int> {}(x);
+        }
+    };
+
+    // Map keeping its values in an array of their own, apart from the keys
+    template<typename Key, typename Value>
+    using SplitMap = alp::Map<Key,
+                              Value,
+                              alp::RapidHasher,
+                              std::equal_to<Key>,
+                              typename alp::HashPolicySelector<Key, alp::RapidHasher>::type,
+                              alp::DefaultBackend,
+                              std::allocator<std::byte>,
+                              alp::DefaultLoadFactorSelector<alp::DefaultBackend>::type,
+                              typename alp::HashStorageSelector<Key>::type,
+                              alp::DefaultProber,
+                              alp::DefaultShrinkPolicy,
+                              alp::SplitLayoutTag>;
+}  // namespace
+
+template<>
+struct std::hash<ConstructionCounter>
+{
+    size_t operator()(ConstructionCounter const& c) const noexcept
+    {
+        return std::hash<std::string> {}(c.value);
+    }
+};
+
+TEST(MapCore, BasicOperations)
+{
+    alp::Map<std::string, int> m;
+    m.emplace(std::string("Alice"), 30);
+    m.insert({"Bob", 25});
+    m["Carol"] = 41;
+    EXPECT_EQ(m.size(), 3);
+    EXPECT_EQ(m.find("Alice")->second, 30);
+    EXPECT_EQ(m["Bob"], 25);
+    EXPECT_TRUE(m.contains("Carol"));
+    EXPECT_FALSE(m.contains("Dave"));
+    EXPECT_EQ(m.erase("Bob"), 1);
+    EXPECT_FALSE(m.contains("Bob"));
+}
+
+TEST(MapEmplace, ExistingKeyDoesNotConstruct)
+{
+    alp::Map<ConstructionCounter, ConstructionCounter> m;
+    m.reserve(16);
+    ConstructionCounter key {"key"};
+    ConstructionCounter value {"value"};
+    m.emplace(key, value);
+
+    ConstructionCounter::reset();
+    auto [it, inserted] = m.emplace(key, value);
+    EXPECT_FALSE(inserted);
+    EXPECT_EQ(it->second.value, "value");
+    EXPECT_EQ(ConstructionCounter::copies, 0);
+    EXPECT_EQ(ConstructionCounter::moves, 0);
+
+    std::pair<ConstructionCounter const, ConstructionCounter> pair {key, value};
+    ConstructionCounter::reset();
+    EXPECT_FALSE(m.insert(pair).second);
+    EXPECT_FALSE(m.emplace(std::piecewise_construct,
+                           std::forward_as_tuple(key),
+                           std::forward_as_tuple("other"))
+                     .second);
+    EXPECT_EQ(ConstructionCounter::constructions, 0);
+    EXPECT_EQ(ConstructionCounter::copies, 0);
+    EXPECT_EQ(ConstructionCounter::moves, 0);
+}
+
+TEST(MapEmplace, MissConstructsInPlace)
+{
+    alp::Map<ConstructionCounter, ConstructionCounter> m;
+    m.reserve(16);
+    ConstructionCounter key {"key"};
+    ConstructionCounter value {"value"};
+
+    // Copied straight into the slot, no temporary pair
+    ConstructionCounter::reset();
+    EXPECT_TRUE(m.emplace(key, value).second);
+    EXPECT_EQ(ConstructionCounter::copies, 2);
+    EXPECT_EQ(ConstructionCounter::moves, 0);
+
+    ConstructionCounter::reset();
+    EXPECT_TRUE(m.emplace(std::piecewise_construct,
+                          std::forward_as_tuple(ConstructionCounter {"other"}),
+                          std::forward_as_tuple("built"))
+                    .second);
+    EXPECT_EQ(ConstructionCounter::constructions, 2);
+    EXPECT_EQ(ConstructionCounter::moves, 1);
+    EXPECT_EQ(m.find(ConstructionCounter {"other"})->second.value, "built");
+}
+
+TEST(MapEmplace, TryEmplace)
+{
+    alp::Map<std::string, ConstructionCounter> m;
+    ConstructionCounter::reset();
+    auto [it, inserted] = m.try_emplace("a", "first");
+    EXPECT_TRUE(inserted);
+    EXPECT_EQ(it->second.value, "first");
+    EXPECT_EQ(ConstructionCounter::constructions, 1);
+
+    // Existing key: the value arguments are not used
+    std::string key = "a";
+    auto [it2, inserted2] = m.try_emplace(std::move(key), "second");
+    EXPECT_FALSE(inserted2);
+    EXPECT_EQ(it2->second.value, "first");
+    EXPECT_EQ(key, "a");
+    EXPECT_EQ(ConstructionCounter::constructions, 1);
+    EXPECT_EQ(m.size(), 1);
+}
+
+TEST(MapEmplace, HeterogeneousArgumentsFallBack)
+{
+    alp::Map<std::string, int> m;
+    // char const* is not a Key, so this constructs the pair first
+    EXPECT_TRUE(m.emplace("a", 1).second);
+    EXPECT_FALSE(m.emplace("a", 2).second);
+    EXPECT_EQ(m["a"], 1);
+}
+
+TEST(MapSingleProbe, SubscriptHashesOnce)
+{
+    alp::Map<int, int, CountingHash> m;
+    m.reserve(100);
+    gHashCount = 0;
+    m[1] = 10;
+    EXPECT_EQ(gHashCount, 1);
+    m[1] += 5;
+    EXPECT_EQ(gHashCount, 2);
+    EXPECT_EQ(m[1], 15);
+    EXPECT_EQ(m[2], 0);
+    EXPECT_EQ(m.size(), 2);
+}
+
+TEST(MapSingleProbe, InsertOrAssign)
+{
+    alp::Map<int, std::string, CountingHash> m;
+    m.reserve(100);
+    gHashCount = 0;
+    auto [it, inserted] = m.insert_or_assign(1, "one");
+    EXPECT_TRUE(inserted);
+    EXPECT_EQ(it->second, "one");
+    auto [it2, inserted2] = m.insert_or_assign(1, "uno");
+    EXPECT_FALSE(inserted2);
+    EXPECT_EQ(it2->second, "uno");
+    EXPECT_EQ(gHashCount, 2);
+    EXPECT_EQ(m.size(), 1);
+}
+
+TEST(MapSingleProbe, Upsert)
+{
+    alp::Map<int, int, CountingHash> m;
+    m.reserve(100);
+    gHashCount = 0;
+    for (int i = 0; i < 30; ++i)
+    {
+        m.upsert(i % 3, [](int& count) { ++count; });
+    }
+    EXPECT_EQ(gHashCount, 30);
+    EXPECT_EQ(m.size(), 3);
+    EXPECT_EQ(m[0], 10);
+    EXPECT_EQ(m[1], 10);
+    EXPECT_EQ(m[2], 10);
+
+    // Initial value arguments are only used on insertion
+    auto [it, inserted] = m.upsert(5, [](int& v) { v *= 2; }, 21);
+    EXPECT_TRUE(inserted);
+    EXPECT_EQ(it->second, 42);
+    auto [it2, inserted2] = m.upsert(5, [](int& v) { v += 1; }, 1000);
+    EXPECT_FALSE(inserted2);
+    EXPECT_EQ(it2->second, 43);
+}
+
+TEST(MapSingleProbe, SubscriptMoveOnlyValue)
+{
+    alp::Map<std::string, std::unique_ptr<int>> m;
+    std::string key = "k";
+    m[std::move(key)] = std::make_unique<int>(3);
+    EXPECT_EQ(*m["k"], 3);
+    EXPECT_EQ(m.size(), 1);
+}
+
+TEST(MapBatch, FindMany)
+{
+    alp::Map<int, int> m;
+    for (int i = 0; i < 1000; i += 2)
+    {
+        m[i] = i * 10;
+    }
+    std::vector<int> keys;
+    for (int i = 0; i < 100; ++i)
+    {
+        keys.push_back(i);
+    }
+    std::vector<int*> values(keys.size());
+    m.find_many(keys, values);
+    for (int i = 0; i < 100; ++i)
+    {
+        if (i % 2 == 0)
+        {
+            ASSERT_NE(values[i], nullptr) << "Key: " << i;
+            EXPECT_EQ(*values[i], i * 10);
+        }
+        else
+        {
+            EXPECT_EQ(values[i], nullptr) << "Key: " << i;
+        }
+    }
+
+    auto found = std::make_unique<bool[]>(keys.size());
+    auto const& cm = m;
+    EXPECT_EQ(cm.contains_many(keys, {found.get(), keys.size()}), 50);
+    for (int i = 0; i < 100; ++i)
+    {
+        EXPECT_EQ(found[i], i % 2 == 0) << "Key: " << i;
+    }
+}
+
+TEST(MapPrecomputedHash, SharedAcrossTables)
+{
+    alp::Map<std::string, int> first;
+    alp::Map<std::string, int> second;
+    std::string key = "shared";
+    size_t hash = first.hash_function()(key);
+
+    EXPECT_TRUE(first.emplace_with_hash(hash, key, 1).second);
+    EXPECT_TRUE(second
+                    .emplace_with_hash(hash,
+                                       std::piecewise_construct,
+                                       std::forward_as_tuple(key),
+                                       std::forward_as_tuple(2))
+                    .second);
+    EXPECT_FALSE(second.emplace_with_hash(hash, key, 3).second);
+
+    EXPECT_EQ(first.find_with_hash(key, hash)->second, 1);
+    EXPECT_EQ(second.find_with_hash(key, hash)->second, 2);
+    EXPECT_TRUE(first.contains_with_hash(key, hash));
+    EXPECT_EQ(first.find(key), first.find_with_hash(key, hash));
+    EXPECT_FALSE(first.contains_with_hash("other", first.hash_function()("other")));
+}
+
+TEST(MapPrecomputedHash, MixedPolicyAppliedByTable)
+{
+    // std::hash output is mixed by the table, so callers pass the raw hasher output
+    alp::Map<int, int, CountingHash> m;
+    m.reserve(100);
+    gHashCount = 0;
+    size_t hash = m.hash_function()(7);
+    m.emplace_with_hash(hash, 7, 70);
+    EXPECT_EQ(m.find_with_hash(7, hash)->second, 70);
+    EXPECT_EQ(gHashCount, 1);
+    EXPECT_EQ(m[7], 70);
+}
+
+TEST(MapRange, FromRangeFirstKeyWins)
+{
+    std::vector<std::pair<std::string, int>> pairs {{"a", 1}, {"b", 2}, {"a", 3}};
+    alp::Map<std::string, int> m(std::from_range, pairs);
+    EXPECT_EQ(m.size(), 2);
+    EXPECT_EQ(m["a"], 1);
+    EXPECT_EQ(m["b"], 2);
+
+    std::vector<std::pair<std::string const, int>> more {{"b", 20}, {"c", 30}};
+    m.insert_range(more);
+    EXPECT_EQ(m.size(), 3);
+    EXPECT_EQ(m["b"], 2);
+    EXPECT_EQ(m["c"], 30);
+}
+
+TEST(MapRange, MutableKeyPairsAreCopiedOnce)
+{
+    std::vector<std::pair<int, ConstructionCounter>> pairs;
+    for (int i = 0; i < 100; ++i)
+    {
+        pairs.emplace_back(i % 50, ConstructionCounter(std::to_string(i)));
+    }
+    alp::Map<int, ConstructionCounter> m;
+    ConstructionCounter::reset();
+    m.insert_range(pairs);
+    EXPECT_EQ(m.size(), 50);
+    // Pairs are looked up by their key and only copied into the table when inserted
+    EXPECT_EQ(ConstructionCounter::copies, 50);
+    EXPECT_EQ(ConstructionCounter::moves, 0);
+    EXPECT_EQ(m.find(7)->second.value, "7");
+}
+
+TEST(MapRehash, IncrementalGrowth)
+{
+    alp::Map<int, int> m;
+    m.set_incremental_rehash(2);
+    for (int i = 0; i < 5000; ++i)
+    {
+        m[i] = i;
+        m[i / 2] += 1;
+    }
+    EXPECT_EQ(m.size(), 5000);
+    for (int i = 0; i < 5000; ++i)
+    {
+        ASSERT_EQ(m.find(i)->second, i < 2500 ? i + 2 : i) << "Key: " << i;
+    }
+}
+
+TEST(MapSplitLayout, GrowEraseAndCopy)
+{
+    SplitMap<std::string, std::vector<int>> m;
+    for (int i = 0; i < 3000; ++i)
+    {
+        m.emplace(std::to_string(i), std::vector<int>(3, i));
+    }
+    EXPECT_EQ(m.size(), 3000);
+    for (int i = 0; i < 3000; i += 2)
+    {
+        EXPECT_EQ(m.erase(std::to_string(i)), 1);
+    }
+    m.erase(m.find("1"));
+    EXPECT_EQ(m.size(), 1499);
+
+    auto copy = m;
+    for (int i = 3; i < 3000; i += 2)
+    {
+        ASSERT_EQ(copy.find(std::to_string(i))->second[2], i) << "Key: " << i;
+        ASSERT_EQ(m.find(std::to_string(i))->second[0], i) << "Key: " << i;
+    }
+    EXPECT_FALSE(copy.contains("0"));
+    EXPECT_FALSE(copy.contains("1"));
+
+    // Reinserting over the tombstones purges them without losing values
+    for (int i = 0; i < 3000; i += 2)
+    {
+        m.insert({std::to_string(i), std::vector<int> {-i}});
+    }
+    EXPECT_EQ(m.size(), 2999);
+    EXPECT_EQ(m.find("42")->second.front(), -42);
+    EXPECT_EQ(m.find("43")->second.front(), 43);
+}
+
+TEST(MapSplitLayout, IterateAndUpdate)
+{
+    SplitMap<int, std::unique_ptr<int>> m;
+    for (int i = 0; i < 100; ++i)
+    {
+        m[i] = std::make_unique<int>(i);
+    }
+    m.try_emplace(5, std::make_unique<int>(-1));
+    m.insert_or_assign(7, std::make_unique<int>(70));
+    EXPECT_EQ(*m[5], 5);
+    EXPECT_EQ(*m.get(7)->get(), 70);
+
+    int count = 0;
+    for (auto [key, value] : m)
+    {
+        *value += 1;
+        ++count;
+    }
+    EXPECT_EQ(count, 100);
+    EXPECT_EQ(*m.find(7)->second, 71);
+
+    auto const& cm = m;
+    long sum = 0;
+    for (auto it = cm.begin(); it != cm.end(); ++it)
+    {
+        sum += it->first;
+    }
+    EXPECT_EQ(sum, 4950);
+
+    std::vector<int> keys {3, 200};
+    std::vector<std::unique_ptr<int>*> values(2);
+    m.find_many(keys, values);
+    EXPECT_EQ(**values[0], 4);
+    EXPECT_EQ(values[1], nullptr);
+}
+
+TEST(MapSplitLayout, KeysAndValuesViews)
+{
+    using Split = SplitMap<int, std::string>;
+    static_assert(std::is_same_v<Split::reference, std::pair<int const&, std::string&>>);
+    static_assert(std::is_same_v<alp::Map<int, int>::reference, std::pair<int const, int>&>);
+
+    Split split;
+    alp::Map<int, std::string> paired;
+    for (int i = 0; i < 200; ++i)
+    {
+        split.emplace(i, std::to_string(i));
+        paired.emplace(i, std::to_string(i));
+    }
+    for (std::string& value : split.values())
+    {
+        value += "!";
+    }
+    for (std::string& value : paired.values())
+    {
+        value += "?";
+    }
+
+    long keySum = 0;
+    for (int key : split.keys())
+    {
+        keySum += key;
+        EXPECT_EQ(split.find(key)->second, std::to_string(key) + "!");
+    }
+    for (int key : paired.keys())
+    {
+        keySum -= key;
+        EXPECT_EQ(paired.find(key)->second, std::to_string(key) + "?");
+    }
+    EXPECT_EQ(keySum, 0);
+
+    // Both views visit the elements in iteration order
+    auto const& constSplit = split;
+    auto value = constSplit.values().begin();
+    for (auto [key, mapped] : constSplit)
+    {
+        EXPECT_EQ(&*value, &mapped) << "Key: " << key;
+        ++value;
+    }
+    EXPECT_EQ(value, constSplit.values().end());
+}
+
+TEST(MapSerialization, RoundTripBothLayouts)
+{
+    alp::Map<int64_t, double> m;
+    SplitMap<int, int> split;
+    for (int i = 0; i < 5000; ++i)
+    {
+        m.emplace(i, i * 0.5);
+        split.emplace(i, -i);
+    }
+    m.erase(17);
+    split.erase(17);
+
+    std::stringstream stream;
+    ASSERT_TRUE(m.save(stream));
+    auto loaded = alp::Map<int64_t, double>::load(stream);
+    ASSERT_TRUE(loaded);
+    EXPECT_EQ(loaded->size(), 4999);
+    EXPECT_EQ(loaded->find(4000)->second, 2000.0);
+    EXPECT_FALSE(loaded->contains(17));
+    (*loaded)[17] = 1.0;
+    EXPECT_EQ(loaded->size(), 5000);
+
+    std::stringstream splitStream;
+    ASSERT_TRUE(split.save(splitStream));
+    auto loadedSplit = SplitMap<int, int>::load(splitStream);
+    ASSERT_TRUE(loadedSplit);
+    EXPECT_EQ(loadedSplit->size(), 4999);
+    for (auto [key, value] : split)
+    {
+        ASSERT_EQ(loadedSplit->find(key)->second, value) << "Key: " << key;
+    }
+
+    // The layouts are not interchangeable
+    std::istringstream mismatched(splitStream.str());
+    EXPECT_EQ((alp::Map<int, int>::load(mismatched).error()), alp::Error::IncompatibleFormat);
+}
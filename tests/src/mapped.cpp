@@ -0,0 +1,479 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <ratio>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#if !defined(_WIN32)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+import alp;
+
+namespace
+{
+    /// A file in the temporary directory, removed when the test ends.
+    struct TempFile
+    {
+        std::filesystem::path path;
+
+        explicit TempFile(std::string const& name)
+            : path(std::filesystem::temp_directory_path() / name)
+        {
+        }
+        ~TempFile() { std::filesystem::remove(path); }
+    };
+
+#if !defined(_WIN32)
+    /// A shared-memory name unique to this test process, removed when the test ends.
+    template<typename SharedMap>
+    struct TempSharedName
+    {
+        std::string name;
+
+        explicit TempSharedName(std::string const& test)
+            : name("/alp_" + test + "_" + std::to_string(::getpid()))
+        {
+        }
+        ~TempSharedName() { SharedMap::remove(name); }
+    };
+#endif
+
+    using BlockedSet = alp::Set<int,
+                                std::hash<int>,
+                                std::equal_to<int>,
+                                alp::MixHashPolicy,
+                                alp::DefaultBackend,
+                                std::allocator<std::byte>,
+                                std::ratio<7, 8>,
+                                alp::StoreHashTag,
+                                alp::QuadraticProbing,
+                                alp::NoShrinkPolicy,
+                                alp::BlockedCtrlTag>;
+    using FrozenBlockedSet = alp::FrozenSet<int,
+                                            std::hash<int>,
+                                            std::equal_to<int>,
+                                            alp::MixHashPolicy,
+                                            alp::DefaultBackend,
+                                            std::ratio<7, 8>,
+                                            alp::StoreHashTag,
+                                            alp::QuadraticProbing,
+                                            alp::BlockedCtrlTag>;
+
+    template<typename Key, typename Value>
+    using SplitMap = alp::Map<Key,
+                              Value,
+                              alp::RapidHasher,
+                              std::equal_to<Key>,
+                              typename alp::HashPolicySelector<Key, alp::RapidHasher>::type,
+                              alp::DefaultBackend,
+                              std::allocator<std::byte>,
+                              alp::DefaultLoadFactorSelector<alp::DefaultBackend>::type,
+                              typename alp::HashStorageSelector<Key>::type,
+                              alp::DefaultProber,
+                              alp::DefaultShrinkPolicy,
+                              alp::SplitLayoutTag>;
+    template<typename Key, typename Value>
+    using FrozenSplitMap =
+        alp::FrozenMap<Key,
+                       Value,
+                       alp::RapidHasher,
+                       std::equal_to<Key>,
+                       typename alp::HashPolicySelector<Key, alp::RapidHasher>::type,
+                       alp::DefaultBackend,
+                       alp::DefaultLoadFactorSelector<alp::DefaultBackend>::type,
+                       typename alp::HashStorageSelector<Key>::type,
+                       alp::DefaultProber,
+                       alp::SplitLayoutTag>;
+}  // namespace
+
+TEST(FrozenSet, LooksUpSavedElements)
+{
+    TempFile file("alp_frozen_set_test.bin");
+    alp::Set<int64_t> s;
+    for (int64_t i = 0; i < 20000; ++i)
+    {
+        s.emplace(i * 5);
+    }
+    for (int64_t i = 0; i < 20000; i += 3)
+    {
+        s.erase(i * 5);
+    }
+    ASSERT_TRUE(s.save(file.path));
+
+    auto frozen = alp::FrozenSet<int64_t>::open(file.path);
+    ASSERT_TRUE(frozen);
+    EXPECT_EQ(frozen->size(), s.size());
+    EXPECT_EQ(frozen->capacity(), s.capacity());
+    for (int64_t i = 0; i < 20000; ++i)
+    {
+        ASSERT_EQ(frozen->contains(i * 5), i % 3 != 0) << "Key: " << i * 5;
+        ASSERT_FALSE(frozen->contains(i * 5 + 1)) << "Key: " << i * 5 + 1;
+    }
+    EXPECT_EQ(frozen->get(int64_t {10}).value().get(), 10);
+    EXPECT_EQ(frozen->get(int64_t {15}).error(), alp::Error::NotFound);
+
+    size_t visited = 0;
+    frozen->for_each(
+        [&](int64_t v)
+        {
+            EXPECT_TRUE(s.contains(v));
+            ++visited;
+        });
+    EXPECT_EQ(visited, s.size());
+
+    // Views of one file are independent of each other and of the file's writer
+    auto second = alp::FrozenSet<int64_t>::open(file.path);
+    s.clear();
+    frozen = std::move(second);
+    ASSERT_TRUE(frozen);
+    EXPECT_TRUE(frozen->contains(int64_t {20}));
+}
+
+TEST(FrozenSet, BlockedInlineAndEmptyTables)
+{
+    TempFile file("alp_frozen_layouts_test.bin");
+    BlockedSet blocked;
+    for (int i = 0; i < 3000; ++i)
+    {
+        blocked.emplace(i);
+    }
+    ASSERT_TRUE(blocked.save(file.path));
+    auto frozenBlocked = FrozenBlockedSet::open(file.path);
+    ASSERT_TRUE(frozenBlocked);
+    for (int i = 0; i < 3000; ++i)
+    {
+        ASSERT_TRUE(frozenBlocked->contains(i)) << "Missing: " << i;
+    }
+    EXPECT_FALSE(frozenBlocked->contains(3000));
+
+    alp::Set<int> tiny;
+    tiny.emplace(7);
+    tiny.emplace(9);
+    ASSERT_TRUE(tiny.save(file.path));
+    auto frozenTiny = alp::FrozenSet<int>::open(file.path);
+    ASSERT_TRUE(frozenTiny);
+    EXPECT_EQ(frozenTiny->size(), 2);
+    EXPECT_TRUE(frozenTiny->contains(7) && frozenTiny->contains(9));
+    EXPECT_FALSE(frozenTiny->contains(8));
+
+    alp::Set<int> empty;
+    ASSERT_TRUE(empty.save(file.path));
+    auto frozenEmpty = alp::FrozenSet<int>::open(file.path);
+    ASSERT_TRUE(frozenEmpty);
+    EXPECT_TRUE(frozenEmpty->empty());
+    EXPECT_FALSE(frozenEmpty->contains(7));
+}
+
+TEST(FrozenSet, RejectsOtherTypesAndDamagedFiles)
+{
+    TempFile file("alp_frozen_reject_test.bin");
+    alp::Set<int64_t> s;
+    for (int64_t i = 0; i < 1000; ++i)
+    {
+        s.emplace(i);
+    }
+    ASSERT_TRUE(s.save(file.path));
+
+    EXPECT_EQ(alp::FrozenSet<int32_t>::open(file.path).error(), alp::Error::IncompatibleFormat);
+    EXPECT_EQ((alp::FrozenSet<int64_t, std::hash<int64_t>>::open(file.path).error()),
+              alp::Error::IncompatibleFormat);
+    EXPECT_EQ((alp::FrozenMap<int64_t, int64_t>::open(file.path).error()),
+              alp::Error::IncompatibleFormat);
+
+    std::filesystem::resize_file(file.path, std::filesystem::file_size(file.path) - 1);
+    EXPECT_EQ(alp::FrozenSet<int64_t>::open(file.path).error(), alp::Error::IncompatibleFormat);
+
+    std::filesystem::remove(file.path);
+    EXPECT_EQ(alp::FrozenSet<int64_t>::open(file.path).error(), alp::Error::IoFailure);
+}
+
+TEST(FrozenMap, PairAndSplitLayouts)
+{
+    TempFile file("alp_frozen_map_test.bin");
+    alp::Map<int64_t, double> m;
+    SplitMap<uint32_t, int16_t> split;
+    for (int i = 0; i < 5000; ++i)
+    {
+        m.emplace(i, i * 0.25);
+        split.emplace(i * 2, static_cast<int16_t>(-i));
+    }
+
+    ASSERT_TRUE(m.save(file.path));
+    auto frozen = alp::FrozenMap<int64_t, double>::open(file.path);
+    ASSERT_TRUE(frozen);
+    EXPECT_EQ(frozen->size(), 5000);
+    EXPECT_EQ(frozen->get(4000).value().get(), 1000.0);
+    EXPECT_EQ(frozen->get(5000).error(), alp::Error::NotFound);
+    double sum = 0;
+    frozen->for_each([&](int64_t key, double value) { sum += value - key * 0.25; });
+    EXPECT_EQ(sum, 0.0);
+
+    ASSERT_TRUE(split.save(file.path));
+    auto frozenSplit = FrozenSplitMap<uint32_t, int16_t>::open(file.path);
+    ASSERT_TRUE(frozenSplit);
+    for (uint32_t i = 0; i < 5000; ++i)
+    {
+        ASSERT_EQ(frozenSplit->get(i * 2).value().get(), -static_cast<int>(i)) << "Key: " << i;
+        ASSERT_FALSE(frozenSplit->contains(i * 2 + 1));
+    }
+    EXPECT_EQ((alp::FrozenMap<uint32_t, int16_t>::open(file.path).error()),
+              alp::Error::IncompatibleFormat);
+}
+
+#if !defined(_WIN32)
+TEST(FileBackedSet, ReopensWithoutRehashing)
+{
+    TempFile file("alp_file_backed_test.bin");
+    {
+        auto set = alp::FileBackedSet<int64_t>::create(file.path);
+        ASSERT_TRUE(set);
+        for (int64_t i = 0; i < 50000; ++i)
+        {
+            EXPECT_TRUE(set->insert(i * 7));
+        }
+        EXPECT_FALSE(set->insert(int64_t {0}));
+        EXPECT_EQ(set->erase(int64_t {7}), 1);
+        ASSERT_TRUE(set->flush());
+    }
+    // Growing renamed each new buffer's file over the set's own
+    EXPECT_FALSE(std::filesystem::exists(file.path.string() + ".next"));
+
+    {
+        auto set = alp::FileBackedSet<int64_t>::open(file.path);
+        ASSERT_TRUE(set);
+        EXPECT_EQ(set->size(), 49999);
+        for (int64_t i = 0; i < 50000; ++i)
+        {
+            ASSERT_EQ(set->contains(i * 7), i != 1) << "Key: " << i * 7;
+        }
+        for (int64_t i = 50000; i < 100000; ++i)
+        {
+            set->insert(i * 7);
+        }
+        // Closed without flush(): the destructor still writes the header
+    }
+
+    auto set = alp::FileBackedSet<int64_t>::open(file.path);
+    ASSERT_TRUE(set);
+    EXPECT_EQ(set->size(), 99999);
+    EXPECT_TRUE(set->contains(int64_t {99999 * 7}));
+    size_t visited = 0;
+    set->for_each([&](int64_t v) { visited += v % 7 == 0; });
+    EXPECT_EQ(visited, 99999);
+
+    set->clear();
+    EXPECT_TRUE(set->empty());
+    set->insert(int64_t {3});
+    EXPECT_TRUE(set->contains(int64_t {3}));
+}
+
+TEST(FileBackedSet, RejectsOtherFilesAndSharesFrozenFormat)
+{
+    TempFile file("alp_file_backed_reject_test.bin");
+    EXPECT_EQ(alp::FileBackedSet<int64_t>::open(file.path).error(), alp::Error::IoFailure);
+    {
+        auto set = alp::FileBackedSet<int32_t>::create(file.path, 1000);
+        ASSERT_TRUE(set);
+        for (int32_t i = 0; i < 1000; ++i)
+        {
+            set->insert(i);
+        }
+        ASSERT_TRUE(set->flush());
+    }
+    EXPECT_EQ(alp::FileBackedSet<int64_t>::open(file.path).error(),
+              alp::Error::IncompatibleFormat);
+
+    // A Set saved with save() has no header page in front of its buffer
+    alp::Set<int32_t> saved;
+    saved.emplace(1);
+    ASSERT_TRUE(saved.save(file.path));
+    EXPECT_EQ(alp::FileBackedSet<int32_t>::open(file.path).error(),
+              alp::Error::IncompatibleFormat);
+}
+
+TEST(FileBackedSet, RejectsFilesModifiedSinceTheirFlush)
+{
+    TempFile file("alp_file_backed_stale_test.bin");
+    TempFile snapshot("alp_file_backed_stale_snapshot.bin");
+    auto set = alp::FileBackedSet<int64_t>::create(file.path, 1000);
+    ASSERT_TRUE(set);
+    for (int64_t i = 0; i < 500; ++i)
+    {
+        set->insert(i);
+    }
+    ASSERT_TRUE(set->flush());
+
+    // A copy taken mid-update stands for the file left behind by a crash
+    set->insert(int64_t {500});
+    std::filesystem::copy_file(
+        file.path, snapshot.path, std::filesystem::copy_options::overwrite_existing);
+    EXPECT_EQ(alp::FileBackedSet<int64_t>::open(snapshot.path).error(),
+              alp::Error::IncompatibleFormat);
+
+    ASSERT_TRUE(set->flush());
+    std::filesystem::copy_file(
+        file.path, snapshot.path, std::filesystem::copy_options::overwrite_existing);
+    auto reopened = alp::FileBackedSet<int64_t>::open(snapshot.path);
+    ASSERT_TRUE(reopened);
+    EXPECT_EQ(reopened->size(), 501);
+}
+
+TEST(FileBackedSet, RejectsHeadersThatDisagreeWithTheControlBytes)
+{
+    TempFile file("alp_file_backed_counts_test.bin");
+    {
+        auto set = alp::FileBackedSet<int64_t>::create(file.path, 1000);
+        ASSERT_TRUE(set);
+        for (int64_t i = 0; i < 500; ++i)
+        {
+            set->insert(i);
+        }
+        ASSERT_TRUE(set->flush());
+    }
+
+    // Claims one element fewer than the control bytes hold; size and used sit at 80 and 88
+    {
+        std::fstream stream(file.path, std::ios::in | std::ios::out | std::ios::binary);
+        uint64_t counts[2] = {499, 499};
+        stream.seekp(80);
+        stream.write(reinterpret_cast<char const*>(counts), sizeof(counts));
+    }
+    EXPECT_EQ(alp::FileBackedSet<int64_t>::open(file.path).error(),
+              alp::Error::IncompatibleFormat);
+}
+
+TEST(MappedFileAllocator, BacksAnOrdinaryMap)
+{
+    TempFile file("alp_mapped_allocator_test.bin");
+    alp::Map<int64_t,
+             int64_t,
+             alp::RapidHasher,
+             std::equal_to<int64_t>,
+             alp::HashPolicySelector<int64_t, alp::RapidHasher>::type,
+             alp::DefaultBackend,
+             alp::MappedFileAllocator<std::byte>>
+        m(alp::MappedFileAllocator<std::byte>(file.path));
+    for (int64_t i = 0; i < 20000; ++i)
+    {
+        m[i] = -i;
+    }
+    EXPECT_EQ(m.size(), 20000);
+    EXPECT_EQ(m.find(12345)->second, -12345);
+    EXPECT_TRUE(std::filesystem::exists(file.path));
+}
+
+TEST(SharedMemoryMap, InstancesShareOneTable)
+{
+    using SharedMap = alp::SharedMemoryMap<int64_t, int64_t>;
+    TempSharedName<SharedMap> shared("share");
+    auto writer = SharedMap::create(shared.name);
+    ASSERT_TRUE(writer);
+    auto reader = SharedMap::open(shared.name);
+    ASSERT_TRUE(reader);
+    EXPECT_TRUE(reader->empty());
+
+    // The writer grows the table many times over; the reader follows it to each new buffer
+    for (int64_t i = 0; i < 50000; ++i)
+    {
+        EXPECT_TRUE(writer->insert(i, i * 3));
+    }
+    EXPECT_FALSE(writer->insert(0, 1));
+    EXPECT_EQ(reader->size(), 50000);
+    for (int64_t i = 0; i < 50000; ++i)
+    {
+        ASSERT_EQ(reader->get(i).value(), i * 3) << "Key: " << i;
+    }
+    EXPECT_EQ(reader->get(50000).error(), alp::Error::NotFound);
+
+    EXPECT_FALSE(reader->insert_or_assign(7, -7));
+    EXPECT_TRUE(reader->insert_or_assign(-1, 1));
+    EXPECT_EQ(reader->erase(8), 1);
+    EXPECT_EQ(reader->erase(8), 0);
+    EXPECT_EQ(writer->get(7).value(), -7);
+    EXPECT_TRUE(writer->contains(-1));
+    EXPECT_FALSE(writer->contains(8));
+    EXPECT_TRUE(writer->cvisit(-1, [](auto const& element) { EXPECT_EQ(element.second, 1); }));
+    int64_t visited = 0;
+    writer->for_each([&](auto const& element) { visited += element.first >= 0; });
+    EXPECT_EQ(visited, 49999);
+
+    writer->clear();
+    EXPECT_TRUE(reader->empty());
+    reader->insert(5, 6);
+    EXPECT_EQ(writer->get(5).value(), 6);
+
+    // Instances opened later see the same table, and a moved instance keeps its view
+    auto late = SharedMap::open(shared.name);
+    ASSERT_TRUE(late);
+    auto moved = std::move(*late);
+    EXPECT_TRUE(moved.contains(5));
+}
+
+TEST(SharedMemoryMap, RejectsTakenNamesAndOtherTypes)
+{
+    using SharedMap = alp::SharedMemoryMap<int64_t, int64_t>;
+    TempSharedName<SharedMap> shared("reject");
+    EXPECT_EQ(SharedMap::open(shared.name).error(), alp::Error::IoFailure);
+    auto map = SharedMap::create(shared.name, 1000);
+    ASSERT_TRUE(map);
+    EXPECT_EQ(SharedMap::create(shared.name).error(), alp::Error::IoFailure);
+    EXPECT_EQ((alp::SharedMemoryMap<int32_t, int32_t>::open(shared.name).error()),
+              alp::Error::IncompatibleFormat);
+    EXPECT_EQ((alp::SharedMemoryMap<int64_t, int64_t, std::hash<int64_t>>::open(shared.name)
+                   .error()),
+              alp::Error::IncompatibleFormat);
+
+    SharedMap::remove(shared.name);
+    EXPECT_EQ(SharedMap::open(shared.name).error(), alp::Error::IoFailure);
+    // The remaining instance still has its buffer
+    map->insert(1, 2);
+    EXPECT_EQ(map->get(1).value(), 2);
+}
+
+TEST(SharedMemoryMap, ProcessesInsertConcurrently)
+{
+    using SharedMap = alp::SharedMemoryMap<int64_t, int64_t>;
+    TempSharedName<SharedMap> shared("processes");
+    auto map = SharedMap::create(shared.name);
+    ASSERT_TRUE(map);
+
+    constexpr int64_t processes = 4;
+    constexpr int64_t keysPerProcess = 20000;
+    std::vector<pid_t> children;
+    for (int64_t p = 0; p < processes; ++p)
+    {
+        pid_t pid = ::fork();
+        ASSERT_GE(pid, 0);
+        if (pid == 0)
+        {
+            auto own = SharedMap::open(shared.name);
+            bool ok = own.has_value();
+            for (int64_t i = 0; ok && i < keysPerProcess; ++i)
+            {
+                ok = own->insert(i * processes + p, p) && own->contains(i * processes + p);
+            }
+            ::_exit(ok ? 0 : 1);
+        }
+        children.push_back(pid);
+    }
+    for (pid_t pid : children)
+    {
+        int status = 0;
+        ASSERT_EQ(::waitpid(pid, &status, 0), pid);
+        EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    EXPECT_EQ(map->size(), processes * keysPerProcess);
+    for (int64_t key = 0; key < processes * keysPerProcess; ++key)
+    {
+        ASSERT_EQ(map->get(key).value(), key % processes) << "Key: " << key;
+    }
+}
+#endif
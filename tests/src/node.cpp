@@ -0,0 +1,172 @@
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+import alp;
+
+namespace
+{
+    int gLiveCount = 0;
+    // Tracks how many instances are alive, to check that nodes are destroyed
+    struct LiveCounter
+    {
+        int value;
+        explicit LiveCounter(int v)
+            : value(v)
+        {
+            ++gLiveCount;
+        }
+        LiveCounter(LiveCounter const& other)
+            : value(other.value)
+        {
+            ++gLiveCount;
+        }
+        ~LiveCounter() { --gLiveCount; }
+        bool operator==(LiveCounter const& other) const { return value == other.value; }
+    };
+
+    size_t gSeedCount = 0;
+    // Draws a new seed for every default-constructed instance, like a randomized hasher
+    struct SeededHash
+    {
+        size_t seed = ++gSeedCount;
+        size_t operator()(int v) const noexcept { return std::hash<int> {}(v) ^ seed; }
+    };
+
+    // Value too large to be worth moving on every rehash
+    struct Payload
+    {
+        std::array<int, 64> data {};
+    };
+}  // namespace
+
+template<>
+struct std::hash<LiveCounter>
+{
+    size_t operator()(LiveCounter const& c) const noexcept { return std::hash<int> {}(c.value); }
+};
+
+TEST(NodeSet, ReferencesSurviveGrowth)
+{
+    alp::NodeSet<std::string> s;
+    auto const* first = &*s.insert("first").first;
+    for (int i = 0; i < 10000; ++i)
+    {
+        s.insert(std::to_string(i));
+    }
+    EXPECT_EQ(s.size(), 10001);
+    EXPECT_EQ(&*s.find(std::string("first")), first);
+    EXPECT_EQ(*first, "first");
+    EXPECT_FALSE(s.insert("first").second);
+    EXPECT_TRUE(s.contains(std::string("9999")));
+}
+
+TEST(NodeSet, EraseAndClearDestroyNodes)
+{
+    gLiveCount = 0;
+    {
+        alp::NodeSet<LiveCounter, std::hash<LiveCounter>> s;
+        for (int i = 0; i < 100; ++i)
+        {
+            s.emplace(i);
+        }
+        // Duplicate built from non-T arguments is released again
+        EXPECT_FALSE(s.emplace(5).second);
+        EXPECT_EQ(gLiveCount, 100);
+        EXPECT_EQ(s.erase(LiveCounter {5}), 1);
+        EXPECT_EQ(gLiveCount, 99);
+        s.erase(s.find(LiveCounter {6}));
+        EXPECT_EQ(gLiveCount, 98);
+        EXPECT_FALSE(s.contains(LiveCounter {6}));
+
+        alp::NodeSet<LiveCounter, std::hash<LiveCounter>> copy = s;
+        EXPECT_EQ(gLiveCount, 196);
+        s.clear();
+        EXPECT_EQ(gLiveCount, 98);
+        EXPECT_TRUE(s.empty());
+        EXPECT_TRUE(copy.contains(LiveCounter {99}));
+    }
+    EXPECT_EQ(gLiveCount, 0);
+}
+
+TEST(NodeMap, ReferencesSurviveGrowth)
+{
+    alp::NodeMap<int, Payload> m;
+    Payload& first = m[0];
+    first.data[0] = 42;
+    std::vector<Payload const*> addresses;
+    for (int i = 1; i < 5000; ++i)
+    {
+        addresses.push_back(&m.try_emplace(i).first->second);
+    }
+    EXPECT_EQ(m.size(), 5000);
+    EXPECT_EQ(&m[0], &first);
+    EXPECT_EQ(m.find(0)->second.data[0], 42);
+    for (int i = 1; i < 5000; ++i)
+    {
+        ASSERT_EQ(&m.find(i)->second, addresses[i - 1]) << "Key: " << i;
+    }
+}
+
+TEST(NodeMap, InsertEraseAndIterate)
+{
+    alp::NodeMap<std::string, std::unique_ptr<int>> m;
+    m.emplace("a", std::make_unique<int>(1));
+    m.try_emplace("b", std::make_unique<int>(2));
+    m.insert_or_assign("a", std::make_unique<int>(10));
+    EXPECT_FALSE(m.try_emplace("b", std::make_unique<int>(20)).second);
+    EXPECT_EQ(*m.find("a")->second, 10);
+    EXPECT_EQ(*m["b"], 2);
+
+    int sum = 0;
+    for (auto const& [key, value] : m)
+    {
+        sum += *value;
+    }
+    EXPECT_EQ(sum, 12);
+
+    EXPECT_EQ(m.erase("a"), 1);
+    EXPECT_EQ(m.erase("a"), 0);
+    EXPECT_FALSE(m.contains("a"));
+
+    alp::NodeMap<std::string, std::unique_ptr<int>> other;
+    other["c"] = std::make_unique<int>(3);
+    swap(m, other);
+    EXPECT_TRUE(m.contains("c"));
+    EXPECT_TRUE(other.contains("b"));
+    auto moved = std::move(other);
+    EXPECT_EQ(*moved["b"], 2);
+    EXPECT_TRUE(other.empty());
+}
+
+TEST(NodeCopy, KeepsHasherAndRehashSettings)
+{
+    alp::NodeSet<int, SeededHash> s;
+    s.set_rehash_threads(2);
+    s.set_incremental_rehash(4);
+    alp::NodeMap<int, int, SeededHash> m;
+    m.set_rehash_threads(2);
+    m.set_incremental_rehash(4);
+    for (int i = 0; i < 1000; ++i)
+    {
+        s.insert(i);
+        m.emplace(i, -i);
+    }
+
+    auto setCopy = s;
+    EXPECT_EQ(setCopy.hash_function().seed, s.hash_function().seed);
+    EXPECT_EQ(setCopy.rehash_threads(), 2);
+    EXPECT_EQ(setCopy.incremental_rehash(), 4);
+    auto mapCopy = m;
+    EXPECT_EQ(mapCopy.hash_function().seed, m.hash_function().seed);
+    EXPECT_EQ(mapCopy.rehash_threads(), 2);
+    EXPECT_EQ(mapCopy.incremental_rehash(), 4);
+    for (int i = 0; i < 1000; ++i)
+    {
+        ASSERT_TRUE(setCopy.contains(i)) << "Key: " << i;
+        ASSERT_EQ(mapCopy.find(i)->second, -i) << "Key: " << i;
+    }
+}
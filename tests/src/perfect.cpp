@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+import alp;
+
+TEST(PerfectSet, BuildsFromSetRangeAndList)
+{
+    alp::Set<int64_t> source;
+    std::mt19937_64 rng(7);
+    while (source.size() < 100000)
+    {
+        source.insert(static_cast<int64_t>(rng()));
+    }
+
+    auto set = alp::PerfectSet<int64_t>::build(source);
+    EXPECT_EQ(set.size(), source.size());
+    EXPECT_LE(set.capacity(), source.size() + source.size() / 50);
+    for (int64_t key : source)
+    {
+        ASSERT_TRUE(set.contains(key)) << "Missing: " << key;
+    }
+    size_t misses = 0;
+    for (int i = 0; i < 100000; ++i)
+    {
+        auto key = static_cast<int64_t>(rng());
+        misses += set.contains(key) == source.contains(key);
+    }
+    EXPECT_EQ(misses, 100000);
+
+    size_t visited = 0;
+    set.for_each(
+        [&](int64_t key)
+        {
+            EXPECT_TRUE(source.contains(key));
+            ++visited;
+        });
+    EXPECT_EQ(visited, source.size());
+
+    // Repeated elements of a range are kept once
+    std::vector<int> repeated {4, 8, 15, 16, 23, 42, 8, 4};
+    auto fromRange = alp::PerfectSet<int>::build(repeated);
+    EXPECT_EQ(fromRange.size(), 6);
+    EXPECT_EQ(fromRange.get(15).value().get(), 15);
+    EXPECT_EQ(fromRange.get(14).error(), alp::Error::NotFound);
+    EXPECT_EQ(fromRange.count(42), 1);
+
+    auto single = alp::PerfectSet<int>::build({0});
+    EXPECT_TRUE(single.contains(0));
+    EXPECT_FALSE(single.contains(1));
+    visited = 0;
+    single.for_each([&](int) { ++visited; });
+    EXPECT_EQ(visited, 1);
+
+    alp::PerfectSet<int> empty;
+    EXPECT_TRUE(empty.empty());
+    EXPECT_FALSE(empty.contains(0));
+    EXPECT_TRUE(alp::PerfectSet<int>::build(std::vector<int> {}).empty());
+}
+
+TEST(PerfectSet, StringKeys)
+{
+    std::vector<std::string> codes {"AT", "BE", "CH", "DE", "DK", "ES", "FI", "FR", "GB", "IE",
+                                    "IT", "LU", "NL", "NO", "PL", "PT", "SE"};
+    auto set = alp::PerfectSet<std::string>::build(codes);
+    EXPECT_EQ(set.size(), codes.size());
+    for (auto const& code : codes)
+    {
+        EXPECT_TRUE(set.contains(code)) << code;
+    }
+    EXPECT_FALSE(set.contains("US"));
+    EXPECT_FALSE(set.contains(""));
+}
+
+TEST(PerfectMap, BuildsFromMapAndPairs)
+{
+    alp::Map<int64_t, double> source;
+    for (int64_t i = 0; i < 20000; ++i)
+    {
+        source.emplace(i * 3, i * 0.5);
+    }
+    auto map = alp::PerfectMap<int64_t, double>::build(source);
+    EXPECT_EQ(map.size(), 20000);
+    for (int64_t i = 0; i < 20000; ++i)
+    {
+        ASSERT_EQ(map.get(i * 3).value().get(), i * 0.5) << "Key: " << i * 3;
+        ASSERT_FALSE(map.contains(i * 3 + 1));
+    }
+    EXPECT_EQ(map.get(-3).error(), alp::Error::NotFound);
+    double sum = 0;
+    map.for_each([&](int64_t key, double value) { sum += value - key / 6.0; });
+    EXPECT_EQ(sum, 0.0);
+
+    // Of pairs with equal keys, the first is kept
+    std::vector<std::pair<std::string, int>> fields {{"Host", 1}, {"Accept", 2}, {"Host", 3}};
+    auto headers = alp::PerfectMap<std::string, int>::build(fields);
+    EXPECT_EQ(headers.size(), 2);
+    EXPECT_EQ(headers.get("Host").value().get(), 1);
+    EXPECT_FALSE(headers.contains("host"));
+}
+
+TEST(PerfectSerialization, RoundTripsWithoutRebuilding)
+{
+    std::vector<int64_t> keys;
+    for (int64_t i = 0; i < 50000; ++i)
+    {
+        keys.push_back(i * i);
+    }
+    auto set = alp::PerfectSet<int64_t>::build(keys);
+    std::stringstream saved;
+    ASSERT_TRUE(set.save(saved));
+    auto loaded = alp::PerfectSet<int64_t>::load(saved);
+    ASSERT_TRUE(loaded);
+    EXPECT_EQ(loaded->size(), set.size());
+    for (int64_t key : keys)
+    {
+        ASSERT_TRUE(loaded->contains(key)) << "Missing: " << key;
+    }
+    EXPECT_FALSE(loaded->contains(int64_t {2}));
+
+    auto path = std::filesystem::temp_directory_path() / "alp_perfect_map_test.bin";
+    auto map = alp::PerfectMap<int32_t, int32_t>::build({{1, 10}, {2, 20}, {3, 30}});
+    ASSERT_TRUE(map.save(path));
+    auto loadedMap = alp::PerfectMap<int32_t, int32_t>::load(path);
+    std::filesystem::remove(path);
+    ASSERT_TRUE(loadedMap);
+    EXPECT_EQ(loadedMap->get(2).value().get(), 20);
+    EXPECT_FALSE(loadedMap->contains(4));
+
+    std::stringstream empty;
+    ASSERT_TRUE(alp::PerfectSet<int64_t>().save(empty));
+    auto loadedEmpty = alp::PerfectSet<int64_t>::load(empty);
+    ASSERT_TRUE(loadedEmpty);
+    EXPECT_TRUE(loadedEmpty->empty());
+}
+
+TEST(PerfectSerialization, RejectsOtherTypesAndDamagedData)
+{
+    std::vector<int64_t> keys;
+    for (int64_t i = 0; i < 1000; ++i)
+    {
+        keys.push_back(i);
+    }
+    std::stringstream saved;
+    ASSERT_TRUE(alp::PerfectSet<int64_t>::build(keys).save(saved));
+    auto const bytes = saved.str();
+
+    std::stringstream in(bytes);
+    EXPECT_EQ(alp::PerfectSet<int32_t>::load(in).error(), alp::Error::IncompatibleFormat);
+    in.str(bytes);
+    EXPECT_EQ((alp::PerfectSet<int64_t, std::hash<int64_t>>::load(in).error()),
+              alp::Error::IncompatibleFormat);
+
+    in.str(bytes.substr(0, bytes.size() - 1));
+    EXPECT_EQ(alp::PerfectSet<int64_t>::load(in).error(), alp::Error::IoFailure);
+
+    // Slots holding elements that are not where their hashes send them
+    auto reversed = bytes;
+    std::reverse(reversed.end() - std::ptrdiff_t {8 * 1000}, reversed.end());
+    in.clear();
+    in.str(reversed);
+    EXPECT_EQ(alp::PerfectSet<int64_t>::load(in).error(), alp::Error::IncompatibleFormat);
+}
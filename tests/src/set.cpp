@@ -1,8 +1,12 @@
 #include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <memory>
 #include <ranges>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <type_traits>
 #include <vector>
 
@@ -40,6 +44,12 @@ namespace
         size_t operator()(int x) const noexcept { return static_cast<size_t>(x); }
     };
 
+    // Hashes decimal strings to their numeric value
+    struct StringIdentityHash
+    {
+        size_t operator()(std::string const& s) const { return std::stoul(s); }
+    };
+
     // Type that throws on copy (for exception safety tests)
     struct ThrowsOnCopy
     {
@@ -69,8 +79,62 @@ namespace
     };
     int ThrowsOnCopy::copyCount = 0;
     int ThrowsOnCopy::throwAfter = 100;
+
+    // Stateless allocator that counts allocations across all rebinds
+    int gAllocationCount = 0;
+    template<typename T>
+    struct CountingAllocator
+    {
+        using value_type = T;
+
+        CountingAllocator() = default;
+        template<typename U>
+        CountingAllocator(CountingAllocator<U> const&) noexcept
+        {
+        }
+
+        T* allocate(size_t n)
+        {
+            ++gAllocationCount;
+            return std::allocator<T> {}.allocate(n);
+        }
+        void deallocate(T* p, size_t n) noexcept { std::allocator<T> {}.deallocate(p, n); }
+
+        template<typename U>
+        bool operator==(CountingAllocator<U> const&) const noexcept
+        {
+            return true;
+        }
+    };
+
+    // String hash that counts its calls, to check when rehashing hashes elements again
+    int gStringHashCount = 0;
+    struct CountingStringHash
+    {
+        size_t operator()(std::string const& s) const noexcept
+        {
+            ++gStringHashCount;
+            return std::hash<std::string> {}(s);
+        }
+    };
+
+    // Key type with inline storage enabled below
+    enum class InlineKey : int
+    {
+    };
 }  // namespace
 
+template<>
+struct alp::InlineCapacitySelector<InlineKey>
+{
+    static constexpr size_t value = 128 / sizeof(InlineKey);
+};
+template<>
+struct alp::InlineCapacitySelector<std::unique_ptr<InlineKey>>
+{
+    static constexpr size_t value = 8;
+};
+
 template<>
 struct std::hash<DestructorCounter>
 {
@@ -118,13 +182,28 @@ using SetNoHashStorage = alp::Set<int,
                                   std::ratio<7, 8>,
                                   alp::NoStoreHashTag>;
 
+using SetBlockedCtrl = alp::Set<int,
+                                std::hash<int>,
+                                std::equal_to<int>,
+                                alp::MixHashPolicy,
+                                alp::DefaultBackend,
+                                std::allocator<std::byte>,
+                                std::ratio<7, 8>,
+                                alp::StoreHashTag,
+                                alp::QuadraticProbing,
+                                alp::NoShrinkPolicy,
+                                alp::BlockedCtrlTag>;
+
 template<typename T>
 class SetTypedTest : public ::testing::Test
 {
 };
 
-using SetTypes =
-    ::testing::Types<SetLinearProbing, SetQuadraticProbing, SetIdentityPolicy, SetNoHashStorage>;
+using SetTypes = ::testing::Types<SetLinearProbing,
+                                  SetQuadraticProbing,
+                                  SetIdentityPolicy,
+                                  SetNoHashStorage,
+                                  SetBlockedCtrl>;
 
 TYPED_TEST_SUITE(SetTypedTest, SetTypes);
 
@@ -410,6 +489,58 @@ TYPED_TEST(SetTypedTest, SingleElement)
     EXPECT_EQ(it, s.end());
 }
 
+TYPED_TEST(SetTypedTest, IterationMidMigration)
+{
+    TypeParam s;
+    s.set_incremental_rehash(1);
+    for (int i = 0; i < 1000; ++i)
+    {
+        s.emplace(i);
+    }
+    size_t capacity = s.capacity();
+    int next = 1000;
+    while (s.capacity() == capacity)
+    {
+        s.emplace(next++);
+    }
+
+    // Iterators into the buffer being drained run on into the live one
+    static_assert(sizeof(typename TypeParam::iterator) == 2 * sizeof(void*));
+    int count = 0;
+    int64_t sum = 0;
+    for (int v : s)
+    {
+        ++count;
+        sum += v;
+    }
+    EXPECT_EQ(count, next);
+    EXPECT_EQ(sum, int64_t {next} * (next - 1) / 2);
+    for (int key : {0, next - 1})
+    {
+        auto found = s.find(key);
+        int before = 0;
+        for (auto it = s.begin(); it != found; ++it)
+        {
+            ++before;
+        }
+        int after = 0;
+        for (auto it = found; it != s.end(); ++it)
+        {
+            ++after;
+        }
+        EXPECT_EQ(before + after, next) << "Key: " << key;
+    }
+
+    // reserve() completes the move, even when it does not need to grow
+    s.reserve(s.size());
+    count = 0;
+    for (auto it = s.begin(); it != s.end(); ++it)
+    {
+        ++count;
+    }
+    EXPECT_EQ(count, next);
+}
+
 // =============================================================================
 // Regular Tests (type-specific tests that can't be parametrized)
 // =============================================================================
@@ -640,6 +771,154 @@ TEST(SetCollision, TombstoneReuse)
     EXPECT_TRUE(s.contains(128));
     EXPECT_TRUE(s.contains(256));
 }
+TEST(SetCollision, TombstoneSlotIsClaimed)
+{
+    // Two SSE groups; keys below 128 all start probing in group 0.
+    using CollisionSet = alp::Set<int,
+                                  IdentityHash,
+                                  std::equal_to<int>,
+                                  alp::IdentityHashPolicy,
+                                  alp::SseBackend,
+                                  std::allocator<std::byte>,
+                                  std::ratio<7, 8>>;
+    CollisionSet s(20);
+    // Fill group 0 completely so that an erase leaves a tombstone behind
+    for (int i = 0; i < 16; ++i)
+    {
+        s.emplace(i);
+    }
+    int const* erasedAddr = &*s.find(5);
+    s.erase(5);
+    EXPECT_FALSE(s.contains(5));
+
+    // 256 also starts in group 0; it must land in the deleted slot
+    auto [it, inserted] = s.emplace(256);
+    EXPECT_TRUE(inserted);
+    EXPECT_EQ(&*it, erasedAddr);
+    for (int i = 0; i < 16; ++i)
+    {
+        EXPECT_EQ(s.contains(i), i != 5) << "Key: " << i;
+    }
+    EXPECT_TRUE(s.contains(256));
+
+    // Re-inserting an existing key must not claim another tombstone
+    s.erase(7);
+    auto [dupIt, dupInserted] = s.emplace(256);
+    EXPECT_FALSE(dupInserted);
+    EXPECT_EQ(&*dupIt, erasedAddr);
+    EXPECT_EQ(s.size(), 15);
+}
+TEST(SetCollision, ChurnKeepsElementsFindable)
+{
+    alp::Set<int> s;
+    for (int i = 0; i < 200; ++i)
+    {
+        s.emplace(i);
+    }
+    // Repeatedly replace a sliding window of keys
+    for (int round = 0; round < 50; ++round)
+    {
+        for (int i = 0; i < 100; ++i)
+        {
+            s.erase(round * 100 + i);
+            s.emplace(200 + round * 100 + i);
+        }
+    }
+    EXPECT_EQ(s.size(), 200);
+    for (int i = 0; i < 5000; ++i)
+    {
+        EXPECT_FALSE(s.contains(i)) << "Should be erased: " << i;
+    }
+    for (int i = 5000; i < 5200; ++i)
+    {
+        EXPECT_TRUE(s.contains(i)) << "Missing: " << i;
+    }
+}
+TEST(SetCollision, TombstonesPurgedWithoutAllocating)
+{
+    // Two SSE groups; keys below 128 start probing in group 0, keys in [128, 256) in group 1.
+    using CountingSet = alp::Set<int,
+                                 IdentityHash,
+                                 std::equal_to<int>,
+                                 alp::IdentityHashPolicy,
+                                 alp::SseBackend,
+                                 CountingAllocator<std::byte>,
+                                 std::ratio<7, 8>>;
+    CountingSet s(20);
+    // Fill group 0, then overflow three keys into group 1
+    for (int i = 0; i < 19; ++i)
+    {
+        s.emplace(i);
+    }
+    std::vector<int const*> freedAddrs;
+    for (int i = 0; i < 8; ++i)
+    {
+        freedAddrs.push_back(&*s.find(i));
+        s.erase(i);
+    }
+    int allocationsBefore = gAllocationCount;
+
+    // Use up the remaining empty slots in group 1; the last insertion has to make room
+    for (int i = 128; i < 137; ++i)
+    {
+        s.emplace(i);
+    }
+    EXPECT_EQ(gAllocationCount, allocationsBefore);
+    EXPECT_EQ(s.size(), 20);
+
+    // The overflowed keys moved back into their home group
+    for (int i = 16; i < 19; ++i)
+    {
+        EXPECT_NE(std::ranges::find(freedAddrs, &*s.find(i)), freedAddrs.end()) << "Key: " << i;
+    }
+    for (int i = 0; i < 19; ++i)
+    {
+        EXPECT_EQ(s.contains(i), i >= 8) << "Key: " << i;
+    }
+    for (int i = 128; i < 137; ++i)
+    {
+        EXPECT_TRUE(s.contains(i)) << "Key: " << i;
+    }
+}
+TEST(SetCollision, TombstonePurgeMovesNonTrivialElements)
+{
+    using StringSet = alp::Set<std::string,
+                               StringIdentityHash,
+                               std::equal_to<std::string>,
+                               alp::IdentityHashPolicy,
+                               alp::SseBackend,
+                               std::allocator<std::byte>,
+                               std::ratio<7, 8>>;
+    StringSet s(20);
+    for (int i = 0; i < 19; ++i)
+    {
+        s.emplace(std::to_string(i));
+    }
+    for (int i = 0; i < 8; ++i)
+    {
+        s.erase(std::to_string(i));
+    }
+    for (int i = 128; i < 137; ++i)
+    {
+        s.emplace(std::to_string(i));
+    }
+    EXPECT_EQ(s.size(), 20);
+    for (int i = 0; i < 19; ++i)
+    {
+        EXPECT_EQ(s.contains(std::to_string(i)), i >= 8) << "Key: " << i;
+    }
+    for (int i = 128; i < 137; ++i)
+    {
+        EXPECT_TRUE(s.contains(std::to_string(i))) << "Key: " << i;
+    }
+    size_t count = 0;
+    for (auto const& str : s)
+    {
+        EXPECT_TRUE(s.contains(str));
+        ++count;
+    }
+    EXPECT_EQ(count, 20);
+}
 TEST(SetCollision, MultipleDeletesAndInserts)
 {
     alp::Set<int> s;
@@ -674,6 +953,120 @@ TEST(SetCollision, MultipleDeletesAndInserts)
     }
 }
 
+TEST(SetBatch, FindManyMatchesFind)
+{
+    alp::Set<std::string> s;
+    std::vector<std::string> keys;
+    for (int i = 0; i < 500; ++i)
+    {
+        if (i % 3 == 0)
+        {
+            s.emplace(std::to_string(i));
+        }
+        keys.push_back(std::to_string(i));
+    }
+    // Not a multiple of the batch size
+    keys.resize(487);
+
+    std::vector<std::string const*> elements(keys.size());
+    s.find_many(keys, elements);
+    auto found = std::make_unique<bool[]>(keys.size());
+    EXPECT_EQ(s.contains_many(keys, {found.get(), keys.size()}), 163);
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        auto it = s.find(keys[i]);
+        EXPECT_EQ(elements[i], it == s.end() ? nullptr : &*it) << "Key: " << keys[i];
+        EXPECT_EQ(found[i], it != s.end()) << "Key: " << keys[i];
+    }
+}
+TEST(SetBatch, EmptySet)
+{
+    alp::Set<int> s;
+    std::vector<int> keys {1, 2, 3};
+    std::vector<int const*> elements(keys.size(), &keys[0]);
+    s.find_many(keys, elements);
+    for (auto* element : elements)
+    {
+        EXPECT_EQ(element, nullptr);
+    }
+}
+
+TEST(SetPrecomputedHash, FindAndEmplace)
+{
+    alp::Set<std::string> s;
+    std::string key = "precomputed";
+    size_t hash = s.hash_function()(key);
+    auto [it, inserted] = s.emplace_with_hash(hash, key);
+    EXPECT_TRUE(inserted);
+    EXPECT_FALSE(s.emplace_with_hash(hash, key).second);
+    EXPECT_FALSE(s.emplace_with_hash(hash, key.data(), key.size()).second);
+    EXPECT_EQ(s.find_with_hash(key, hash), it);
+    EXPECT_EQ(s.find(key), it);
+    EXPECT_TRUE(s.contains_with_hash(key, hash));
+    EXPECT_EQ(s.size(), 1);
+
+    // Survives rehashing, which recomputes hashes from the elements
+    for (int i = 0; i < 1000; ++i)
+    {
+        std::string k = std::to_string(i);
+        s.emplace_with_hash(s.hash_function()(k), std::move(k));
+    }
+    EXPECT_TRUE(s.contains_with_hash(key, hash));
+    EXPECT_TRUE(s.contains(std::string("999")));
+}
+
+TEST(SetRange, InsertRangeSkipsDuplicates)
+{
+    alp::Set<std::string> s;
+    s.emplace("b");
+    std::vector<std::string> words {"a", "b", "c", "a", "d", "c"};
+    s.insert_range(words);
+    EXPECT_EQ(s.size(), 4);
+    for (auto const& w : {"a", "b", "c", "d"})
+    {
+        EXPECT_TRUE(s.contains(std::string(w))) << "Missing: " << w;
+    }
+    // Elements are copied from an lvalue range
+    EXPECT_EQ(words[0], "a");
+}
+
+TEST(SetRange, FromRangeAllocatesOnce)
+{
+    using CountingSet = alp::Set<int,
+                                 std::hash<int>,
+                                 std::equal_to<int>,
+                                 alp::HashPolicySelector<int, std::hash<int>>::type,
+                                 alp::DefaultBackend,
+                                 CountingAllocator<std::byte>>;
+    std::vector<int> data(5000);
+    for (int i = 0; i < 5000; ++i)
+    {
+        data[i] = i;
+    }
+    int allocationsBefore = gAllocationCount;
+    CountingSet s(std::from_range, data);
+    EXPECT_EQ(gAllocationCount, allocationsBefore + 1);
+    EXPECT_EQ(s.size(), 5000);
+    for (int i = 0; i < 5000; ++i)
+    {
+        EXPECT_TRUE(s.contains(i)) << "Missing: " << i;
+    }
+}
+
+TEST(SetRange, InputAndConvertingRanges)
+{
+    // Elements produced by value take the unbatched path
+    auto values = std::views::iota(0, 1000) | std::views::transform([](int i) { return i % 300; });
+    alp::Set<int> s(std::from_range, values);
+    EXPECT_EQ(s.size(), 300);
+
+    alp::Set<std::string> words;
+    std::vector<char const*> raw {"x", "y", "x"};
+    words.insert_range(raw);
+    EXPECT_EQ(words.size(), 2);
+    EXPECT_TRUE(words.contains(std::string("y")));
+}
+
 TEST(SetIterator, SparseIteration)
 {
     alp::Set<int> s;
@@ -803,6 +1196,606 @@ TEST(SetRehash, ReserveDoesNotShrink)
     EXPECT_TRUE(s.contains(2));
 }
 
+TEST(SetRehash, ShrinkToFit)
+{
+    alp::Set<int> s;
+    for (int i = 0; i < 10000; ++i)
+    {
+        s.emplace(i);
+    }
+    size_t grownCapacity = s.capacity();
+    for (int i = 10; i < 10000; ++i)
+    {
+        s.erase(i);
+    }
+    // Erasing alone keeps the memory
+    EXPECT_EQ(s.capacity(), grownCapacity);
+
+    s.shrink_to_fit();
+    EXPECT_LT(s.capacity(), grownCapacity);
+    EXPECT_GE(s.capacity(), s.size());
+    EXPECT_EQ(s.size(), 10);
+    for (int i = 0; i < 10; ++i)
+    {
+        EXPECT_TRUE(s.contains(i));
+    }
+    int count = 0;
+    for (auto it = s.begin(); it != s.end(); ++it)
+    {
+        ++count;
+    }
+    EXPECT_EQ(count, 10);
+
+    // Already minimal: nothing changes
+    size_t shrunkCapacity = s.capacity();
+    s.shrink_to_fit();
+    EXPECT_EQ(s.capacity(), shrunkCapacity);
+}
+TEST(SetRehash, ShrinkToFitEmptyReleasesMemory)
+{
+    alp::Set<std::string> s;
+    s.reserve(1000);
+    s.emplace("a");
+    s.erase("a");
+    s.shrink_to_fit();
+    EXPECT_EQ(s.capacity(), 0);
+    EXPECT_EQ(s.begin(), s.end());
+    s.emplace("b");
+    EXPECT_TRUE(s.contains(std::string("b")));
+}
+TEST(SetRehash, ShrinkPolicyAfterErase)
+{
+    using ShrinkingSet = alp::Set<int,
+                                  alp::RapidHasher,
+                                  std::equal_to<int>,
+                                  alp::IdentityHashPolicy,
+                                  alp::DefaultBackend,
+                                  std::allocator<std::byte>,
+                                  alp::DefaultLoadFactor,
+                                  alp::NoStoreHashTag,
+                                  alp::DefaultProber,
+                                  alp::ShrinkBelowRatio<std::ratio<1, 4>>>;
+    ShrinkingSet s;
+    for (int i = 0; i < 4096; ++i)
+    {
+        s.emplace(i);
+    }
+    size_t grownCapacity = s.capacity();
+
+    // Erasing never rebuilds the table, so erasing while iterating stays valid
+    for (auto it = s.begin(); it != s.end();)
+    {
+        auto next = it;
+        ++next;
+        if (*it < 4000)
+        {
+            s.erase(it);
+        }
+        it = next;
+    }
+    EXPECT_EQ(s.capacity(), grownCapacity);
+    EXPECT_EQ(s.size(), 96);
+
+    // The next insertion shrinks it to fit
+    s.emplace(4096);
+    EXPECT_LT(s.capacity(), grownCapacity);
+    EXPECT_GE(s.size() * 4, s.capacity());
+    for (int i = 4000; i <= 4096; ++i)
+    {
+        EXPECT_TRUE(s.contains(i)) << "Missing after shrink: " << i;
+    }
+
+    // Erasing down to a few elements and reinserting keeps capacity near the size
+    for (int i = 4000; i < 4090; ++i)
+    {
+        s.erase(i);
+        s.emplace(i + 10000);
+        s.erase(i + 10000);
+    }
+    EXPECT_EQ(s.size(), 7);
+    EXPECT_LE(s.capacity(), alp::DefaultBackend::GroupSize * 2);
+}
+
+TEST(SetRehash, ShrinkOnInsertLeavesRoomForTheNewElement)
+{
+    using ShrinkingSet = alp::Set<int,
+                                  alp::RapidHasher,
+                                  std::equal_to<int>,
+                                  alp::IdentityHashPolicy,
+                                  alp::DefaultBackend,
+                                  CountingAllocator<std::byte>,
+                                  alp::DefaultLoadFactor,
+                                  alp::NoStoreHashTag,
+                                  alp::DefaultProber,
+                                  alp::ShrinkBelowRatio<std::ratio<1, 4>>>;
+    // Every size up to a few groups, so that some sit right at a group's growth limit
+    for (int size = 1; size <= 3 * static_cast<int>(alp::DefaultBackend::GroupSize); ++size)
+    {
+        ShrinkingSet s;
+        for (int i = 0; i < 1024; ++i)
+        {
+            s.emplace(i);
+        }
+        for (int i = size; i < 1024; ++i)
+        {
+            s.erase(i);
+        }
+        size_t sparseCapacity = s.capacity();
+
+        // Finding the key present leaves the table as it is
+        gAllocationCount = 0;
+        EXPECT_FALSE(s.emplace(0).second);
+        EXPECT_EQ(s.capacity(), sparseCapacity);
+
+        // A new key shrinks the table once, to the groups that fit it along with the rest
+        EXPECT_TRUE(s.emplace(size).second);
+        EXPECT_EQ(gAllocationCount, 1) << "Size: " << size;
+        ShrinkingSet fitted = s;
+        fitted.shrink_to_fit();
+        EXPECT_EQ(s.capacity(), fitted.capacity()) << "Size: " << size;
+        EXPECT_LT(s.capacity(), sparseCapacity);
+    }
+}
+
+TEST(SetRehash, ParallelGrowKeepsAllElements)
+{
+    alp::Set<int> s;
+    s.set_rehash_threads(4);
+    EXPECT_EQ(s.rehash_threads(), 4);
+    // Grows several times past the size where rehashing goes parallel
+    for (int i = 0; i < 300000; ++i)
+    {
+        s.emplace(i);
+    }
+    EXPECT_EQ(s.size(), 300000);
+    for (int i = 0; i < 300000; ++i)
+    {
+        ASSERT_TRUE(s.contains(i)) << "Missing: " << i;
+    }
+    EXPECT_FALSE(s.contains(300000));
+
+    int count = 0;
+    for ([[maybe_unused]] int v : s)
+    {
+        ++count;
+    }
+    EXPECT_EQ(count, 300000);
+}
+
+TEST(SetRehash, ParallelRehashNonTrivialAndUnstoredHashes)
+{
+    alp::Set<std::string> strings;
+    strings.set_rehash_threads(3);
+    alp::Set<int,
+             std::hash<int>,
+             std::equal_to<int>,
+             alp::MixHashPolicy,
+             alp::DefaultBackend,
+             std::allocator<std::byte>,
+             alp::DefaultLoadFactor,
+             alp::NoStoreHashTag>
+        unstored;
+    unstored.set_rehash_threads(0);
+    EXPECT_GE(unstored.rehash_threads(), 1);
+    for (int i = 0; i < 100000; ++i)
+    {
+        strings.emplace(std::to_string(i));
+        unstored.emplace(i);
+    }
+    strings.reserve(400000);
+    for (int i = 0; i < 100000; ++i)
+    {
+        ASSERT_TRUE(strings.contains(std::to_string(i))) << "Missing: " << i;
+        ASSERT_TRUE(unstored.contains(i)) << "Missing: " << i;
+    }
+
+    // Shrinking goes through the same path
+    for (int i = 0; i < 100000; i += 4)
+    {
+        unstored.erase(i);
+    }
+    unstored.shrink_to_fit();
+    EXPECT_EQ(unstored.size(), 75000);
+    for (int i = 0; i < 100000; ++i)
+    {
+        ASSERT_EQ(unstored.contains(i), i % 4 != 0) << "Key: " << i;
+    }
+}
+
+TEST(SetRehash, ThrowingHashRehashesOnCallingThread)
+{
+    // A hasher that may throw must not run on worker threads, where throwing terminates
+    static std::thread::id caller;
+    static bool calledElsewhere;
+    struct MayThrowHash
+    {
+        size_t operator()(int x) const
+        {
+            calledElsewhere |= std::this_thread::get_id() != caller;
+            return std::hash<int> {}(x);
+        }
+    };
+    caller = std::this_thread::get_id();
+    calledElsewhere = false;
+    alp::Set<int,
+             MayThrowHash,
+             std::equal_to<int>,
+             alp::MixHashPolicy,
+             alp::DefaultBackend,
+             std::allocator<std::byte>,
+             alp::DefaultLoadFactor,
+             alp::NoStoreHashTag>
+        s;
+    s.set_rehash_threads(4);
+    for (int i = 0; i < 200000; ++i)
+    {
+        s.emplace(i);
+    }
+    EXPECT_FALSE(calledElsewhere);
+    EXPECT_EQ(s.size(), 200000);
+}
+
+TEST(SetRehash, ThrowingHashPurgesTombstonesIntoANewBuffer)
+{
+    // Purging in place relabels live elements first, so a hasher that may throw partway
+    // through must go through a rebuild into a new buffer instead. Both hashers give each
+    // run of 100 keys one probe sequence, whose full groups keep erased slots deleted.
+    struct MayThrowHash
+    {
+        size_t operator()(int x) const { return static_cast<size_t>(x / 100); }
+    };
+    struct NothrowHash
+    {
+        size_t operator()(int x) const noexcept { return static_cast<size_t>(x / 100); }
+    };
+    auto churn = [](auto& s)
+    {
+        // The size stays at 100 while tombstones pile up and get purged
+        s.reserve(1000);
+        size_t capacity = s.capacity();
+        gAllocationCount = 0;
+        for (int i = 0; i < 20000; ++i)
+        {
+            s.emplace(i);
+            if (i >= 100)
+            {
+                s.erase(i - 100);
+            }
+        }
+        EXPECT_EQ(s.capacity(), capacity);
+        EXPECT_EQ(s.size(), 100);
+        for (int i = 19900; i < 20000; ++i)
+        {
+            EXPECT_TRUE(s.contains(i)) << "Missing: " << i;
+        }
+        return gAllocationCount;
+    };
+    alp::Set<int,
+             MayThrowHash,
+             std::equal_to<int>,
+             alp::MixHashPolicy,
+             alp::DefaultBackend,
+             CountingAllocator<std::byte>,
+             alp::DefaultLoadFactor,
+             alp::NoStoreHashTag>
+        mayThrow;
+    alp::Set<int,
+             NothrowHash,
+             std::equal_to<int>,
+             alp::MixHashPolicy,
+             alp::DefaultBackend,
+             CountingAllocator<std::byte>,
+             alp::DefaultLoadFactor,
+             alp::NoStoreHashTag>
+        nothrow;
+    EXPECT_GT(churn(mayThrow), 0);
+    EXPECT_EQ(churn(nothrow), 0);
+}
+
+TEST(SetRehash, IncrementalGrowthKeepsAllElements)
+{
+    alp::Set<std::string> s;
+    s.set_incremental_rehash(1);
+    EXPECT_EQ(s.incremental_rehash(), 1);
+    for (int i = 0; i < 20000; ++i)
+    {
+        s.emplace(std::to_string(i));
+        // Elements inserted so far must be visible whichever buffer they are in
+        if (i % 997 == 0)
+        {
+            for (int j = 0; j <= i; ++j)
+            {
+                ASSERT_TRUE(s.contains(std::to_string(j))) << "Missing " << j << " after " << i;
+            }
+        }
+    }
+    EXPECT_EQ(s.size(), 20000);
+    EXPECT_FALSE(s.emplace("0").second);
+}
+
+TEST(SetRehash, IncrementalGrowthOfByteSlots)
+{
+    // One-byte slots leave the least room for the position of the live buffer
+    alp::Set<uint8_t,
+             std::hash<uint8_t>,
+             std::equal_to<uint8_t>,
+             alp::MixHashPolicy,
+             alp::DefaultBackend,
+             std::allocator<std::byte>,
+             alp::DefaultLoadFactor,
+             alp::NoStoreHashTag>
+        s;
+    s.set_incremental_rehash(1);
+    for (int i = 0; i < 256; ++i)
+    {
+        s.emplace(static_cast<uint8_t>(i));
+        int count = 0;
+        for ([[maybe_unused]] uint8_t v : s)
+        {
+            ++count;
+        }
+        ASSERT_EQ(count, i + 1);
+    }
+    for (int i = 0; i < 256; ++i)
+    {
+        EXPECT_TRUE(s.contains(static_cast<uint8_t>(i))) << "Missing: " << i;
+    }
+}
+
+TEST(SetRehash, IncrementalGrowthMidMigration)
+{
+    alp::Set<std::string> s;
+    s.set_incremental_rehash(1);
+    for (int i = 0; i < 1000; ++i)
+    {
+        s.emplace(std::to_string(i));
+    }
+    // Grow, then stop right after: most old groups have not been moved yet
+    size_t capacity = s.capacity();
+    int next = 1000;
+    while (s.capacity() == capacity)
+    {
+        s.emplace(std::to_string(next++));
+    }
+
+    int count = 0;
+    for ([[maybe_unused]] auto const& v : s)
+    {
+        ++count;
+    }
+    EXPECT_EQ(count, next);
+
+    alp::Set<std::string> copy(s);
+    EXPECT_EQ(copy.size(), s.size());
+    for (int i = 0; i < next; ++i)
+    {
+        ASSERT_TRUE(copy.contains(std::to_string(i))) << "Missing: " << i;
+    }
+
+    // Erase from both buffers, by key and by iterator
+    EXPECT_EQ(s.erase(std::string("0")), 1);
+    EXPECT_EQ(s.erase(std::to_string(next - 1)), 1);
+    s.erase(s.find(std::string("500")));
+    EXPECT_FALSE(s.contains(std::string("0")));
+    EXPECT_FALSE(s.contains(std::string("500")));
+    EXPECT_EQ(s.size(), static_cast<size_t>(next - 3));
+
+    for (auto it = s.begin(); it != s.end();)
+    {
+        auto current = it;
+        ++it;
+        if (std::stoi(*current) % 2 == 0)
+        {
+            s.erase(current);
+        }
+    }
+    for (int i = 0; i < next; ++i)
+    {
+        EXPECT_EQ(s.contains(std::to_string(i)), i % 2 == 1 && i != next - 1) << "Key: " << i;
+    }
+}
+
+TEST(SetHashStorage, CompactHashRehashesWithoutHashing)
+{
+    alp::Set<std::string,
+             CountingStringHash,
+             std::equal_to<std::string>,
+             alp::MixHashPolicy,
+             alp::DefaultBackend,
+             std::allocator<std::byte>,
+             alp::DefaultLoadFactor,
+             alp::CompactHashTag>
+        s;
+    for (int i = 0; i < 100000; ++i)
+    {
+        s.emplace(std::to_string(i));
+    }
+    gStringHashCount = 0;
+    s.reserve(1 << 20);
+    s.set_rehash_threads(4);
+    s.reserve(1 << 21);
+    EXPECT_EQ(gStringHashCount, 0);
+
+    // Churn until tombstones are cleared, then grow incrementally
+    for (int i = 0; i < 100000; i += 2)
+    {
+        s.erase(std::to_string(i));
+    }
+    s.shrink_to_fit();
+    s.set_incremental_rehash(1);
+    for (int i = 100000; i < 200000; ++i)
+    {
+        s.emplace(std::to_string(i));
+        s.erase(std::to_string(i - 99999));
+    }
+    auto copy = s;
+    for (int i = 0; i < 200000; ++i)
+    {
+        bool expected = i >= 100001;
+        ASSERT_EQ(s.contains(std::to_string(i)), expected) << "Key: " << i;
+        ASSERT_EQ(copy.contains(std::to_string(i)), expected) << "Key: " << i;
+    }
+}
+
+TEST(SetLayout, BlockedCtrlRehashPathsKeepElements)
+{
+    alp::Set<std::string,
+             alp::RapidHasher,
+             std::equal_to<std::string>,
+             alp::HashPolicySelector<std::string, alp::RapidHasher>::type,
+             alp::DefaultBackend,
+             std::allocator<std::byte>,
+             alp::DefaultLoadFactor,
+             alp::NoStoreHashTag,
+             alp::DefaultProber,
+             alp::DefaultShrinkPolicy,
+             alp::BlockedCtrlTag>
+        s;
+    s.set_incremental_rehash(1);
+    for (int i = 0; i < 70000; ++i)
+    {
+        s.emplace(std::to_string(i));
+    }
+    auto midMigration = s;
+    s.set_incremental_rehash(0);
+    s.set_rehash_threads(4);
+    s.reserve(1 << 18);
+
+    // Churn at a fixed size until tombstones are purged in place
+    for (int i = 70000; i < 400000; ++i)
+    {
+        s.emplace(std::to_string(i));
+        s.erase(std::to_string(i - 70000));
+    }
+    EXPECT_EQ(s.size(), 70000);
+    size_t count = 0;
+    for (auto const& v : s)
+    {
+        ASSERT_GE(std::stoi(v), 330000) << "Key: " << v;
+        ++count;
+    }
+    EXPECT_EQ(count, 70000);
+    for (int i = 0; i < 70000; ++i)
+    {
+        ASSERT_TRUE(midMigration.contains(std::to_string(i))) << "Missing: " << i;
+    }
+}
+
+TEST(SetInline, TinySetDoesNotAllocate)
+{
+    using CountingSet = alp::Set<InlineKey,
+                                 std::hash<InlineKey>,
+                                 std::equal_to<InlineKey>,
+                                 alp::MixHashPolicy,
+                                 alp::DefaultBackend,
+                                 CountingAllocator<std::byte>>;
+    int allocationsBefore = gAllocationCount;
+    CountingSet s;
+    for (int i = 0; i < 5; ++i)
+    {
+        s.emplace(InlineKey {i});
+    }
+    s.erase(InlineKey {2});
+    s.emplace(InlineKey {7});
+    EXPECT_EQ(gAllocationCount, allocationsBefore);
+    EXPECT_LE(s.capacity(), alp::DefaultBackend::GroupSize - 1);
+
+    CountingSet copy(s);
+    EXPECT_EQ(gAllocationCount, allocationsBefore);
+    EXPECT_EQ(copy.size(), 5);
+    EXPECT_TRUE(copy.contains(InlineKey {7}));
+    EXPECT_FALSE(copy.contains(InlineKey {2}));
+
+    // Outgrowing the inline slots moves everything to an allocated buffer
+    for (int i = 10; i < 100; ++i)
+    {
+        s.emplace(InlineKey {i});
+    }
+    EXPECT_GT(gAllocationCount, allocationsBefore);
+    for (int i : {0, 1, 3, 4, 7, 10, 50, 99})
+    {
+        EXPECT_TRUE(s.contains(InlineKey {i})) << "Missing: " << i;
+    }
+    EXPECT_EQ(s.size(), 95);
+
+    // Without opting in, tables allocate their first element and stay small
+    alp::Set<int,
+             alp::RapidHasher,
+             std::equal_to<int>,
+             alp::IdentityHashPolicy,
+             alp::DefaultBackend,
+             CountingAllocator<std::byte>>
+        plain;
+    allocationsBefore = gAllocationCount;
+    plain.emplace(1);
+    EXPECT_EQ(gAllocationCount, allocationsBefore + 1);
+    EXPECT_LT(sizeof(plain), sizeof(s));
+}
+
+TEST(SetInline, SwapAndMoveRelocateElements)
+{
+    alp::Set<std::unique_ptr<InlineKey>> small;
+    alp::Set<std::unique_ptr<InlineKey>> otherSmall;
+    alp::Set<std::unique_ptr<InlineKey>> large;
+    for (int i = 0; i < 3; ++i)
+    {
+        small.emplace(std::make_unique<InlineKey>(InlineKey {i}));
+        otherSmall.emplace(std::make_unique<InlineKey>(InlineKey {100 + i}));
+    }
+    for (int i = 0; i < 100; ++i)
+    {
+        large.emplace(std::make_unique<InlineKey>(InlineKey {1000 + i}));
+    }
+    auto sum = [](auto const& set)
+    {
+        int total = 0;
+        for (auto const& p : set)
+        {
+            total += static_cast<int>(*p);
+        }
+        return total;
+    };
+
+    swap(small, otherSmall);
+    EXPECT_EQ(sum(small), 303);
+    EXPECT_EQ(sum(otherSmall), 3);
+
+    swap(small, large);
+    EXPECT_EQ(small.size(), 100);
+    EXPECT_EQ(sum(large), 303);
+    large.emplace(std::make_unique<InlineKey>(InlineKey {7}));
+    EXPECT_EQ(sum(large), 310);
+
+    alp::Set<std::unique_ptr<InlineKey>> moved(std::move(otherSmall));
+    EXPECT_EQ(sum(moved), 3);
+    EXPECT_TRUE(otherSmall.empty());
+    otherSmall.emplace(std::make_unique<InlineKey>(InlineKey {5}));
+    EXPECT_EQ(sum(otherSmall), 5);
+}
+
+TEST(SetTypes, InsertExistingDoesNotCopy)
+{
+    alp::Set<DestructorCounter> s;
+    DestructorCounter value {7};
+    s.insert(value);
+    gDestructionCount = 0;
+    // A temporary copy would be destroyed again
+    EXPECT_FALSE(s.insert(value).second);
+    EXPECT_FALSE(s.emplace(value).second);
+    EXPECT_EQ(gDestructionCount, 0);
+    EXPECT_EQ(s.size(), 1);
+}
+TEST(SetTypes, InsertMovesDirectlyIntoSlot)
+{
+    alp::Set<std::unique_ptr<int>> s;
+    s.reserve(4);
+    auto ptr = std::make_unique<int>(5);
+    int* raw = ptr.get();
+    auto [it, inserted] = s.insert(std::move(ptr));
+    EXPECT_TRUE(inserted);
+    EXPECT_EQ(it->get(), raw);
+    EXPECT_EQ(ptr, nullptr);
+}
 TEST(SetTypes, MoveOnlyType)
 {
     alp::Set<std::unique_ptr<int>> s;
@@ -834,6 +1827,30 @@ TEST(SetTypes, CopyConstruction)
         EXPECT_TRUE(s2.contains(i));
     }
 }
+TEST(SetTypes, CopyKeepsProbeChainsPastTombstones)
+{
+    // Every element shares one probe sequence, so erasing the first ones
+    // leaves tombstones in front of the rest
+    struct ConstantHash
+    {
+        size_t operator()(int) const noexcept { return 0; }
+    };
+    alp::Set<int, ConstantHash> s1;
+    for (int i = 0; i < 64; ++i)
+    {
+        s1.emplace(i);
+    }
+    for (int i = 0; i < 32; ++i)
+    {
+        s1.erase(i);
+    }
+    alp::Set<int, ConstantHash> s2(s1);
+    EXPECT_EQ(s2.size(), 32);
+    for (int i = 0; i < 64; ++i)
+    {
+        EXPECT_EQ(s2.contains(i), i >= 32) << "Key: " << i;
+    }
+}
 TEST(SetTypes, MoveConstruction)
 {
     alp::Set<int> s1;
@@ -974,4 +1991,161 @@ TEST(SetEdge, SingleElement)
     EXPECT_EQ(*it, 42);
     ++it;
     EXPECT_EQ(it, s.end());
-}
\ No newline at end of file
+}
+TEST(SetSerialization, RoundTripRestoresElements)
+{
+    alp::Set<int64_t> s;
+    for (int64_t i = 0; i < 10000; ++i)
+    {
+        s.emplace(i * 3);
+    }
+    for (int64_t i = 0; i < 10000; i += 4)
+    {
+        s.erase(i * 3);
+    }
+
+    std::stringstream stream;
+    ASSERT_TRUE(s.save(stream));
+    auto loaded = alp::Set<int64_t>::load(stream);
+    ASSERT_TRUE(loaded);
+    EXPECT_EQ(loaded->size(), s.size());
+    EXPECT_EQ(loaded->capacity(), s.capacity());
+    for (auto v : s)
+    {
+        ASSERT_TRUE(loaded->contains(v)) << "Missing: " << v;
+    }
+
+    // The loaded set is an ordinary one
+    for (int64_t i = 0; i < 20000; ++i)
+    {
+        loaded->emplace(i * 3 + 1);
+    }
+    EXPECT_EQ(loaded->size(), s.size() + 20000);
+    EXPECT_TRUE(loaded->contains(int64_t {9}));
+    EXPECT_FALSE(loaded->contains(int64_t {12}));
+}
+
+TEST(SetSerialization, InlineEmptyAndMidRehashTables)
+{
+    alp::Set<int> tiny;
+    for (int i : {1, 2, 3})
+    {
+        tiny.emplace(i);
+    }
+    std::stringstream tinyStream;
+    ASSERT_TRUE(tiny.save(tinyStream));
+    auto loadedTiny = alp::Set<int>::load(tinyStream);
+    ASSERT_TRUE(loadedTiny);
+    EXPECT_EQ(loadedTiny->size(), 3);
+    EXPECT_TRUE(loadedTiny->contains(1) && loadedTiny->contains(3));
+    loadedTiny->emplace(4);
+    EXPECT_TRUE(loadedTiny->contains(4));
+
+    alp::Set<int> empty;
+    std::stringstream emptyStream;
+    ASSERT_TRUE(empty.save(emptyStream));
+    auto loadedEmpty = alp::Set<int>::load(emptyStream);
+    ASSERT_TRUE(loadedEmpty);
+    EXPECT_TRUE(loadedEmpty->empty());
+
+    SetBlockedCtrl migrating;
+    migrating.set_incremental_rehash(1);
+    for (int i = 0; i < 5000; ++i)
+    {
+        migrating.emplace(i);
+    }
+    std::stringstream migratingStream;
+    ASSERT_TRUE(migrating.save(migratingStream));
+    auto loadedMigrating = SetBlockedCtrl::load(migratingStream);
+    ASSERT_TRUE(loadedMigrating);
+    EXPECT_EQ(loadedMigrating->size(), 5000);
+    for (int i = 0; i < 5000; ++i)
+    {
+        ASSERT_TRUE(loadedMigrating->contains(i)) << "Missing: " << i;
+    }
+}
+
+TEST(SetSerialization, FileRoundTrip)
+{
+    auto path = std::filesystem::temp_directory_path() / "alp_set_serialization_test.bin";
+    alp::Set<uint32_t> s;
+    for (uint32_t i = 0; i < 1000; ++i)
+    {
+        s.emplace(i * 7919);
+    }
+    ASSERT_TRUE(s.save(path));
+    auto loaded = alp::Set<uint32_t>::load(path);
+    std::filesystem::remove(path);
+    ASSERT_TRUE(loaded);
+    EXPECT_EQ(loaded->size(), s.size());
+    for (auto v : s)
+    {
+        ASSERT_TRUE(loaded->contains(v)) << "Missing: " << v;
+    }
+
+    auto missing = alp::Set<uint32_t>::load(path);
+    ASSERT_FALSE(missing);
+    EXPECT_EQ(missing.error(), alp::Error::IoFailure);
+}
+
+TEST(SetSerialization, RejectsIncompatibleOrDamagedData)
+{
+    alp::Set<int64_t> s;
+    for (int64_t i = 0; i < 100; ++i)
+    {
+        s.emplace(i);
+    }
+    std::stringstream stream;
+    ASSERT_TRUE(s.save(stream));
+    auto const data = stream.str();
+
+    // Another element type, or another hash function
+    std::istringstream narrower(data);
+    EXPECT_EQ(alp::Set<int32_t>::load(narrower).error(), alp::Error::IncompatibleFormat);
+    std::istringstream otherHash(data);
+    EXPECT_EQ((alp::Set<int64_t, std::hash<int64_t>>::load(otherHash).error()),
+              alp::Error::IncompatibleFormat);
+
+    std::istringstream truncated(data.substr(0, data.size() - 1));
+    EXPECT_EQ(alp::Set<int64_t>::load(truncated).error(), alp::Error::IoFailure);
+
+    // A header claiming an element more than the control bytes hold
+    s.erase(42);
+    std::stringstream erasedStream;
+    ASSERT_TRUE(s.save(erasedStream));
+    auto damaged = erasedStream.str();
+    ASSERT_EQ(damaged.size(), data.size());
+    auto firstDifference = std::ranges::mismatch(damaged, data).in1 - damaged.begin();
+    damaged[firstDifference] = data[firstDifference];
+    std::istringstream damagedStream(damaged);
+    EXPECT_EQ(alp::Set<int64_t>::load(damagedStream).error(), alp::Error::IncompatibleFormat);
+}
+
+TEST(SetSerialization, RejectsTablesWithoutEmptySlots)
+{
+    // One element with every other slot a tombstone, under a header counting every slot
+    // as used: the counts agree, but a lookup of a missing key would probe forever
+    alp::Set<int64_t> s;
+    s.reserve(100);
+    s.emplace(7);
+    std::stringstream stream;
+    ASSERT_TRUE(s.save(stream));
+    auto damaged = stream.str();
+
+    constexpr size_t headerSize = 128;
+    constexpr size_t usedOffset = 88;  // The header field after size
+    uint64_t capacity = s.capacity();
+    std::memcpy(damaged.data() + usedOffset, &capacity, sizeof(capacity));
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        char& ctrl = damaged[headerSize + i];
+        if (static_cast<unsigned char>(ctrl) == 0x80)
+        {
+            ctrl = static_cast<char>(0xFE);
+        }
+    }
+    std::istringstream damagedStream(damaged);
+    auto loaded = alp::Set<int64_t>::load(damagedStream);
+    ASSERT_FALSE(loaded);
+    EXPECT_EQ(loaded.error(), alp::Error::IncompatibleFormat);
+}